@@ -0,0 +1,370 @@
+/* Benchmark of the read/write functions: latency percentiles and throughput
+ over sweeps of the node count, the sample count and the buffer mask
+
+   ./benchmark -o read -n 1-16 -s 32767 -i 10000 -f csv > read.csv
+   ./benchmark -e -o both -n 1,2,4 -s 1024,8192,32767 -b 1,3,15 -f json
+
+ -e runs the node emulator (src/warp_emulator.h) on 127.0.0.x inside the
+ process, so the benchmark also runs without WARP boards
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "warp_functions.h"
+#include "warp_emulator.h"
+
+#define MAX_VALUES 64 // max entries of a sweep list
+#define MAX_NODES 64
+#define CLOCKTYPE CLOCK_MONOTONIC_RAW
+
+#define OP_READ 1
+#define OP_WRITE 2
+
+#define FORMAT_CSV 0
+#define FORMAT_JSON 1
+
+// benchmark configuration
+typedef struct {
+	int ops;								// OP_READ | OP_WRITE
+	int nodes[MAX_VALUES];					// node count sweep
+	int num_nodes;
+	int samples[MAX_VALUES];				// sample count sweep
+	int num_samples;
+	int masks[MAX_VALUES];					// buffer mask sweep
+	int num_masks;
+	int warmup;								// calls not measured before each run
+	int iterations;							// measured calls of each run
+	int engine;								// 1: read all nodes from one thread over one socket, 0: one OpenMP thread per node
+	int format;								// FORMAT_CSV or FORMAT_JSON
+	int host_id;
+	int trigger;							// send a trigger before the reads of each run
+} bench_config;
+
+// result of one run
+typedef struct {
+	int op;
+	int nodes;
+	int samples;
+	int mask;
+	double mean, std, min, p50, p90, p99, p999, max;	// latency in us
+	double gbps;							// sample payload throughput at the mean latency
+} bench_result;
+
+static int result_count = 0;
+
+// calculate the time difference in microseconds
+static double diff_us(struct timespec end, struct timespec start){
+
+	return (end.tv_sec - start.tv_sec)*1.0e6 + (end.tv_nsec - start.tv_nsec)/1.0e3;
+}
+
+static int cmp_double(const void* a, const void* b){
+
+	double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+// p-th percentile (0 - 100) of sorted values, interpolated between the closest ranks
+static double percentile(const double* sorted, int count, double p){
+
+	double rank = (p/100.0)*(count - 1);
+	int lo = (int) floor(rank);
+	int hi = (lo + 1 < count) ? lo + 1 : lo;
+
+	return sorted[lo] + (rank - lo)*(sorted[hi] - sorted[lo]);
+}
+
+// number of RF buffers in a buffer mask
+static int mask_count(int mask){
+
+	return __builtin_popcount(mask & 0xF);
+}
+
+// parse "1,2,4" or "1-16" (or a mix, "1-4,8,16") in to values; returns the number of values
+static int parse_list(const char* arg, int* values, int base){
+
+	char copy[256];
+	char* tok;
+	char* save;
+	int count = 0;
+
+	strncpy(copy, arg, sizeof(copy) - 1);
+	copy[sizeof(copy) - 1] = 0;
+
+	for (tok = strtok_r(copy, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)){
+
+		char* dash = strchr(tok, '-');
+		int first = (int) strtol(tok, NULL, base);
+		int last = (dash != NULL) ? (int) strtol(dash + 1, NULL, base) : first;
+		int v;
+
+		for (v = first; (v <= last) && (count < MAX_VALUES); v++){
+			values[count++] = v;
+		}
+	}
+
+	return count;
+}
+
+
+// read every buffer of the mask from every node, one request per node for all buffers
+// (samples holds one array per node and buffer, see readIQ_multi_fmt)
+static void bench_read(bench_config* cfg, void** samples, int nodes, int num_samples, int mask, int* socks, int* ids){
+
+	if (cfg->engine){
+		readIQ_multi_fmt(samples, WL_SAMPLE_DOUBLE, 0, num_samples, socks[0], ids, nodes, mask, cfg->host_id);
+	}else{
+		int n;
+		#pragma omp parallel for
+		for (n = 0; n < nodes; n++){
+			readIQ_buffers(&samples[n*mask_count(mask)], WL_SAMPLE_DOUBLE, 0, num_samples, socks[n], ids[n], mask, cfg->host_id);
+		}
+	}
+}
+
+// write the samples to every buffer of the mask of every node
+static void bench_write(bench_config* cfg, void** samples, int nodes, int num_samples, int mask, int* socks, int* ids){
+
+	int n;
+	#pragma omp parallel for
+	for (n = 0; n < nodes; n++){
+		writeIQ(samples[n*mask_count(mask)], 0, num_samples, socks[n], ids[n], mask, cfg->host_id);
+	}
+}
+
+// run one configuration and compute its latency distribution
+static void bench_run(bench_config* cfg, int op, int nodes, int num_samples, int mask, bench_result* res){
+
+	int socks[MAX_NODES];
+	int ids[MAX_NODES];
+	void* samples[MAX_NODES*WL_EMU_NUM_BUFFERS];
+	double* lat = malloc(cfg->iterations*sizeof(double));
+	double tot = 0, totSq = 0;
+	struct timespec tsi, tsf;
+	int n, it;
+
+	for (n = 0; n < nodes; n++){
+		ids[n] = n;
+	}
+	for (n = 0; n < nodes*mask_count(mask); n++){
+		samples[n] = calloc(num_samples, sizeof(double complex));
+	}
+
+	nodes_initialize(socks, nodes);
+
+	if ((op == OP_READ) && cfg->trigger){
+		sendTrigger(); // send trigger before reading buffers
+	}
+
+	for (it = 0; it < cfg->warmup + cfg->iterations; it++){
+
+		clock_gettime(CLOCKTYPE, &tsi);
+
+		if (op == OP_READ){
+			bench_read(cfg, samples, nodes, num_samples, mask, socks, ids);
+		}else{
+			bench_write(cfg, samples, nodes, num_samples, mask, socks, ids);
+		}
+
+		clock_gettime(CLOCKTYPE, &tsf);
+
+		if (it >= cfg->warmup){
+			lat[it - cfg->warmup] = diff_us(tsf, tsi);
+		}
+	}
+
+	nodes_disable(socks, nodes);
+
+	for (it = 0; it < cfg->iterations; it++){
+		tot += lat[it];
+		totSq += lat[it]*lat[it];
+	}
+
+	qsort(lat, cfg->iterations, sizeof(double), cmp_double);
+
+	res->op = op;
+	res->nodes = nodes;
+	res->samples = num_samples;
+	res->mask = mask;
+	res->mean = tot/cfg->iterations;
+	res->std = sqrt(fmax(0.0, totSq/cfg->iterations - res->mean*res->mean));
+	res->min = lat[0];
+	res->p50 = percentile(lat, cfg->iterations, 50.0);
+	res->p90 = percentile(lat, cfg->iterations, 90.0);
+	res->p99 = percentile(lat, cfg->iterations, 99.0);
+	res->p999 = percentile(lat, cfg->iterations, 99.9);
+	res->max = lat[cfg->iterations - 1];
+
+	// each sample is a 32 bit word on the wire; a read of several buffers moves each of them,
+	// a write sends the samples once for all buffers of the mask
+	res->gbps = (double) nodes*num_samples*32.0*((op == OP_READ) ? mask_count(mask) : 1)/(res->mean*1.0e3);
+
+	for (n = 0; n < nodes*mask_count(mask); n++){
+		free(samples[n]);
+	}
+	free(lat);
+}
+
+static void print_result(FILE* fp, bench_config* cfg, bench_result* res){
+
+	const char* op = (res->op == OP_READ) ? "read" : "write";
+
+	if (cfg->format == FORMAT_CSV){
+		if (result_count == 0){
+			fprintf(fp, "op,nodes,samples,buffer_mask,engine,iterations,mean_us,std_us,min_us,p50_us,p90_us,p99_us,p99.9_us,max_us,gbps\n");
+		}
+		fprintf(fp, "%s,%d,%d,0x%x,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.4f\n",
+			op, res->nodes, res->samples, res->mask, cfg->engine, cfg->iterations,
+			res->mean, res->std, res->min, res->p50, res->p90, res->p99, res->p999, res->max, res->gbps);
+	}else{
+		fprintf(fp, "%s\n  {\"op\": \"%s\", \"nodes\": %d, \"samples\": %d, \"buffer_mask\": %d, \"engine\": %d, \"iterations\": %d, "
+			"\"mean_us\": %.2f, \"std_us\": %.2f, \"min_us\": %.2f, \"p50_us\": %.2f, \"p90_us\": %.2f, \"p99_us\": %.2f, "
+			"\"p99.9_us\": %.2f, \"max_us\": %.2f, \"gbps\": %.4f}",
+			(result_count == 0) ? "[" : ",", op, res->nodes, res->samples, res->mask, cfg->engine, cfg->iterations,
+			res->mean, res->std, res->min, res->p50, res->p90, res->p99, res->p999, res->max, res->gbps);
+	}
+	fflush(fp);
+
+	result_count++;
+}
+
+static void usage(const char* name){
+
+	printf("Usage: %s [options]\n", name);
+	printf("  -o op         read, write or both (default read)\n");
+	printf("  -n nodes      node counts, eg 1-16 or 1,2,4 (default 1)\n");
+	printf("  -s samples    sample counts, eg 1024,32767 (default 32767)\n");
+	printf("  -b masks      buffer masks, eg 1,3,0xF (default 1)\n");
+	printf("  -w count      warm-up calls before each run (default 10)\n");
+	printf("  -i count      measured calls of each run (default 1000)\n");
+	printf("  -m            read all nodes from one thread over one socket\n");
+	printf("  -t            send a trigger before the reads of each run\n");
+	printf("  -f format     csv or json (default csv)\n");
+	printf("  -O file       output file (default stdout)\n");
+	printf("  -H id         host id (default 210)\n");
+	printf("  -S subnet     node subnet (default 10.0.0. or WARP_NODE_SUBNET)\n");
+	printf("  -e            run the node emulator on 127.0.0.x in this process\n");
+	printf("  -l us         emulator latency of every response packet\n");
+	printf("  -j us         emulator jitter\n");
+	printf("  -p prob       emulator packet loss\n");
+	printf("  -P prob       emulator loss of the packets sent to the nodes\n");
+}
+
+int main(int argc, char** argv){
+
+	bench_config cfg;
+	bench_result res;
+	wl_emu_config emu_cfg;
+	wl_emulator* emu = NULL;
+	int use_emu = 0;
+	FILE* fp = stdout;
+	int opt, i, j, k, op;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.ops = OP_READ;
+	cfg.nodes[0] = 1; cfg.num_nodes = 1;
+	cfg.samples[0] = 32767; cfg.num_samples = 1;
+	cfg.masks[0] = 1; cfg.num_masks = 1;
+	cfg.warmup = 10;
+	cfg.iterations = 1000;
+	cfg.host_id = 210; // 10.0.0.210 is the IP address of host
+	cfg.format = FORMAT_CSV;
+
+	wl_emu_default_config(&emu_cfg);
+	emu_cfg.bind_trigger = 0;
+
+	while ((opt = getopt(argc, argv, "o:n:s:b:w:i:mtf:O:H:S:el:j:p:P:h")) != -1){
+		switch (opt){
+			case 'o':
+				cfg.ops = (!strcmp(optarg, "write")) ? OP_WRITE : (!strcmp(optarg, "both")) ? (OP_READ | OP_WRITE) : OP_READ;
+				break;
+			case 'n': cfg.num_nodes = parse_list(optarg, cfg.nodes, 10); break;
+			case 's': cfg.num_samples = parse_list(optarg, cfg.samples, 10); break;
+			case 'b': cfg.num_masks = parse_list(optarg, cfg.masks, 0); break;
+			case 'w': cfg.warmup = atoi(optarg); break;
+			case 'i': cfg.iterations = atoi(optarg); break;
+			case 'm': cfg.engine = 1; break;
+			case 't': cfg.trigger = 1; break;
+			case 'f': cfg.format = (!strcmp(optarg, "json")) ? FORMAT_JSON : FORMAT_CSV; break;
+			case 'O':
+				fp = fopen(optarg, "w");
+				if (fp == NULL){ perror(optarg); return 1; }
+				break;
+			case 'H': cfg.host_id = atoi(optarg); break;
+			case 'S': nodes_set_subnet(optarg); break;
+			case 'e': use_emu = 1; break;
+			case 'l': emu_cfg.latency_us = atof(optarg); break;
+			case 'j': emu_cfg.jitter_us = atof(optarg); break;
+			case 'p': emu_cfg.loss = atof(optarg); break;
+			case 'P': emu_cfg.rx_loss = atof(optarg); break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (cfg.iterations < 1){
+		cfg.iterations = 1;
+	}
+
+	for (i = 0; i < cfg.num_nodes; i++){
+		if ((cfg.nodes[i] < 1) || (cfg.nodes[i] > MAX_NODES)){
+			fprintf(stderr, "node count %d out of range (1 - %d)\n", cfg.nodes[i], MAX_NODES);
+			return 1;
+		}
+		emu_cfg.num_nodes = (cfg.nodes[i] > emu_cfg.num_nodes) ? cfg.nodes[i] : emu_cfg.num_nodes;
+	}
+
+	for (i = 0; i < cfg.num_masks; i++){
+		if ((cfg.masks[i] < 1) || (cfg.masks[i] > 0xF)){
+			fprintf(stderr, "buffer mask 0x%x out of range (0x1 - 0xF)\n", cfg.masks[i]);
+			return 1;
+		}
+	}
+
+	if (use_emu){
+		strcpy(emu_cfg.subnet, "127.0.0.");
+		emu = wl_emu_create(&emu_cfg);
+		wl_emu_start(emu);
+		setenv("WARP_NODE_SUBNET", emu_cfg.subnet, 1);
+	}
+
+	for (op = OP_READ; op <= OP_WRITE; op <<= 1){
+
+		if ((cfg.ops & op) == 0){
+			continue;
+		}
+
+		for (i = 0; i < cfg.num_nodes; i++){
+			for (j = 0; j < cfg.num_samples; j++){
+				for (k = 0; k < cfg.num_masks; k++){
+
+					fprintf(stderr, "%s: %d nodes, %d samples, buffer mask 0x%x ...\n", (op == OP_READ) ? "read" : "write",
+						cfg.nodes[i], cfg.samples[j], cfg.masks[k]);
+
+					bench_run(&cfg, op, cfg.nodes[i], cfg.samples[j], cfg.masks[k], &res);
+					print_result(fp, &cfg, &res);
+				}
+			}
+		}
+	}
+
+	if ((cfg.format == FORMAT_JSON) && (result_count > 0)){
+		fprintf(fp, "\n]\n");
+	}
+
+	if (fp != stdout){
+		fclose(fp);
+	}
+
+	if (emu != NULL){
+		wl_emu_destroy(emu);
+	}
+
+	return 0;
+}
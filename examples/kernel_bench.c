@@ -0,0 +1,489 @@
+/* Microbenchmark of the transport kernels: sample decode/encode, endian swaps,
+ checksum and packet tracking, in ns per sample or ns per packet
+
+   ./kernel_bench                 all kernels, every instruction set the CPU supports
+   ./kernel_bench -k decode -t 50 kernels with "decode" in their name, 50 ms per point
+   ./kernel_bench -v              check the sample kernels of every instruction set against
+                                  the scalar ones (exit status 1 on a mismatch)
+
+ Inputs are fixed (seeded) so that the numbers of two builds can be compared.
+ The legacy_* kernels are the loops the transport used before the sample
+ kernels of warp_kernels.c and are kept here as the baseline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <complex.h>
+
+#include "warp_transport.h"
+
+#define CLOCKTYPE_BENCH CLOCK_MONOTONIC_RAW
+#define MAX_SAMPLES 32768
+#define MAX_PKTS 64
+#define SAMPLES_PER_PKT 2232 // samples in a jumbo frame
+#define TRIALS 5
+
+// unit of a kernel measurement
+#define UNIT_SAMPLE 0
+#define UNIT_PKT 1
+
+static const int sample_sizes[] = {1, 4, 16, 64, 256, 1024, 2232, 4096, 8192, 16384, 32768};
+static const int pkt_sizes[] = {1, 2, 4, 8, 15, 16, 32, 64};
+
+// start and number of samples of a received Read IQ packet (packet tracking of the old read path)
+typedef struct {
+	uint32 start_sample;
+	uint32 num_samples;
+} sample_tracker;
+
+// fixed inputs and outputs of the kernels
+static uint8_t payload[4*MAX_SAMPLES];
+static uint32_t words[MAX_SAMPLES];
+static double complex samples_d[MAX_SAMPLES];
+static float complex samples_f[MAX_SAMPLES];
+static int16_t samples_s[2*MAX_SAMPLES];
+static uint16_t samples_i[MAX_SAMPLES];
+static uint16_t samples_q[MAX_SAMPLES];
+static sample_tracker tracker[MAX_PKTS];
+static uint32 bitmap[WL_BITMAP_WORDS(MAX_PKTS)];
+
+static volatile uint32_t sink;
+static double min_ms = 20.0;
+
+typedef void (*kernel_fn)(int size);
+
+// fill the inputs from a fixed seed
+static void init_inputs(void){
+
+	uint32_t x = 0x12345678;
+	int i;
+
+	for (i = 0; i < MAX_SAMPLES; i++){
+		x = x*1664525 + 1013904223;
+		payload[4*i] = x >> 24; payload[4*i+1] = x >> 16; payload[4*i+2] = x >> 8; payload[4*i+3] = x;
+		words[i] = x;
+		samples_d[i] = ((int16_t)(x >> 16))/32768.0 + ((int16_t) x)/32768.0*I;
+		samples_f[i] = (float) creal(samples_d[i]) + (float) cimag(samples_d[i])*I;
+		samples_s[2*i] = (int16_t)(x >> 16);
+		samples_s[2*i+1] = (int16_t) x;
+	}
+
+	for (i = 0; i < MAX_PKTS; i++){
+		tracker[i].start_sample = i*SAMPLES_PER_PKT;
+		tracker[i].num_samples = SAMPLES_PER_PKT;
+	}
+}
+
+
+/* legacy kernels */
+
+// sample assembly loop of the old wl_read_baseband_buffer
+static void legacy_assemble(int size){
+
+	int i;
+	for (i = 0; i < 4*size; i += 4){
+		words[i/4] = (uint32) ((payload[i] << 24) | (payload[i+1] << 16) | (payload[i+2] << 8) | (payload[i+3]));
+	}
+}
+
+// endian_swap_32 over sample words
+static void legacy_endian_swap_32(int size){
+
+	int i;
+	for (i = 0; i < size; i++){
+		words[i] = endian_swap_32(((uint32*) payload)[i]);
+	}
+}
+
+// Fix_14_13 conversion of readSamples (assembled words to complex doubles): mask the upper two
+// bits, sign extend bit 13 and scale by 2^-13
+static void legacy_unpack_iq(int size){
+
+	int i;
+	double i_val, q_val;
+	for (i = 0; i < size; i++){
+		i_val = (double) ((int16) (((words[i] >> 16) & 0x3FFF) | (((words[i] >> 29) & 0x1)*0xC000)));
+		q_val = (double) ((int16) ((words[i] & 0x3FFF) | (((words[i] >> 13) & 0x1)*0xC000)));
+		samples_d[i] = (i_val*0.00012207) + (q_val*0.00012207)*I;
+	}
+}
+
+// UFix_16_15 quantization of the old writeIQ (complex doubles to split I/Q arrays)
+static void legacy_quantize(int size){
+
+	int i;
+	for (i = 0; i < size; i++){
+		samples_i[i] = (uint16) pow(2,15)*creal(samples_d[i]);
+		samples_q[i] = (uint16) pow(2,15)*cimag(samples_d[i]);
+	}
+}
+
+
+/* current kernels */
+
+static void decode_raw32(int size){ wl_decode_raw32(words, payload, size); }
+static void decode_double(int size){ wl_decode_iq(samples_d, payload, size); }
+static void decode_float(int size){ wl_decode_iq_float(samples_f, payload, size); }
+static void decode_int16(int size){ wl_decode_iq_int16(samples_s, payload, size); }
+static void encode_double(int size){ wl_encode_iq(payload, samples_d, size); }
+static void encode_float(int size){ wl_encode_iq_float(payload, samples_f, size); }
+static void encode_int16(int size){ wl_encode_iq_int16(payload, samples_s, size); }
+static void encode_raw32(int size){ wl_encode_raw32(payload, words, size); }
+
+// Write IQ checksum of a packet train: start sample and last sample of each packet
+static void update_checksum(int size){
+
+	int i;
+	uint32 checksum = 0;
+
+	for (i = 0; i < size; i++){
+		checksum = wl_update_checksum((i*SAMPLES_PER_PKT) & 0xFFFF, (i == 0) ? SAMPLE_CHKSUM_RESET : SAMPLE_CHKSUM_NOT_RESET, 0);
+		checksum = wl_update_checksum(words[i] ^ (words[i] >> 16), SAMPLE_CHKSUM_NOT_RESET, 0);
+	}
+	sink = checksum;
+}
+
+// first missing packet of a transfer, as the old read path looked for it (naive quadratic scan,
+// kept as is: the inner loop compares tracker[i], not tracker[j])
+static int read_iq_find_error(const sample_tracker* tracker, uint32 num_samples, uint32 start_sample, uint32 num_pkts,
+		uint32 max_sample_size, uint32* ret_num_samples, uint32* ret_start_sample, uint32* ret_num_pkts){
+
+	uint32 i, j, value_found;
+	uint32 start_sample_to_request = start_sample;
+	uint32 num_samples_left = num_samples;
+	uint32 num_pkts_left = num_pkts;
+
+	for (i = 0; i < num_pkts; i++){
+		value_found = 0;
+		for (j = 0; j < num_pkts; j++){
+			if (start_sample_to_request == tracker[i].start_sample){
+				value_found = 1;
+			}
+		}
+		if (!value_found){
+			break;
+		}
+		start_sample_to_request += max_sample_size;
+		num_samples_left -= max_sample_size;
+		num_pkts_left -= 1;
+	}
+
+	*ret_start_sample = start_sample_to_request;
+	*ret_num_samples = num_samples_left;
+	*ret_num_pkts = num_pkts_left;
+
+	return num_pkts_left != 0;
+}
+
+// Read IQ packet tracking of the old read path on a complete transfer (worst case: full scan)
+static void find_error(int size){
+
+	uint32 num_samples, start_sample, num_pkts;
+
+	sink = read_iq_find_error(tracker, size*SAMPLES_PER_PKT, 0, size, SAMPLES_PER_PKT, &num_samples, &start_sample, &num_pkts);
+}
+
+// Read IQ packet tracking of the current read path: mark every packet, then look for a missing one
+static void bitmap_track(int size){
+
+	int i;
+
+	memset(bitmap, 0, sizeof(bitmap));
+	for (i = 0; i < size; i++){
+		WL_BITMAP_SET(bitmap, i);
+	}
+	sink = wl_bitmap_next_clear(bitmap, 0, size);
+}
+
+
+typedef struct {
+	const char* name;
+	kernel_fn fn;
+	int unit;
+	int per_isa;		// depends on the instruction set (see wl_kernel_select)
+} bench_kernel;
+
+static const bench_kernel kernels[] = {
+	{"legacy_assemble",       legacy_assemble,       UNIT_SAMPLE, 0},
+	{"legacy_endian_swap_32", legacy_endian_swap_32, UNIT_SAMPLE, 0},
+	{"legacy_unpack_iq",      legacy_unpack_iq,      UNIT_SAMPLE, 0},
+	{"legacy_quantize",       legacy_quantize,       UNIT_SAMPLE, 0},
+	{"decode_raw32",          decode_raw32,          UNIT_SAMPLE, 0},
+	{"decode_double",         decode_double,         UNIT_SAMPLE, 1},
+	{"decode_float",          decode_float,          UNIT_SAMPLE, 1},
+	{"decode_int16",          decode_int16,          UNIT_SAMPLE, 1},
+	{"encode_raw32",          encode_raw32,          UNIT_SAMPLE, 0},
+	{"encode_double",         encode_double,         UNIT_SAMPLE, 1},
+	{"encode_float",          encode_float,          UNIT_SAMPLE, 1},
+	{"encode_int16",          encode_int16,          UNIT_SAMPLE, 1},
+	{"update_checksum",       update_checksum,       UNIT_PKT,    0},
+	{"find_error",            find_error,            UNIT_PKT,    0},
+	{"bitmap_track",          bitmap_track,          UNIT_PKT,    0},
+};
+
+static double now_ns(void){
+
+	struct timespec ts;
+	clock_gettime(CLOCKTYPE_BENCH, &ts);
+	return ts.tv_sec*1.0e9 + ts.tv_nsec;
+}
+
+// time one kernel at one size:  best of TRIALS runs, each repeating the call for about min_ms / TRIALS
+static double measure(kernel_fn fn, int size){
+
+	double start, elapsed, best = 0;
+	long reps = 1, r;
+	int t;
+
+	// calibrate the number of calls per trial
+	do {
+		start = now_ns();
+		for (r = 0; r < reps; r++){
+			fn(size);
+		}
+		elapsed = now_ns() - start;
+		if (elapsed < min_ms*1.0e6/TRIALS/4){
+			reps *= 2;
+		}
+	} while (elapsed < min_ms*1.0e6/TRIALS/4);
+
+	reps = (long) (reps*(min_ms*1.0e6/TRIALS)/elapsed) + 1;
+
+	for (t = 0; t < TRIALS; t++){
+		start = now_ns();
+		for (r = 0; r < reps; r++){
+			fn(size);
+		}
+		elapsed = (now_ns() - start)/reps;
+		if ((t == 0) || (elapsed < best)){
+			best = elapsed;
+		}
+	}
+
+	// outputs are read back so that the stores are kept
+	sink = words[size-1] ^ payload[size-1] ^ samples_i[size-1] ^ samples_q[size-1] ^ samples_s[size-1];
+
+	return best;
+}
+
+
+/* bit-exact check of the instruction set kernels */
+
+#define VERIFY_SAMPLES (MAX_SAMPLES + 8)
+
+static uint8_t v_payload[4*VERIFY_SAMPLES];
+static uint8_t v_ref[4*VERIFY_SAMPLES];
+static uint8_t v_out[4*VERIFY_SAMPLES];
+static double complex v_d[VERIFY_SAMPLES];
+static float complex v_f[VERIFY_SAMPLES];
+static int16_t v_s[2*VERIFY_SAMPLES];
+static double complex v_ref_d[VERIFY_SAMPLES];
+static double complex v_out_d[VERIFY_SAMPLES];
+static float complex v_ref_f[VERIFY_SAMPLES];
+static float complex v_out_f[VERIFY_SAMPLES];
+static int16_t v_ref_s[2*VERIFY_SAMPLES];
+static int16_t v_out_s[2*VERIFY_SAMPLES];
+
+// fill the check inputs:  every sample word pattern, and samples at, beyond and between the
+// saturation limits (+-1.0, out of range, NaN, +-Inf) among random ones
+static void init_verify_inputs(void){
+
+	static const double edges[] = {1.0, -1.0, 32767.0/32768, -32768.0/32768, 32767.5/32768, -32768.5/32768,
+		0.99999, -0.99999, 1.5, -1.5, 1.0e9, -1.0e9, 0.0, -0.0, 0.5/32768, -0.5/32768, 1.0e-300,
+		NAN, -NAN, INFINITY, -INFINITY};
+	static const int16_t edges_s[] = {32767, -32768, 0, 1, -1, 16384, -16384, 32766, -32767};
+	int num_edges = sizeof(edges)/sizeof(edges[0]);
+	int num_edges_s = sizeof(edges_s)/sizeof(edges_s[0]);
+	uint32_t x = 0x9E3779B9;
+	double re, im;
+	int i;
+
+	for (i = 0; i < VERIFY_SAMPLES; i++){
+		x = x*1664525 + 1013904223;
+
+		// sample words:  the low bits sweep all 16 bit patterns of I and Q
+		v_payload[4*i] = x >> 24; v_payload[4*i+1] = i >> 8; v_payload[4*i+2] = x >> 8; v_payload[4*i+3] = i;
+
+		re = ((int32_t) x)/2147483648.0*1.25;
+		im = ((int32_t) (x*2654435761u))/2147483648.0*1.25;
+
+		if ((i % 3) == 0){
+			re = edges[(i/3) % num_edges];
+		}
+		if ((i % 5) == 0){
+			im = edges[(i/5) % num_edges];
+		}
+
+		v_d[i] = CMPLX(re, im);
+		v_f[i] = CMPLXF((float) re, (float) im);
+
+		v_s[2*i] = ((i % 4) == 0) ? edges_s[(i/4) % num_edges_s] : (int16_t) (x >> 16);
+		v_s[2*i+1] = ((i % 7) == 0) ? edges_s[(i/7) % num_edges_s] : (int16_t) x;
+	}
+}
+
+// compare one kernel of one instruction set with the scalar one over all sizes and alignments
+static int verify_kernel(const char* name, int isa, void* ref, void* out, int elem_size, 
+		void (*check)(void* dst, int offset, int size, int scalar)){
+
+	static const int sizes[] = {1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 2232, 4095, MAX_SAMPLES};
+	int offset, s, errors = 0;
+
+	for (offset = 0; offset < 4; offset++){
+		for (s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++){
+
+			// guard bytes after the output catch stores past the last sample
+			memset(ref, 0xA5, (size_t) elem_size*VERIFY_SAMPLES);
+			memset(out, 0xA5, (size_t) elem_size*VERIFY_SAMPLES);
+
+			check(ref, offset, sizes[s], 1);
+			check(out, offset, sizes[s], 0);
+
+			if (memcmp(ref, out, (size_t) elem_size*VERIFY_SAMPLES) != 0){
+				if (errors < 5){
+					printf("MISMATCH: %s,%s,size %d,offset %d\n", name, wl_kernel_isa_name(isa), sizes[s], offset);
+				}
+				errors++;
+			}
+		}
+	}
+
+	return errors;
+}
+
+static void check_decode_double(void* dst, int offset, int size, int scalar){
+	(scalar ? wl_decode_iq_scalar : wl_decode_iq)((double complex*) dst + offset, v_payload + 4*offset, size);
+}
+static void check_decode_float(void* dst, int offset, int size, int scalar){
+	(scalar ? wl_decode_iq_float_scalar : wl_decode_iq_float)((float complex*) dst + offset, v_payload + 4*offset, size);
+}
+static void check_decode_int16(void* dst, int offset, int size, int scalar){
+	(scalar ? wl_decode_iq_int16_scalar : wl_decode_iq_int16)((int16_t*) dst + 2*offset, v_payload + 4*offset, size);
+}
+static void check_encode_double(void* dst, int offset, int size, int scalar){
+	(scalar ? wl_encode_iq_scalar : wl_encode_iq)((uint8_t*) dst + 4*offset, v_d + offset, size);
+}
+static void check_encode_float(void* dst, int offset, int size, int scalar){
+	(scalar ? wl_encode_iq_float_scalar : wl_encode_iq_float)((uint8_t*) dst + 4*offset, v_f + offset, size);
+}
+static void check_encode_int16(void* dst, int offset, int size, int scalar){
+	(scalar ? wl_encode_iq_int16_scalar : wl_encode_iq_int16)((uint8_t*) dst + 4*offset, v_s + 2*offset, size);
+}
+
+// check the kernels of every instruction set the CPU supports:  returns the number of mismatches
+static int verify(int only_isa){
+
+	int best_isa = wl_kernel_isa();
+	int isa, errors, total = 0;
+
+	init_verify_inputs();
+
+	for (isa = WL_ISA_SCALAR + 1; isa <= best_isa; isa++){
+
+		if ((only_isa >= 0) && (isa != only_isa)){
+			continue;
+		}
+
+		wl_kernel_select(isa);
+
+		errors  = verify_kernel("decode_double", isa, v_ref_d, v_out_d, sizeof(double complex), check_decode_double);
+		errors += verify_kernel("decode_float", isa, v_ref_f, v_out_f, sizeof(float complex), check_decode_float);
+		errors += verify_kernel("decode_int16", isa, v_ref_s, v_out_s, 2*sizeof(int16_t), check_decode_int16);
+		errors += verify_kernel("encode_double", isa, v_ref, v_out, 4, check_encode_double);
+		errors += verify_kernel("encode_float", isa, v_ref, v_out, 4, check_encode_float);
+		errors += verify_kernel("encode_int16", isa, v_ref, v_out, 4, check_encode_int16);
+
+		printf("%s: %s\n", wl_kernel_isa_name(isa), errors ? "MISMATCH" : "bit-exact with scalar");
+		total += errors;
+	}
+
+	wl_kernel_select(best_isa);
+
+	if (best_isa == WL_ISA_SCALAR){
+		printf("scalar kernels only:  nothing to check\n");
+	}
+
+	return total;
+}
+
+static void usage(const char* name){
+
+	printf("Usage: %s [options]\n", name);
+	printf("  -k name       only kernels with name in their name\n");
+	printf("  -i isa        only this instruction set: 0 scalar, 1 sse4, 2 avx2, 3 avx512 (default all supported)\n");
+	printf("  -t ms         time spent on each point (default 20)\n");
+	printf("  -v            check the kernels of every instruction set against the scalar ones instead\n");
+}
+
+int main(int argc, char** argv){
+
+	const char* filter = NULL;
+	int only_isa = -1;
+	int check = 0;
+	int best_isa, isa, k, s, opt;
+	int num_sizes;
+	const int* sizes;
+	double ns;
+
+	while ((opt = getopt(argc, argv, "k:i:t:vh")) != -1){
+		switch (opt){
+			case 'k': filter = optarg; break;
+			case 'i': only_isa = atoi(optarg); break;
+			case 't': min_ms = atof(optarg); break;
+			case 'v': check = 1; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (check){
+		return (verify(only_isa) != 0);
+	}
+
+	init_inputs();
+
+	best_isa = wl_kernel_isa();
+
+	printf("kernel,isa,size,unit,ns_per_unit,ns_per_call\n");
+
+	for (k = 0; k < sizeof(kernels)/sizeof(kernels[0]); k++){
+
+		if ((filter != NULL) && (strstr(kernels[k].name, filter) == NULL)){
+			continue;
+		}
+
+		sizes = (kernels[k].unit == UNIT_SAMPLE) ? sample_sizes : pkt_sizes;
+		num_sizes = (kernels[k].unit == UNIT_SAMPLE) ? sizeof(sample_sizes)/sizeof(int) : sizeof(pkt_sizes)/sizeof(int);
+
+		for (isa = WL_ISA_SCALAR; isa <= best_isa; isa++){
+
+			// kernels without instruction set variants are run once
+			if (!kernels[k].per_isa && (isa != best_isa)){
+				continue;
+			}
+			if ((only_isa >= 0) && kernels[k].per_isa && (isa != only_isa)){
+				continue;
+			}
+
+			wl_kernel_select(isa);
+
+			for (s = 0; s < num_sizes; s++){
+
+				ns = measure(kernels[k].fn, sizes[s]);
+
+				printf("%s,%s,%d,%s,%.3f,%.1f\n", kernels[k].name, kernels[k].per_isa ? wl_kernel_isa_name(isa) : "-",
+					sizes[s], (kernels[k].unit == UNIT_SAMPLE) ? "sample" : "packet", ns/sizes[s], ns);
+				fflush(stdout);
+			}
+		}
+	}
+
+	wl_kernel_select(best_isa);
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+// node emulator: answers the Read IQ, Write IQ and trigger packets of the WARP nodes
+// so that the examples can run without WARP boards
+//
+//   ./node_emulator -s 127.0.0. -n 2 -l 20 -j 5 -p 0.001
+//   WARP_NODE_SUBNET=127.0.0. ./transport_latency
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "warp_emulator.h"
+
+static volatile int running = 1;
+
+static void stop(int sig){
+	(void) sig;
+	running = 0;
+}
+
+static void usage(const char* name){
+
+	printf("Usage: %s [options]\n", name);
+	printf("  -s subnet     node subnet with the trailing dot (default 10.0.0.)\n");
+	printf("  -n nodes      number of nodes (default 4)\n");
+	printf("  -f id         node id of the first node (default 0)\n");
+	printf("  -l us         latency of every response packet\n");
+	printf("  -j us         random jitter added to the latency\n");
+	printf("  -p prob       probability that a response packet is lost\n");
+	printf("  -P prob       probability that a packet sent to a node (command or Write IQ samples) is lost\n");
+	printf("  -r prob       probability that a response packet is reordered\n");
+	printf("  -d us         extra delay of a reordered packet (default 50)\n");
+	printf("  -S seed       seed of the impairments (default 1)\n");
+	printf("  -t            do not listen for triggers\n");
+	printf("  -v            print every command\n");
+}
+
+int main(int argc, char** argv){
+
+	int opt;
+	wl_emu_config config;
+
+	wl_emu_default_config(&config);
+
+	while ((opt = getopt(argc, argv, "s:n:f:l:j:p:P:r:d:S:tvh")) != -1){
+		switch (opt){
+			case 's':
+				strncpy(config.subnet, optarg, sizeof(config.subnet) - 1);
+				break;
+			case 'n': config.num_nodes = atoi(optarg); break;
+			case 'f': config.first_id = atoi(optarg); break;
+			case 'l': config.latency_us = atof(optarg); break;
+			case 'j': config.jitter_us = atof(optarg); break;
+			case 'p': config.loss = atof(optarg); break;
+			case 'P': config.rx_loss = atof(optarg); break;
+			case 'r': config.reorder = atof(optarg); break;
+			case 'd': config.reorder_us = atof(optarg); break;
+			case 'S': config.seed = (unsigned int) atoi(optarg); break;
+			case 't': config.bind_trigger = 0; break;
+			case 'v': config.verbose = 1; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	wl_emulator* emu = wl_emu_create(&config);
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	printf("Emulating nodes %d - %d on %s%d - %s%d \n", config.first_id, config.first_id + config.num_nodes - 1,
+		config.subnet, config.first_id + 1, config.subnet, config.first_id + config.num_nodes);
+	fflush(stdout);
+
+	while (running){
+		wl_emu_poll(emu, 100);
+	}
+
+	wl_emu_print_stats(emu);
+	wl_emu_destroy(emu);
+
+	return 0;
+}
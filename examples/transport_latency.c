@@ -12,6 +12,8 @@
 #include "warp_functions.h"
 
 #define MAX_LOOP 10010
+#define READ_ENGINE 0 // 1: read all nodes from one thread over one socket, 0: one OpenMP thread per node
+#define TRACE 0 // 1: print where the time of each read/write goes (see nodes_set_trace)
 #define CLOCKTYPE CLOCK_MONOTONIC_RAW
 
 // calculate the time difference in milliseconds 
@@ -53,7 +55,7 @@ double measureLatency(int numNodes, int num_samples, int* arr_node_sock, int* ar
     avgD = totD/(MAX_LOOP - 10); 
     stdD = sqrt((totSqD/(MAX_LOOP - 10)) - pow(avgD,2)); // std = avg(X^2) - (avg(X))^2
 
-	printf("delay values of %d numNodes: avg=%f std=%f\n", arr_node_id[0], avgD, stdD);
+	printf("delay values of %d numNodes: avg=%f std=%f\n", numNodes, avgD, stdD);
 
     return avgD;
 }
@@ -72,12 +74,30 @@ void multi_read(int numNodes, int num_samples, int* arr_node_sock, int* arr_node
 		for (niter = 0; niter < numNodes; niter++){
 
 			readIQ(samples, 0, num_samples, arr_node_sock[niter], arr_node_id[niter], 1, host_id); // default: buffer id = RFA, sample offset = 0 
-			// readIQ(samples, 0, num_samples, arr_node_sock[niter], arr_node_id[niter], 2, host_id); // Read RFB after RFA
+			// Read RFA and RFB with one request instead of reading RFB after RFA (rf_samples = {samples_a, samples_b}):
+			// readIQ_buffers(rf_samples, WL_SAMPLE_DOUBLE, 0, num_samples, arr_node_sock[niter], arr_node_id[niter], 3, host_id);
 		}
 	}	
 	free(samples);
 }
 
+// single-thread read of all nodes over one socket
+void multi_read_engine(int numNodes, int num_samples, int* arr_node_sock, int* arr_node_id, int host_id){
+
+	double complex* samples[numNodes];
+	int niter;
+
+	for (niter = 0; niter < numNodes; niter++){
+		samples[niter] = malloc(num_samples*sizeof(double complex));
+	}
+
+	readIQ_multi(samples, 0, num_samples, arr_node_sock[0], arr_node_id, numNodes, 1, host_id); // default: buffer id = RFA, sample offset = 0 
+
+	for (niter = 0; niter < numNodes; niter++){
+		free(samples[niter]);
+	}
+}
+
 // parallel write
 void multi_write(int numNodes, int num_samples, int* arr_node_sock, int* arr_node_id, int host_id){
 
@@ -106,8 +126,8 @@ int main(){
 	int host_id = 210; // 10.0.0.210 is the IP address of host
 	int numNodeRange = 16;
 
-	double readLatency[numNodeRange];
-	double writeLatency[numNodeRange];
+	double readLatency[numNodeRange + 1]; // indexed by the number of nodes
+	double writeLatency[numNodeRange + 1];
 
 	int numNodes;
 	FILE *fpr, *fpw;
@@ -124,8 +144,14 @@ int main(){
 		printf("-------nodes intialiazed------------\n");
 
 		sendTrigger(); // send trigger before reading buffers
+
+		nodes_set_trace(arr_node_sock, numNodes, TRACE, 1);
 		
-		readLatency[numNodes] = measureLatency(numNodes, num_samples, arr_node_sock, read_nodes, host_id, multi_read);
+		readLatency[numNodes] = measureLatency(numNodes, num_samples, arr_node_sock, read_nodes, host_id, READ_ENGINE ? multi_read_engine : multi_read);
+
+		if (TRACE){
+			nodes_trace_summary(stdout);
+		}
 
 		printf(" Read latency [Nodes=%d] = %2.2f \n", numNodes, readLatency[numNodes]);
 
@@ -145,9 +171,15 @@ int main(){
 		// first initialize the sockets 
 		nodes_initialize(arr_node_sock, numNodes);
 		printf("-------nodes intialiazed------------\n");
+
+		nodes_set_trace(arr_node_sock, numNodes, TRACE, 0);
 		
 		writeLatency[numNodes] = measureLatency(numNodes, num_samples, arr_node_sock, read_nodes, host_id, multi_write);
 
+		if (TRACE){
+			nodes_trace_summary(stdout);
+		}
+
 		sendTrigger(); // send trigger after writing 
 
 		printf(" Write latency [Nodes=%d] = %2.2f \n", numNodes, writeLatency[numNodes]);
@@ -0,0 +1,786 @@
+// include the header
+#include "warp_emulator.h"
+#include "warp_transport.h"
+
+#ifndef WIN32
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+
+/*************************** Local Functions *********************************/
+
+static double wl_emu_random( wl_emulator *emu ) {
+    return (double) rand_r( &(emu->rand_state) ) / ( (double) RAND_MAX + 1.0 );
+}
+
+static int wl_emu_time_before( const struct timespec *a, const struct timespec *b ) {
+    return ( a->tv_sec < b->tv_sec ) || ( ( a->tv_sec == b->tv_sec ) && ( a->tv_nsec < b->tv_nsec ) );
+}
+
+static int wl_emu_pkt_before( const wl_emu_pkt *a, const wl_emu_pkt *b ) {
+    if ( ( a->due.tv_sec == b->due.tv_sec ) && ( a->due.tv_nsec == b->due.tv_nsec ) ) {
+        return ( a->order < b->order );
+    }
+    return wl_emu_time_before( &(a->due), &(b->due) );
+}
+
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_pattern
+*
+*  Initial contents of the RF buffers so that reads can be checked without a
+*  prior write:  I = 7 * sample + node_id + buffer, Q = 13 * sample + buffer
+*
+******************************************************************************/
+uint32_t wl_emu_pattern( int node_id, int buffer, int sample ) {
+
+    return ( ( (uint32_t) ( sample * 7 + node_id + buffer ) & 0xFFFF ) << 16 ) |
+             ( (uint32_t) ( sample * 13 + buffer ) & 0xFFFF );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_default_config
+*
+*  Fills in the default configuration:  4 nodes on 10.0.0.x with no impairments
+*
+******************************************************************************/
+void wl_emu_default_config( wl_emu_config *config ) {
+
+    memset( config, 0, sizeof( wl_emu_config ) );
+
+    strcpy( config->subnet, "10.0.0." );
+    config->num_nodes    = 4;
+    config->reorder_us   = 50.0;
+    config->seed         = 1;
+    config->bind_trigger = 1;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_open
+*
+*  Opens a non-blocking UDP socket bound to ip_addr:port
+*
+******************************************************************************/
+static int wl_emu_open( const char *ip_addr, int port ) {
+
+    int                  handle;
+    int                  optval;
+    struct sockaddr_in   address;
+
+    if ( ( handle = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) < 0 ) {
+        die_with_error("Error:  Emulator could not create a socket.");
+    }
+
+    optval = 1;
+    setsockopt( handle, SOL_SOCKET, SO_REUSEADDR, (const char *)&optval, sizeof(optval) );
+    setsockopt( handle, SOL_SOCKET, SO_BROADCAST, (const char *)&optval, sizeof(optval) );
+
+    // Jumbo frame trains of several nodes can be in flight at once
+    optval = 0x1000000;
+    setsockopt( handle, SOL_SOCKET, SO_SNDBUF, (const char *)&optval, sizeof(optval) );
+    setsockopt( handle, SOL_SOCKET, SO_RCVBUF, (const char *)&optval, sizeof(optval) );
+
+    memset( &address, 0, sizeof( address ) );
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons( port );
+    address.sin_addr.s_addr = ( ip_addr == NULL ) ? htonl( INADDR_ANY ) : inet_addr( ip_addr );
+
+    if ( bind( handle, (struct sockaddr *) &address, sizeof( address ) ) < 0 ) {
+        printf("Error:  Emulator could not bind %s:%d (%s) \n", ( ip_addr == NULL ) ? "*" : ip_addr, port, strerror( errno ) );
+        die();
+    }
+
+    return handle;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_create
+*
+*  Creates an emulator:  binds a socket per node and fills the RF buffers with
+*  wl_emu_pattern()
+*
+******************************************************************************/
+wl_emulator * wl_emu_create( const wl_emu_config *config ) {
+
+    int               i, j, k;
+    char              ip_addr[32];
+    wl_emulator      *emu;
+    wl_emu_node      *node;
+
+    if ( ( config->num_nodes < 1 ) || ( config->num_nodes > WL_EMU_MAX_NODES ) ) {
+        die_with_error("Error:  Emulator number of nodes out of range.");
+    }
+
+    emu = (wl_emulator *) calloc( 1, sizeof( wl_emulator ) );
+    if ( emu == NULL ) { die_with_error("Error:  Cannot allocate emulator."); }
+
+    emu->config         = *config;
+    emu->rand_state     = config->seed;
+    emu->trigger_handle = -1;
+    emu->rcvd_buffer    = (char *) malloc( WL_EMU_MAX_PKT_LENGTH );
+    emu->nodes          = (wl_emu_node *) calloc( config->num_nodes, sizeof( wl_emu_node ) );
+
+    if ( ( emu->rcvd_buffer == NULL ) || ( emu->nodes == NULL ) ) { die_with_error("Error:  Cannot allocate emulator."); }
+
+    for ( i = 0; i < config->num_nodes; i++ ) {
+
+        node     = &(emu->nodes[i]);
+        node->id = config->first_id + i;
+
+        snprintf( ip_addr, sizeof( ip_addr ), "%s%d", config->subnet, node->id + 1 );
+        node->handle = wl_emu_open( ip_addr, WL_EMU_NODE_PORT + node->id );
+
+        for ( j = 0; j < WL_EMU_NUM_BUFFERS; j++ ) {
+            node->buffers[j] = (uint32_t *) malloc( sizeof( uint32_t ) * WL_EMU_BUFFER_SAMPLES );
+            if ( node->buffers[j] == NULL ) { die_with_error("Error:  Cannot allocate emulator buffers."); }
+
+            for ( k = 0; k < WL_EMU_BUFFER_SAMPLES; k++ ) {
+                node->buffers[j][k] = wl_emu_pattern( node->id, j, k );
+            }
+        }
+    }
+
+    if ( config->bind_trigger ) {
+        emu->trigger_handle = wl_emu_open( NULL, WL_EMU_TRIGGER_PORT );
+    }
+
+    return emu;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_destroy
+*
+*  Stops the emulator and frees all of its resources
+*
+******************************************************************************/
+void wl_emu_destroy( wl_emulator *emu ) {
+
+    int i, j;
+
+    wl_emu_stop( emu );
+
+    for ( i = 0; i < emu->config.num_nodes; i++ ) {
+        close( emu->nodes[i].handle );
+
+        for ( j = 0; j < WL_EMU_NUM_BUFFERS; j++ ) {
+            free( emu->nodes[i].buffers[j] );
+        }
+    }
+
+    if ( emu->trigger_handle >= 0 ) {
+        close( emu->trigger_handle );
+    }
+
+    for ( i = 0; i < emu->queue_length; i++ ) {
+        free( emu->queue[i].data );
+    }
+
+    free( emu->queue );
+    free( emu->nodes );
+    free( emu->rcvd_buffer );
+    free( emu );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_buffer
+*
+*  Returns the RF buffer of a node so that tests can read or preload samples
+*
+******************************************************************************/
+uint32_t * wl_emu_buffer( wl_emulator *emu, int node, int buffer ) {
+
+    if ( ( node < 0 ) || ( node >= emu->config.num_nodes ) || ( buffer < 0 ) || ( buffer >= WL_EMU_NUM_BUFFERS ) ) {
+        return NULL;
+    }
+
+    return emu->nodes[node].buffers[buffer];
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_queue_push / wl_emu_queue_pop
+*
+*  Min-heap of the delayed packets, ordered by due time
+*
+******************************************************************************/
+static void wl_emu_queue_push( wl_emulator *emu, wl_emu_pkt *pkt ) {
+
+    int          i;
+    wl_emu_pkt   tmp;
+
+    if ( emu->queue_length == emu->queue_size ) {
+        emu->queue_size = ( emu->queue_size == 0 ) ? 256 : ( 2 * emu->queue_size );
+        emu->queue      = (wl_emu_pkt *) realloc( emu->queue, sizeof( wl_emu_pkt ) * emu->queue_size );
+        if ( emu->queue == NULL ) { die_with_error("Error:  Cannot allocate emulator queue."); }
+    }
+
+    i              = emu->queue_length++;
+    emu->queue[i]  = *pkt;
+
+    while ( ( i > 0 ) && wl_emu_pkt_before( &(emu->queue[i]), &(emu->queue[(i - 1) / 2]) ) ) {
+        tmp                        = emu->queue[i];
+        emu->queue[i]              = emu->queue[(i - 1) / 2];
+        emu->queue[(i - 1) / 2]    = tmp;
+        i                          = ( i - 1 ) / 2;
+    }
+}
+
+static void wl_emu_queue_pop( wl_emulator *emu, wl_emu_pkt *pkt ) {
+
+    int          i, child;
+    wl_emu_pkt   tmp;
+
+    *pkt          = emu->queue[0];
+    emu->queue[0] = emu->queue[--emu->queue_length];
+
+    i = 0;
+    while ( ( child = 2 * i + 1 ) < emu->queue_length ) {
+
+        if ( ( child + 1 < emu->queue_length ) && wl_emu_pkt_before( &(emu->queue[child + 1]), &(emu->queue[child]) ) ) {
+            child += 1;
+        }
+
+        if ( !wl_emu_pkt_before( &(emu->queue[child]), &(emu->queue[i]) ) ) {
+            break;
+        }
+
+        tmp               = emu->queue[i];
+        emu->queue[i]     = emu->queue[child];
+        emu->queue[child] = tmp;
+        i                 = child;
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_send
+*
+*  Sends a response packet from a node, applying the configured impairments
+*
+******************************************************************************/
+static void wl_emu_send( wl_emulator *emu, int node, struct sockaddr_in *address, char *data, int length ) {
+
+    double        delay_us;
+    wl_emu_pkt    pkt;
+
+    // Drop the packet
+    if ( ( emu->config.loss > 0.0 ) && ( wl_emu_random( emu ) < emu->config.loss ) ) {
+        emu->stats.dropped += 1;
+        return;
+    }
+
+    delay_us = emu->config.latency_us;
+
+    if ( emu->config.jitter_us > 0.0 ) {
+        delay_us += emu->config.jitter_us * wl_emu_random( emu );
+    }
+
+    if ( ( emu->config.reorder > 0.0 ) && ( wl_emu_random( emu ) < emu->config.reorder ) ) {
+        delay_us           += emu->config.reorder_us;
+        emu->stats.reordered += 1;
+    }
+
+    // Send right away when nothing is delayed (keeps the order of the packets)
+    if ( ( delay_us <= 0.0 ) && ( emu->queue_length == 0 ) ) {
+        sendto( emu->nodes[node].handle, data, length, 0, (struct sockaddr *) address, sizeof( struct sockaddr_in ) );
+        emu->stats.tx_pkts += 1;
+        return;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &(pkt.due) );
+
+    pkt.due.tv_sec  += (time_t) ( delay_us / 1e6 );
+    pkt.due.tv_nsec += (long) ( ( delay_us - 1e6 * (double) (time_t) ( delay_us / 1e6 ) ) * 1e3 );
+
+    if ( pkt.due.tv_nsec >= 1000000000L ) {
+        pkt.due.tv_sec  += 1;
+        pkt.due.tv_nsec -= 1000000000L;
+    }
+
+    pkt.order   = emu->order++;
+    pkt.node    = node;
+    pkt.address = *address;
+    pkt.length  = length;
+    pkt.data    = (char *) malloc( length );
+
+    if ( pkt.data == NULL ) { die_with_error("Error:  Cannot allocate emulator packet."); }
+    memcpy( pkt.data, data, length );
+
+    wl_emu_queue_push( emu, &pkt );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_flush
+*
+*  Sends the delayed packets that are due.  Returns the time (in ns) until the
+*  next packet is due (-1 if none).
+*
+******************************************************************************/
+static long long wl_emu_flush( wl_emulator *emu ) {
+
+    struct timespec   now;
+    wl_emu_pkt        pkt;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    while ( emu->queue_length > 0 ) {
+
+        if ( wl_emu_time_before( &now, &(emu->queue[0].due) ) ) {
+            return ( (long long) ( emu->queue[0].due.tv_sec - now.tv_sec ) * 1000000000LL ) +
+                   ( emu->queue[0].due.tv_nsec - now.tv_nsec );
+        }
+
+        wl_emu_queue_pop( emu, &pkt );
+
+        sendto( emu->nodes[pkt.node].handle, pkt.data, pkt.length, 0, (struct sockaddr *) &(pkt.address), sizeof( struct sockaddr_in ) );
+        emu->stats.tx_pkts += 1;
+
+        free( pkt.data );
+    }
+
+    return -1;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_header
+*
+*  Fills in the transport and command headers of a response packet
+*
+*  NOTE:  As on the node, the lengths do not count the two bytes of padding at
+*      the start of the packet (see wl_write_baseband_buffer)
+*
+******************************************************************************/
+static void wl_emu_header( char *pkt, int length, wl_transport_header *request, uint32 command_id, int num_args ) {
+
+    wl_transport_header  *transport_hdr = (wl_transport_header *) pkt;
+    wl_command_header    *command_hdr   = (wl_command_header   *) ( pkt + sizeof( wl_transport_header ) );
+
+    transport_hdr->padding  = 0;
+    transport_hdr->dest_id  = request->src_id;
+    transport_hdr->src_id   = request->dest_id;
+    transport_hdr->rsvd     = 0;
+    transport_hdr->pkt_type = request->pkt_type;
+    transport_hdr->length   = endian_swap_16( length - sizeof( wl_transport_header ) );
+    transport_hdr->seq_num  = request->seq_num;
+    transport_hdr->flags    = 0;
+
+    command_hdr->command_id = endian_swap_32( command_id );
+    command_hdr->length     = endian_swap_16( length - sizeof( wl_transport_header ) - sizeof( wl_command_header ) );
+    command_hdr->num_args   = endian_swap_16( num_args );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_read_iq
+*
+*  Answers a Read IQ command:  sends the requested samples of every buffer in
+*  the buffer id, bytes_per_pkt bytes of samples per packet
+*
+******************************************************************************/
+static void wl_emu_read_iq( wl_emulator *emu, int node, struct sockaddr_in *address, char *buffer, int size ) {
+
+    int                   b;
+    uint32                i;
+    uint32                buffer_id, start_sample, num_samples, bytes_per_pkt, samples_per_pkt;
+    uint32                offset, end, num;
+    uint32               *command_args;
+    uint32               *payload;
+    int                   length;
+    char                  pkt[WL_EMU_MAX_PKT_LENGTH];
+    wl_sample_header     *sample_hdr;
+
+    uint32                cmd_hdr_size = sizeof( wl_transport_header ) + sizeof( wl_command_header );
+    uint32                all_hdr_size = cmd_hdr_size + sizeof( wl_sample_header );
+
+    if ( size < (int) ( cmd_hdr_size + 5 * sizeof( uint32 ) ) ) {
+        emu->stats.unknown += 1;
+        return;
+    }
+
+    command_args    = (uint32 *) ( buffer + cmd_hdr_size );
+    buffer_id       = endian_swap_32( command_args[0] );
+    start_sample    = endian_swap_32( command_args[1] );
+    num_samples     = endian_swap_32( command_args[2] );
+    bytes_per_pkt   = endian_swap_32( command_args[3] );
+    samples_per_pkt = bytes_per_pkt >> 2;
+
+    emu->stats.read_cmds += 1;
+
+    if ( emu->config.verbose ) {
+        printf("Node %d:  Read IQ buffer 0x%x, start %d, %d samples, %d bytes per packet \n",
+               emu->nodes[node].id, buffer_id, start_sample, num_samples, bytes_per_pkt);
+    }
+
+    if ( ( samples_per_pkt == 0 ) || ( samples_per_pkt > ( WL_EMU_MAX_PKT_LENGTH - all_hdr_size ) / 4 ) ) {
+        printf("WARNING:  Emulator node %d:  Read IQ with %d bytes per packet ignored \n", emu->nodes[node].id, bytes_per_pkt);
+        return;
+    }
+
+    end = start_sample + num_samples;
+    if ( ( end > WL_EMU_BUFFER_SAMPLES ) || ( end < start_sample ) ) {
+        end = WL_EMU_BUFFER_SAMPLES;
+    }
+
+    sample_hdr = (wl_sample_header *) ( pkt + cmd_hdr_size );
+    payload    = (uint32 *) ( pkt + all_hdr_size );
+
+    // Each buffer in the buffer id is sent in turn, tagged with its own buffer id
+    for ( b = 0; b < WL_EMU_NUM_BUFFERS; b++ ) {
+
+        if ( ( ( buffer_id >> b ) & 0x1 ) == 0 ) {
+            continue;
+        }
+
+        for ( offset = start_sample; offset < end; offset += num ) {
+
+            num    = ( end - offset < samples_per_pkt ) ? ( end - offset ) : samples_per_pkt;
+            length = all_hdr_size + 4 * num;
+
+            wl_emu_header( pkt, length, (wl_transport_header *) buffer, WL_EMU_CMD_READ_IQ, 1 );
+
+            sample_hdr->buffer_id   = endian_swap_16( 1 << b );
+            sample_hdr->flags       = 0;
+            sample_hdr->rsvd        = 0;
+            sample_hdr->start       = endian_swap_32( offset );
+            sample_hdr->num_samples = endian_swap_32( num );
+
+            for ( i = 0; i < num; i++ ) {
+                payload[i] = endian_swap_32( emu->nodes[node].buffers[b][offset + i] );
+            }
+
+            wl_emu_send( emu, node, address, pkt, length );
+        }
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_checksum
+*
+*  Fletcher-32 checksum of the Write IQ samples (see wl_update_checksum)
+*
+******************************************************************************/
+static uint32 wl_emu_checksum( wl_emu_node *node, uint16 newdata, int reset ) {
+
+    if ( reset ) { node->sum1 = 0; node->sum2 = 0; }
+
+    node->sum1 = ( node->sum1 + newdata    ) % 0xFFFF;
+    node->sum2 = ( node->sum2 + node->sum1 ) % 0xFFFF;
+
+    return ( node->sum2 << 16 ) + node->sum1;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_write_iq
+*
+*  Handles a Write IQ sample packet:  stores the samples in every buffer of the
+*  buffer id, updates the checksum and answers with the checksum if requested
+*
+******************************************************************************/
+static void wl_emu_write_iq( wl_emulator *emu, int node, struct sockaddr_in *address, char *buffer, int size ) {
+
+    int                   b;
+    uint32                i;
+    uint32                buffer_id, start_sample, num_samples, word, checksum;
+    uint32               *payload;
+    int                   length;
+    char                  pkt[64];
+    wl_transport_header  *transport_hdr;
+    wl_sample_header     *sample_hdr;
+    wl_emu_node          *emu_node = &(emu->nodes[node]);
+
+    uint32                cmd_hdr_size = sizeof( wl_transport_header ) + sizeof( wl_command_header );
+    uint32                all_hdr_size = cmd_hdr_size + sizeof( wl_sample_header );
+
+    if ( size < (int) all_hdr_size ) {
+        emu->stats.unknown += 1;
+        return;
+    }
+
+    transport_hdr = (wl_transport_header *) buffer;
+    sample_hdr    = (wl_sample_header *) ( buffer + cmd_hdr_size );
+    payload       = (uint32 *) ( buffer + all_hdr_size );
+    buffer_id     = endian_swap_16( sample_hdr->buffer_id );
+    start_sample  = endian_swap_32( sample_hdr->start );
+    num_samples   = endian_swap_32( sample_hdr->num_samples );
+
+    // Written so that no term can wrap:  both fields come straight off the wire
+    if ( ( num_samples > ( size - all_hdr_size ) / 4 ) ||
+         ( start_sample >= WL_EMU_BUFFER_SAMPLES ) || ( num_samples > WL_EMU_BUFFER_SAMPLES - start_sample ) ) {
+        printf("WARNING:  Emulator node %d:  malformed Write IQ packet (start %d, %d samples) \n", emu_node->id, start_sample, num_samples);
+        emu->stats.unknown += 1;
+        return;
+    }
+
+    emu->stats.write_pkts += 1;
+
+    if ( emu->config.verbose ) {
+        printf("Node %d:  Write IQ buffer 0x%x, start %d, %d samples \n", emu_node->id, buffer_id, start_sample, num_samples);
+    }
+
+    for ( b = 0; b < WL_EMU_NUM_BUFFERS; b++ ) {
+        if ( ( buffer_id >> b ) & 0x1 ) {
+            for ( i = 0; i < num_samples; i++ ) {
+                emu_node->buffers[b][start_sample + i] = endian_swap_32( payload[i] );
+            }
+        }
+    }
+
+    // The checksum covers the start sample and the last sample of each packet
+    checksum = wl_emu_checksum( emu_node, start_sample & 0xFFFF, sample_hdr->flags & SAMPLE_CHKSUM_RESET );
+
+    if ( num_samples > 0 ) {
+        word     = endian_swap_32( payload[num_samples - 1] );
+        checksum = wl_emu_checksum( emu_node, ( word >> 16 ) ^ ( word & 0xFFFF ), 0 );
+    }
+
+    if ( endian_swap_16( transport_hdr->flags ) & TRANSPORT_FLAG_ROBUST ) {
+
+        length = cmd_hdr_size + sizeof( uint32 );
+
+        wl_emu_header( pkt, length, transport_hdr, WL_EMU_CMD_WRITE_IQ, 1 );
+        *( (uint32 *) ( pkt + cmd_hdr_size ) ) = endian_swap_32( checksum );
+
+        wl_emu_send( emu, node, address, pkt, length );
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_receive
+*
+*  Handles a packet received by a node
+*
+******************************************************************************/
+static void wl_emu_receive( wl_emulator *emu, int node, struct sockaddr_in *address, char *buffer, int size ) {
+
+    uint32                command_id;
+    int                   length;
+    char                  pkt[64];
+    wl_transport_header  *transport_hdr = (wl_transport_header *) buffer;
+
+    uint32                cmd_hdr_size = sizeof( wl_transport_header ) + sizeof( wl_command_header );
+
+    if ( size < (int) cmd_hdr_size ) {
+        emu->stats.unknown += 1;
+        return;
+    }
+
+    // Drop the packet before the node handles it (eg Write IQ samples that never reach the buffer)
+    if ( ( emu->config.rx_loss > 0.0 ) && ( wl_emu_random( emu ) < emu->config.rx_loss ) ) {
+        emu->stats.rx_dropped += 1;
+        return;
+    }
+
+    command_id = endian_swap_32( ( (wl_command_header *) ( buffer + sizeof( wl_transport_header ) ) )->command_id );
+
+    switch ( command_id ) {
+        case WL_EMU_CMD_READ_IQ:
+            wl_emu_read_iq( emu, node, address, buffer, size );
+        break;
+
+        case WL_EMU_CMD_WRITE_IQ:
+            wl_emu_write_iq( emu, node, address, buffer, size );
+        break;
+
+        default:
+            emu->stats.unknown += 1;
+
+            if ( emu->config.verbose ) {
+                printf("Node %d:  command 0x%08x ignored \n", emu->nodes[node].id, command_id);
+            }
+
+            // Acknowledge other commands so that callers waiting for a response do not time out
+            if ( endian_swap_16( transport_hdr->flags ) & TRANSPORT_FLAG_ROBUST ) {
+                length = cmd_hdr_size;
+                wl_emu_header( pkt, length, transport_hdr, command_id, 0 );
+                wl_emu_send( emu, node, address, pkt, length );
+            }
+        break;
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_poll
+*
+*  Waits up to timeout_ms (-1 to block) for packets, handles every packet
+*  queued on the node sockets and sends the delayed packets that are due
+*
+*  Returns:  Number of packets received
+*
+******************************************************************************/
+int wl_emu_poll( wl_emulator *emu, int timeout_ms ) {
+
+    int                   i;
+    int                   num_fds;
+    int                   size;
+    int                   num_rcvd           = 0;
+    long long             next_ns;
+    socklen_t             address_size;
+    struct sockaddr_in    address;
+    struct pollfd         fds[WL_EMU_MAX_NODES + 1];
+    struct timespec       timeout;
+
+    num_fds = emu->config.num_nodes;
+
+    for ( i = 0; i < num_fds; i++ ) {
+        fds[i].fd     = emu->nodes[i].handle;
+        fds[i].events = POLLIN;
+    }
+
+    if ( emu->trigger_handle >= 0 ) {
+        fds[num_fds].fd     = emu->trigger_handle;
+        fds[num_fds].events = POLLIN;
+        num_fds            += 1;
+    }
+
+    // Wake up in time for the next delayed packet
+    next_ns = wl_emu_flush( emu );
+
+    if ( ( timeout_ms >= 0 ) && ( ( next_ns < 0 ) || ( next_ns > timeout_ms * 1000000LL ) ) ) {
+        next_ns = timeout_ms * 1000000LL;
+    }
+
+    timeout.tv_sec  = (time_t) ( next_ns / 1000000000LL );
+    timeout.tv_nsec = (long) ( next_ns % 1000000000LL );
+
+    if ( ppoll( fds, num_fds, ( next_ns < 0 ) ? NULL : &timeout, NULL ) < 0 ) {
+        if ( errno != EINTR ) {
+            die_with_error("Error:  Emulator poll failed.");
+        }
+        return 0;
+    }
+
+    for ( i = 0; i < num_fds; i++ ) {
+
+        if ( ( fds[i].revents & POLLIN ) == 0 ) {
+            continue;
+        }
+
+        // Drain the socket
+        while ( 1 ) {
+            address_size = sizeof( address );
+            size         = recvfrom( fds[i].fd, emu->rcvd_buffer, WL_EMU_MAX_PKT_LENGTH, MSG_DONTWAIT,
+                                     (struct sockaddr *) &address, &address_size );
+
+            if ( size < 0 ) {
+                break;
+            }
+
+            num_rcvd          += 1;
+            emu->stats.rx_pkts += 1;
+
+            if ( fds[i].fd == emu->trigger_handle ) {
+                emu->stats.triggers += 1;
+
+                if ( emu->config.verbose ) {
+                    printf("Trigger from %s \n", inet_ntoa( address.sin_addr ));
+                }
+            } else {
+                wl_emu_receive( emu, i, &address, emu->rcvd_buffer, size );
+            }
+        }
+    }
+
+    wl_emu_flush( emu );
+
+    return num_rcvd;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_start / wl_emu_stop
+*
+*  Runs the emulator on a background thread so that a test can drive the
+*  transport against it from the same process
+*
+******************************************************************************/
+static void * wl_emu_thread( void *arg ) {
+
+    wl_emulator *emu = (wl_emulator *) arg;
+
+    while ( emu->running ) {
+        wl_emu_poll( emu, 10 );
+    }
+
+    return NULL;
+}
+
+int wl_emu_start( wl_emulator *emu ) {
+
+    if ( emu->running ) {
+        return 0;
+    }
+
+    emu->running = 1;
+
+    if ( pthread_create( &(emu->thread), NULL, wl_emu_thread, emu ) != 0 ) {
+        emu->running = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+void wl_emu_stop( wl_emulator *emu ) {
+
+    if ( emu->running ) {
+        emu->running = 0;
+        pthread_join( emu->thread, NULL );
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_emu_print_stats
+*
+*  Prints the emulator counters
+*
+******************************************************************************/
+void wl_emu_print_stats( wl_emulator *emu ) {
+
+    wl_emu_stats *stats = &(emu->stats);
+
+    printf("Emulator:  %llu packets received, %llu sent, %llu dropped, %llu reordered, %llu dropped on receive \n",
+           (unsigned long long) stats->rx_pkts, (unsigned long long) stats->tx_pkts,
+           (unsigned long long) stats->dropped, (unsigned long long) stats->reordered,
+           (unsigned long long) stats->rx_dropped);
+    printf("           %llu Read IQ commands, %llu Write IQ packets, %llu triggers, %llu other \n",
+           (unsigned long long) stats->read_cmds, (unsigned long long) stats->write_pkts,
+           (unsigned long long) stats->triggers, (unsigned long long) stats->unknown);
+}
+
+#endif
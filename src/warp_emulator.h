@@ -0,0 +1,125 @@
+#ifndef WARP_EMULATOR_H
+#define WARP_EMULATOR_H
+
+/***************************** Include Files *********************************/
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+
+
+/*************************** Constant Definitions ****************************/
+
+// WARPLab commands answered by the emulator
+#define WL_EMU_CMD_WRITE_IQ             0x30000007
+#define WL_EMU_CMD_READ_IQ              0x30000008
+
+// Node addressing (node n is <subnet>(n+1) : WL_EMU_NODE_PORT + n)
+#define WL_EMU_NODE_PORT                9000
+#define WL_EMU_TRIGGER_PORT             10000
+#define WL_EMU_MAX_NODES                64
+
+// RF buffers of each node (buffer ids 0x1, 0x2, 0x4, 0x8)
+#define WL_EMU_NUM_BUFFERS              4
+#define WL_EMU_BUFFER_SAMPLES           32768
+
+// Max size of a packet handled by the emulator
+#define WL_EMU_MAX_PKT_LENGTH           9050
+
+
+/*************************** Variable Definitions ****************************/
+
+// Emulator configuration (see wl_emu_default_config)
+//     NOTE:  Impairments are applied to every packet sent by the nodes.  Latency and jitter
+//         delay a packet; a reordered packet is delayed by reorder_us more so that the
+//         packets sent after it overtake it.  Packets sent to the nodes (commands and Write 
+//         IQ samples) are only dropped, with probability rx_loss, before they are handled.
+typedef struct
+{
+    char               subnet[16];        // Node subnet (eg "10.0.0." or "127.0.0.")
+    int                first_id;          // Node id of the first node
+    int                num_nodes;         // Number of nodes
+    double             latency_us;        // Fixed latency added to every response packet
+    double             jitter_us;         // Uniform random latency in [0, jitter_us) added on top
+    double             loss;              // Probability that a response packet is dropped
+    double             reorder;           // Probability that a response packet is reordered
+    double             reorder_us;        // Extra delay of a reordered packet
+    double             rx_loss;           // Probability that a packet sent to a node is dropped
+    unsigned int       seed;              // Seed of the impairment random numbers
+    int                bind_trigger;      // Listen for triggers on WL_EMU_TRIGGER_PORT
+    int                verbose;           // Print every command
+} wl_emu_config;
+
+// Emulator counters
+typedef struct
+{
+    uint64_t           rx_pkts;           // Packets received by the nodes
+    uint64_t           tx_pkts;           // Packets sent by the nodes
+    uint64_t           dropped;           // Packets dropped by the loss impairment
+    uint64_t           rx_dropped;        // Packets to the nodes dropped by the rx_loss impairment
+    uint64_t           reordered;         // Packets reordered by the reorder impairment
+    uint64_t           read_cmds;         // Read IQ commands
+    uint64_t           write_pkts;        // Write IQ sample packets
+    uint64_t           triggers;          // Trigger packets
+    uint64_t           unknown;           // Packets of other commands or malformed packets
+} wl_emu_stats;
+
+// Response packet waiting to be sent
+typedef struct
+{
+    struct timespec    due;               // Time the packet is sent
+    uint64_t           order;             // Keeps packets due at the same time in order
+    int                node;              // Index of the sending node
+    struct sockaddr_in address;           // Destination of the packet
+    int                length;            // Length of the packet
+    char              *data;              // Packet
+} wl_emu_pkt;
+
+// Emulated node
+typedef struct
+{
+    int                handle;            // Socket bound to the node address
+    int                id;                // Node id
+    uint32_t          *buffers[WL_EMU_NUM_BUFFERS];  // RF buffers (sample words, host byte order)
+    uint32_t           sum1;              // Fletcher-32 state of Write IQ
+    uint32_t           sum2;
+} wl_emu_node;
+
+// Emulator
+typedef struct
+{
+    wl_emu_config      config;
+    wl_emu_node       *nodes;
+    int                trigger_handle;    // Trigger socket (-1 if not bound)
+    wl_emu_pkt        *queue;             // Delayed packets (min-heap on due time)
+    int                queue_length;
+    int                queue_size;
+    uint64_t           order;
+    unsigned int       rand_state;
+    wl_emu_stats       stats;
+    char              *rcvd_buffer;
+    volatile int       running;           // Background thread is running (see wl_emu_start)
+    pthread_t          thread;
+} wl_emulator;
+
+
+/*************************** Function Prototypes *****************************/
+
+void          wl_emu_default_config( wl_emu_config *config );
+wl_emulator * wl_emu_create( const wl_emu_config *config );
+void          wl_emu_destroy( wl_emulator *emu );
+
+// Process packets for up to timeout_ms (-1 to block); returns the number of packets received
+int           wl_emu_poll( wl_emulator *emu, int timeout_ms );
+
+// Run the emulator on a background thread
+int           wl_emu_start( wl_emulator *emu );
+void          wl_emu_stop( wl_emulator *emu );
+
+// RF buffer of a node (index in to the nodes of the emulator, buffer 0 - 3) and its initial contents
+uint32_t *    wl_emu_buffer( wl_emulator *emu, int node, int buffer );
+uint32_t      wl_emu_pattern( int node_id, int buffer, int sample );
+
+void          wl_emu_print_stats( wl_emulator *emu );
+
+#endif
@@ -3,6 +3,103 @@
 #include "warp_transport.h"
 #include <string.h>
 
+// subnet of the nodes: node n is at <node_subnet>(n+1)
+static char node_subnet[16] = "10.0.0.";
+
+// number of node addresses on the subnet (.1 to .254)
+#define NODES_MAX 254
+
+// ID of the host (10.0.0.210) the request headers of the node descriptors are built for
+#define NODES_HOST_ID 210
+
+// request headers: transport header (destination node ID at byte 3, source host ID at byte 5) and command
+static const char readIQ_hdr[42] =  {0, 0, 0, 0, 0, 0, 0, 1, 0, 28, 0, 10, 0, 0, 48, 0, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+static const char writeIQ_hdr[22] =  {0, 0, 0, 0, 0, 0, 0, 1, 0, 8, 0, 9, 0, 0, 48, 0, 0, 7, 0, 0, 0, 0};
+
+// node descriptor, built once so the read/write functions do not format or parse addresses
+typedef struct {
+	char ip_addr[20];			// address of the node: <node_subnet>(n+1)
+	int port;					// port of the node: 9000+n
+	uint32 address;				// address of the node in network byte order
+	int node_id;				// ID of the node in the transport header: n
+	int host_id;				// ID of the host in the request headers below (NODES_HOST_ID)
+	char read_hdr[42];			// Read IQ request from host_id to the node
+	char write_hdr[22];			// Write IQ command header from host_id to the node
+} node_desc;
+
+static node_desc nodes[NODES_MAX];
+static int nodes_described = 0;
+
+/*
+Description: (re)build the node descriptors for the current subnet
+*/
+static void nodes_describe(){
+
+	int num;
+	for (num = 0; num < NODES_MAX; num++){
+		sprintf(nodes[num].ip_addr, "%s%d", node_subnet, num+1);
+		nodes[num].port = 9000 + num;
+		nodes[num].address = inet_addr(nodes[num].ip_addr);
+		nodes[num].node_id = num;
+		nodes[num].host_id = NODES_HOST_ID;
+
+		memcpy(nodes[num].read_hdr, readIQ_hdr, sizeof(readIQ_hdr));
+		nodes[num].read_hdr[3] = num;
+		nodes[num].read_hdr[5] = NODES_HOST_ID;
+
+		memcpy(nodes[num].write_hdr, writeIQ_hdr, sizeof(writeIQ_hdr));
+		nodes[num].write_hdr[3] = num;
+		nodes[num].write_hdr[5] = NODES_HOST_ID;
+	}
+
+	nodes_described = 1;
+}
+
+/*
+Description: descriptor of a node (see nodes_describe)
+*/
+static const node_desc* node_get(int node_id){
+
+	assert(node_id >= 0 && node_id < NODES_MAX);
+
+	if (!nodes_described){
+		nodes_describe();
+	}
+
+	return &nodes[node_id];
+}
+
+/*
+Description: copy the header of a request from a host to a node in to hdr: the prebuilt one of the 
+node descriptor, or hdr_template with the IDs filled in for other hosts. The transport writes the
+command arguments in to the header, so the descriptor copy is never handed out itself.
+*/
+static char* node_header(const node_desc* node, const char* node_hdr, const char* hdr_template, int length, int host_id, char* hdr){
+
+	if (host_id == node->host_id){
+		memcpy(hdr, node_hdr, length);
+	} else {
+		memcpy(hdr, hdr_template, length);
+		hdr[3] = node->node_id;
+		hdr[5] = host_id;
+	}
+
+	return hdr;
+}
+
+/*
+Description: connect the socket to the node on its first exchange, so packets are sent without an
+address and the kernel drops datagrams from other nodes; a socket that already talked to another
+node (eg by readIQ_multi) is not connected (see connect_socket_once)
+*/
+static void node_connect(int node_sock, const node_desc* node){
+
+	connect_socket_once(node_sock, (char*) node->ip_addr, node->port);
+}
+
+// socket of sendTrigger (-1 until the first trigger)
+static int trig_sock = -1;
+
 /*
 Description: Initialization function to create the socket handles 
 and set the buffer size
@@ -20,8 +117,17 @@ void nodes_initialize(int* node_sock , int numNodes){
        init_wl_mex_udp_transport();    
   	}	
 
+	// nodes on another subnet (eg the node emulator on 127.0.0.x)
+	if (getenv("WARP_NODE_SUBNET") != NULL){
+		nodes_set_subnet(getenv("WARP_NODE_SUBNET"));
+	}
+
 
 
+	if (!nodes_described){
+		nodes_describe();
+	}
+
 	int num;
 	for (num= 0; num < numNodes; num++){
 		node_sock[num] = init_socket(); // socket handle for each node
@@ -44,6 +150,14 @@ void nodes_initialize(int* node_sock , int numNodes){
 		if  (os_size < REQUESTED_BUFF_SIZE){
 			 // printf("OS reduced send buff for sock %d to %d \n", node_sock[num], os_size);
 		}
+
+		// drain sample packets with one recvmmsg call instead of one recvfrom per packet
+		set_receive_batch( node_sock[num] , 1 );
+
+		// preallocate all packet and sample buffers so reads and writes do not touch the heap
+		init_socket_context( node_sock[num], TRANSPORT_MAX_SAMPLES );
+
+		// the socket is connected to the node of its first read/write (see node_connect)
 	}		
 }
 
@@ -63,6 +177,212 @@ void nodes_disable(int* node_sock, int numNodes){
 }
 
 
+/*
+Description: select how the read/write functions wait for responses from the nodes
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	mode (int)					- 0 to spin on the socket, 1 to sleep until a packet arrives, 2 to spin
+								  for a while and then sleep (see nodes_set_wait_spin)
+	timeout_ms (int)			- upper bound in ms of the response timeouts, which adapt to the round trip
+								  time of each node (0 for the default, see nodes_get_rtt)
+*/
+void nodes_set_wait_mode(int* node_sock, int numNodes, int mode, int timeout_ms){
+
+	int num;
+	for (num=0; num < numNodes; num++){
+		set_wait_mode(node_sock[num], (mode == 2) ? TRANSPORT_WAIT_HYBRID : (mode ? TRANSPORT_WAIT_EVENT : TRANSPORT_WAIT_SPIN));
+		set_so_timeout(node_sock[num], timeout_ms);
+	}
+}
+
+
+/*
+Description: set how long the hybrid wait mode (see nodes_set_wait_mode) spins before it sleeps, 
+and optionally busy poll the network device while spinning (SO_BUSY_POLL)
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	spin_us (int)				- time in us a wait spins on the socket before it sleeps (default 50)
+	busy_poll_us (int)			- time in us a receive busy polls the device queue (0 to leave it off;
+								  above net.core.busy_read it needs CAP_NET_ADMIN)
+*/
+void nodes_set_wait_spin(int* node_sock, int numNodes, int spin_us, int busy_poll_us){
+
+	int num;
+	for (num=0; num < numNodes; num++){
+		set_wait_spin(node_sock[num], spin_us, busy_poll_us);
+	}
+}
+
+
+/*
+Description: receive the packets of the nodes through a memory mapped ring (AF_PACKET, TPACKET_V3)
+instead of the socket; sample packets are decoded straight from the ring. Needs CAP_NET_RAW; the
+sockets fall back to normal receives if the ring cannot be set up.
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	ifname (const char*)		- interface the nodes are attached to (eg "eth1"; NULL for all interfaces)
+	ring_mb (int)				- size in MB of the ring of each socket (0 for the default; -1 to go back
+								  to normal receives)
+*/
+void nodes_set_receive_ring(int* node_sock, int numNodes, const char* ifname, int ring_mb){
+
+	int num;
+	for (num=0; num < numNodes; num++){
+		if (ring_mb < 0){
+			free_receive_ring(node_sock[num]);
+		} else {
+			set_receive_ring(node_sock[num], ifname, (ring_mb > 0) ? (ring_mb << 20) : TRANSPORT_RING_SIZE);
+		}
+	}
+}
+
+
+/*
+Description: select how the write functions pace the packets sent to the nodes; packets leave at 
+departure times spaced by the gap the node needs to keep up (or by the target rate)
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	mode (int)					- 0 to wait for each departure time on the host (sleep, then spin), 
+								  1 to hand the departure time to the kernel (SO_TXTIME, needs the fq qdisc;
+								  falls back to 0 if not supported)
+	rate_mbps (int)				- target rate in Mbps of the writes to each node (0 for the gap the node needs)
+*/
+void nodes_set_write_pacing(int* node_sock, int numNodes, int mode, int rate_mbps){
+
+	int num;
+	for (num=0; num < numNodes; num++){
+		set_write_pacing(node_sock[num], mode ? TRANSPORT_PACE_TXTIME : TRANSPORT_PACE_SPIN, rate_mbps);
+	}
+}
+
+
+/*
+Description: set the subnet of the nodes
+
+Arguments: 
+	subnet (const char*)		- first three bytes of the node addresses with the trailing dot (eg "10.0.0.")
+*/
+void nodes_set_subnet(const char* subnet){
+
+	assert(strlen(subnet) < sizeof(node_subnet));
+
+	strcpy(node_subnet, subnet);
+
+	if (nodes_described){
+		nodes_describe();
+	}
+}
+
+
+/*
+Description: copy the transport statistics of a node (packets, bytes, retries, timeouts, 
+checksum errors and read / write latency histograms, summed over all sockets)
+
+Arguments: 
+	node_id (int)				- identifier of the node
+	stats (wl_stats*)			- returned statistics
+
+Returns: 0 on success, -1 if nothing was exchanged with the node since the last reset
+*/
+int nodes_get_stats(int node_id, wl_stats* stats){
+
+	return wl_stats_get_node(node_get(node_id)->address, stats);
+}
+
+
+/*
+Description: copy the round trip time estimate of a node (see warp_rtt.h); the response 
+timeouts of the read/write functions are derived from it
+
+Arguments: 
+	node_id (int)				- identifier of the node
+	op (int)					- WL_RTT_READ (command to first sample packet) or WL_RTT_WRITE (last packet to ack)
+	rtt (wl_rtt*)				- returned estimate
+
+Returns: 0 on success, -1 if the node has no estimate yet
+*/
+int nodes_get_rtt(int node_id, int op, wl_rtt* rtt){
+
+	return wl_rtt_get(node_get(node_id)->address, op, rtt);
+}
+
+
+/*
+Description: reset the transport statistics of all sockets and nodes
+*/
+void nodes_reset_stats(){
+
+	wl_stats_reset();
+}
+
+
+/*
+Description: write the transport statistics of all sockets and nodes as JSON
+
+Arguments: 
+	fp (FILE*)					- output stream (eg stdout)
+*/
+void nodes_dump_stats(FILE* fp){
+
+	wl_stats_dump_json(fp);
+}
+
+
+/*
+Description: turn the per-operation trace records on or off
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	enable (int)				- 1 to record, 0 to stop
+	kernel_stamps (int)			- 1 to also record the kernel receive time of sample packets
+*/
+void nodes_set_trace(int* node_sock, int numNodes, int enable, int kernel_stamps){
+
+	int num;
+	for (num=0; num < numNodes; num++){
+		set_receive_timestamps(node_sock[num], enable && kernel_stamps);
+	}
+
+	if (enable){
+		wl_trace_reset();
+	}
+	wl_trace_enable(enable);
+}
+
+
+/*
+Description: write the trace records collected since tracing was turned on, one JSON object per line
+
+Arguments: 
+	fp (FILE*)					- output stream
+*/
+void nodes_dump_trace(FILE* fp){
+
+	wl_trace_dump_json(fp);
+}
+
+
+/*
+Description: print the mean time spent in each phase of the collected reads/writes
+
+Arguments: 
+	fp (FILE*)					- output stream
+*/
+void nodes_trace_summary(FILE* fp){
+
+	wl_trace_print_summary(fp);
+}
+
+
 /*
  Description: send a broadcast trigger to all WARP nodes in the setup
 */
@@ -70,16 +390,21 @@ void sendTrigger(){
 
 	assert(initialized ==1);
 	
-	int trig_sock = init_socket(); 
+	// the trigger socket is opened on the first trigger and kept for the next ones
+	if (trig_sock < 0){
+		trig_sock = init_socket(); 
+
+		get_send_buffer_size(trig_sock);
+		get_receive_buffer_size(trig_sock);
+	}
 
-	get_send_buffer_size(trig_sock);
-    get_receive_buffer_size(trig_sock);
 	char trig_buffer[18] = {0, 0, 255, 255, 0, 202, 0, 0, 0, 4, 0, 13, 0, 0, 0, 0, 0, 1};
 
-	// port 10000 is used for broadcast
-	sendData(trig_sock, trig_buffer, sizeof(trig_buffer), "10.0.0.255", 10000);
+	char trig_ip_addr[20];
+	sprintf(trig_ip_addr, "%s255", node_subnet);
 
-	close_socket(trig_sock);
+	// port 10000 is used for broadcast
+	sendData(trig_sock, trig_buffer, sizeof(trig_buffer), trig_ip_addr, 10000);
 }
 
 
@@ -97,22 +422,105 @@ void sendTrigger(){
 */
 void readIQ(double complex* samples, int start_sample, int num_samples, int node_sock, int node_id, int buffer_id, int host_id){
 
+	readIQ_fmt(samples, WL_SAMPLE_DOUBLE, start_sample, num_samples, node_sock, node_id, buffer_id, host_id);
+}
+
+/*
+ Description: same as readIQ, but stores the samples in the given format so compact formats
+ are decoded straight from the packets without going through double 
+ 
+ Arguments: 
+	samples (void*) 				- pointer to sample array 
+	format (int)					- format of the sample array:
+									  WL_SAMPLE_DOUBLE (double complex), WL_SAMPLE_FLOAT (float complex) or
+									  WL_SAMPLE_INT16 (interleaved int16 I/Q pairs, Q15; 2 int16 per sample)
+	(remaining arguments as in readIQ)
+*/
+void readIQ_fmt(void* samples, int format, int start_sample, int num_samples, int node_sock, int node_id, int buffer_id, int host_id){
+
 	assert(initialized==1);
 
-	int node_port = 9000 + node_id; // source port at host for node	
+	const node_desc* node = node_get(node_id);
 	int max_length =  8928;//1438, 8938 1422, 8928; // number of bytes available for IQ samples after all headers
-	int num_pkts = (int)(num_samples*4/max_length) + 1 ;
-	
-	char readIQ_buffer[42] =  {0, 0, 0, node_id, 0, host_id, 0, 1, 0, 28, 0, 10, 0, 0, 48, 0, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+	int num_pkts = (num_samples*4 + max_length - 1)/max_length;
 	
-	char base_ip_addr[20];
-	char str[15];
-	sprintf(str, "%d", node_id+1);
+	char readIQ_buffer[42];
+	char* hdr = node_header(node, node->read_hdr, readIQ_hdr, 42, host_id, readIQ_buffer);
+
+	node_connect(node_sock, node);
+
+	readSamplesFormat(samples, format, node_sock, hdr , 42, (char*) node->ip_addr, node->port, num_samples, (uint32) buffer_id, start_sample, max_length, num_pkts);    
+}
+
+/*
+ Description: read IQ samples from several WARP nodes over a single socket from the calling thread;
+ sample packets are routed to the node arrays by their source address
+ 
+ Arguments: 
+	samples (double complex**) 		- array of sample arrays, one per node 
+	start_sample (int)				- offset to the first sample to read
+	num_samples (int)				- number of samples to read from each node (between 1 and 2^15)
+	node_sock (int)					- identifier of the socket shared by all nodes  
+	node_ids (int*)					- identifiers of the nodes  
+	numNodes (int)					- number of nodes
+	buffer_id (int)					- identifier of the buffer
+	host_id (int)					- identifier of the host 
+*/
+void readIQ_multi(double complex** samples, int start_sample, int num_samples, int node_sock, int* node_ids, int numNodes, int buffer_id, int host_id){
+
+	readIQ_multi_fmt((void**) samples, WL_SAMPLE_DOUBLE, start_sample, num_samples, node_sock, node_ids, numNodes, buffer_id, host_id);
+}
+
+/*
+ Description: same as readIQ_multi, but stores the samples in the given format (see readIQ_fmt)
+ 
+ Arguments: 
+	samples (void**) 				- array of sample arrays, one per node 
+	format (int)					- format of the sample arrays (WL_SAMPLE_*)
+	(remaining arguments as in readIQ_multi)
+*/
+void readIQ_multi_fmt(void** samples, int format, int start_sample, int num_samples, int node_sock, int* node_ids, int numNodes, int buffer_id, int host_id){
+
+	assert(initialized==1);
+
+	int max_length =  8928; // number of bytes available for IQ samples after all headers
+	int num;
+
+	char readIQ_buffers[numNodes][42];
+	char* buffers[numNodes];
+	char* ip_addrs[numNodes];
+	int node_ports[numNodes];
+
+	for (num = 0; num < numNodes; num++){
+
+		const node_desc* node = node_get(node_ids[num]);
 
-	strcpy(base_ip_addr, "10.0.0.");
-	strcat(base_ip_addr, str);	  
+		buffers[num] = node_header(node, node->read_hdr, readIQ_hdr, 42, host_id, readIQ_buffers[num]);
+		ip_addrs[num] = (char*) node->ip_addr;
+		node_ports[num] = node->port;
+	}
+
+	// a socket used for one node only (eg by readIQ_buffers) may stay connected to it
+	if (numNodes == 1){
+		node_connect(node_sock, node_get(node_ids[0]));
+	}
+
+	readSamplesMulti(samples, format, node_sock, buffers, 42, ip_addrs, node_ports, numNodes, num_samples, (uint32) buffer_id, start_sample, max_length);
+}
+
+/*
+ Description: read IQ samples from several RF buffers of a given WARP node with one request;
+ sample packets are routed to the buffer arrays by their buffer ID
+ 
+ Arguments: 
+	samples (void**) 				- array of sample arrays, one per buffer of the mask in increasing bit order
+	format (int)					- format of the sample arrays (WL_SAMPLE_*)
+	buffer_mask (int)				- buffers to read: 1 for RFA, 2 for RFB, 4 for RFC, 8 for RFD
+	(remaining arguments as in readIQ)
+*/
+void readIQ_buffers(void** samples, int format, int start_sample, int num_samples, int node_sock, int node_id, int buffer_mask, int host_id){
 
-	readSamples(samples, node_sock, readIQ_buffer , 42, base_ip_addr, node_port, num_samples, (uint32) buffer_id, start_sample, max_length, num_pkts);    
+	readIQ_multi_fmt(samples, format, start_sample, num_samples, node_sock, &node_id, 1, buffer_mask, host_id);
 }
 
 /*
@@ -129,37 +537,86 @@ void readIQ(double complex* samples, int start_sample, int num_samples, int node
 */
 void writeIQ(double complex* samples, int start_sample, int num_samples, int node_sock, int node_id, int buffer_id, int host_id){
 
+	writeIQ_fmt(samples, WL_SAMPLE_DOUBLE, start_sample, num_samples, node_sock, node_id, buffer_id, host_id);
+}
+
+/*
+ Description: same as writeIQ, but takes the samples in the given format so compact formats
+ are encoded straight in to the packets without going through double 
+ 
+ Arguments: 
+	samples (const void*) 			- pointer to sample array 
+	format (int)					- format of the sample array (WL_SAMPLE_DOUBLE, WL_SAMPLE_FLOAT or WL_SAMPLE_INT16)
+	(remaining arguments as in writeIQ)
+*/
+void writeIQ_fmt(const void* samples, int format, int start_sample, int num_samples, int node_sock, int node_id, int buffer_id, int host_id){
+
 	// assert(initialized==1);
 
-	int node_port = 9000 + node_id; // source port at host for node	
+	const node_desc* node = node_get(node_id);
 	int max_length =  8928;//1438, 8938 1422, 8928; // number of bytes available for IQ samples after all headers
-	int num_pkts = (int)(num_samples*4/max_length) + 1;
+	int num_pkts = (num_samples*4 + max_length - 1)/max_length;
 	int max_samples = 2232; //366 2232	
 
-	char writeIQ_buffer[22] =  {0, 0, 0, node_id, 0, host_id, 0, 1, 0, 8, 0, 9, 0, 0, 48, 0, 0, 7, 0, 0, 0, 0};
+	char writeIQ_buffer[22];
+	char* hdr = node_header(node, node->write_hdr, writeIQ_hdr, 22, host_id, writeIQ_buffer);
 
-	uint16* sample_I_buffer = (uint16* ) malloc(num_samples*sizeof(uint16));
-	uint16* sample_Q_buffer = (uint16* ) malloc(num_samples*sizeof(uint16));
-	
-	bzero(sample_I_buffer, num_samples*sizeof(uint16));
-	bzero(sample_Q_buffer, num_samples*sizeof(uint16));
+	node_connect(node_sock, node);
 
-	int index;
+	// samples are quantized to UFix_16_15 (saturating) straight in to the packets
+	writeSamplesFormat(node_sock, hdr, 8962, (char*) node->ip_addr, node->port, num_samples, format, samples, (uint32) buffer_id, start_sample, num_pkts, max_samples, TRANSPORT_WARP_HW_v3);
 
-	for (index = 0; index < num_samples; index++){	  
-	  sample_I_buffer[index] = (uint16) pow(2,15)*creal(samples[index]); //UFix_16_15
-	  sample_Q_buffer[index] = (uint16) pow(2,15)*cimag(samples[index]);
-	}
+}
+
+/*
+ Description: encode samples once for writeIQ_waveform, which can then write them to any node 
+ any number of times without quantizing or encoding them again
+ 
+ Arguments: 
+	samples (const void*) 			- pointer to sample array 
+	format (int)					- format of the sample array (WL_SAMPLE_DOUBLE, WL_SAMPLE_FLOAT or WL_SAMPLE_INT16)
+	start_sample (int)				- offset to the first sample to write
+	num_samples (int)				- number of samples to write (between 1 and 2^15)
+
+ Returns: waveform handle (free with writeIQ_free)
+*/
+wl_waveform* writeIQ_prepare(const void* samples, int format, int start_sample, int num_samples){
 
-	char base_ip_addr[20];
-	char str[15];
-	sprintf(str, "%d", node_id+1);
+	int max_samples = 2232; // samples per packet, as in writeIQ_fmt
 
-	strcpy(base_ip_addr, "10.0.0.");
-	strcat(base_ip_addr, str);
+	return wl_waveform_create(format, samples, start_sample, num_samples, max_samples);
+}
 
-	writeSamples(node_sock, writeIQ_buffer, 8962, (char*) base_ip_addr, node_port, num_samples, sample_I_buffer, sample_Q_buffer, (uint32) buffer_id, start_sample, num_pkts, max_samples, TRANSPORT_WARP_HW_v3);
+/*
+ Description: write a waveform prepared with writeIQ_prepare to a given WARP node; only the 
+ transport and command headers of the packets are filled in
+ 
+ Arguments: 
+	waveform (const wl_waveform*) 	- waveform handle (may be written to several nodes from different threads)
+	node_sock (int)					- identifier of the node socket  
+	node_id (int)					- identifier of the node  
+	buffer_id (int)					- identifier of the buffer
+	host_id (int)					- identifier of the host 
+*/
+void writeIQ_waveform(const wl_waveform* waveform, int node_sock, int node_id, int buffer_id, int host_id){
+
+	const node_desc* node = node_get(node_id);
+
+	char writeIQ_buffer[22];
+	char* hdr = node_header(node, node->write_hdr, writeIQ_hdr, 22, host_id, writeIQ_buffer);
+
+	node_connect(node_sock, node);
+
+	writeSamplesWaveform(node_sock, hdr, 8962, (char*) node->ip_addr, node->port, waveform, (uint32) buffer_id, TRANSPORT_WARP_HW_v3);
+}
+
+/*
+ Description: free a waveform prepared with writeIQ_prepare
+ 
+ Arguments: 
+	waveform (wl_waveform*) 		- waveform handle
+*/
+void writeIQ_free(wl_waveform* waveform){
 
-	free(sample_I_buffer);
-	free(sample_Q_buffer);
+	wl_waveform_free(waveform);
 }
\ No newline at end of file
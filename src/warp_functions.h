@@ -1,5 +1,9 @@
 // Header file to define the basic functions
 #include <complex.h>
+#include "warp_kernels.h"
+#include "warp_stats.h"
+#include "warp_trace.h"
+#include "warp_rtt.h"
 
 
 /*
@@ -21,6 +25,139 @@ Arguments:
 */
 void nodes_disable(int* node_sock, int numNodes); 
 
+/*
+Description: select how the read/write functions wait for responses from the nodes
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	mode (int)					- 0 to spin on the socket, 1 to sleep until a packet arrives, 2 to spin
+								  for a while and then sleep (see nodes_set_wait_spin)
+	timeout_ms (int)			- upper bound in ms of the response timeouts, which adapt to the round trip
+								  time of each node (0 for the default, see nodes_get_rtt)
+*/
+void nodes_set_wait_mode(int* node_sock, int numNodes, int mode, int timeout_ms);
+
+/*
+Description: set how long the hybrid wait mode (mode 2 of nodes_set_wait_mode) spins before it 
+sleeps, and optionally busy poll the network device while spinning (SO_BUSY_POLL); the statistics
+count how many waits ended while spinning, after sleeping or with a timeout
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	spin_us (int)				- time in us a wait spins on the socket before it sleeps (default 50)
+	busy_poll_us (int)			- time in us a receive busy polls the device queue (0 to leave it off;
+								  above net.core.busy_read it needs CAP_NET_ADMIN)
+*/
+void nodes_set_wait_spin(int* node_sock, int numNodes, int spin_us, int busy_poll_us);
+
+/*
+Description: receive the packets of the nodes through a memory mapped ring (AF_PACKET, TPACKET_V3)
+instead of the socket; sample packets are decoded straight from the ring. Needs CAP_NET_RAW; the
+sockets fall back to normal receives if the ring cannot be set up.
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	ifname (const char*)		- interface the nodes are attached to (eg "eth1"; NULL for all interfaces)
+	ring_mb (int)				- size in MB of the ring of each socket (0 for the default; -1 to go back
+								  to normal receives)
+*/
+void nodes_set_receive_ring(int* node_sock, int numNodes, const char* ifname, int ring_mb);
+
+/*
+Description: select how the write functions pace the packets sent to the nodes; packets leave at 
+departure times spaced by the gap the node needs to keep up (or by the target rate)
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	mode (int)					- 0 to wait for each departure time on the host (sleep, then spin), 
+								  1 to hand the departure time to the kernel (SO_TXTIME, needs the fq qdisc;
+								  falls back to 0 if not supported)
+	rate_mbps (int)				- target rate in Mbps of the writes to each node (0 for the gap the node needs)
+*/
+void nodes_set_write_pacing(int* node_sock, int numNodes, int mode, int rate_mbps);
+
+/*
+Description: set the subnet of the nodes (default "10.0.0."; also set from the WARP_NODE_SUBNET
+environment variable by nodes_initialize)
+
+Arguments: 
+	subnet (const char*)		- first three bytes of the node addresses with the trailing dot
+*/
+void nodes_set_subnet(const char* subnet);
+
+/*
+Description: copy the transport statistics of a node (packets, bytes, retries, timeouts, 
+checksum errors and read / write latency histograms, summed over all sockets)
+
+Arguments: 
+	node_id (int)				- identifier of the node
+	stats (wl_stats*)			- returned statistics
+
+Returns: 0 on success, -1 if nothing was exchanged with the node since the last reset
+*/
+int nodes_get_stats(int node_id, wl_stats* stats);
+
+/*
+Description: copy the round trip time estimate of a node (see warp_rtt.h); the response 
+timeouts of the read/write functions are derived from it
+
+Arguments: 
+	node_id (int)				- identifier of the node
+	op (int)					- WL_RTT_READ (command to first sample packet) or WL_RTT_WRITE (last packet to ack)
+	rtt (wl_rtt*)				- returned estimate
+
+Returns: 0 on success, -1 if the node has no estimate yet
+*/
+int nodes_get_rtt(int node_id, int op, wl_rtt* rtt);
+
+/*
+Description: reset the transport statistics of all sockets and nodes
+*/
+void nodes_reset_stats();
+
+/*
+Description: write the transport statistics of all sockets and nodes as JSON
+
+Arguments: 
+	fp (FILE*)					- output stream (eg stdout)
+*/
+void nodes_dump_stats(FILE* fp);
+
+/*
+Description: turn the per-operation trace records on or off (see warp_trace.h); every read/write
+then records when the request was sent, when the first and last packets arrived, the time spent
+decoding / encoding, sending, waiting for the ack and pacing, and the retransmit rounds.
+Turning tracing on drops the records collected so far.
+
+Arguments: 
+	node_sock(int*)				- socket handle array
+	numNodes (int)				- number of nodes
+	enable (int)				- 1 to record, 0 to stop
+	kernel_stamps (int)			- 1 to also record the kernel receive time of sample packets (SO_TIMESTAMPNS)
+*/
+void nodes_set_trace(int* node_sock, int numNodes, int enable, int kernel_stamps);
+
+/*
+Description: write the trace records collected since tracing was turned on, one JSON object per line
+
+Arguments: 
+	fp (FILE*)					- output stream
+*/
+void nodes_dump_trace(FILE* fp);
+
+/*
+Description: print the mean time spent in each phase of the reads/writes collected since tracing 
+was turned on
+
+Arguments: 
+	fp (FILE*)					- output stream
+*/
+void nodes_trace_summary(FILE* fp);
+
 /*
  Description: send a broadcast trigger to all WARP nodes in the setup
 */
@@ -41,6 +178,59 @@ void sendTrigger();
 */
 void readIQ(double complex* samples, int start_sample, int num_samples, int node_sock, int node_id, int buffer_id, int host_id);
 
+/*
+ Description: same as readIQ, but stores the samples in the given format so compact formats
+ are decoded straight from the packets without going through double 
+ 
+ Arguments: 
+	samples (void*) 				- pointer to sample array 
+	format (int)					- format of the sample array:
+									  WL_SAMPLE_DOUBLE (double complex), WL_SAMPLE_FLOAT (float complex) or
+									  WL_SAMPLE_INT16 (interleaved int16 I/Q pairs, Q15; 2 int16 per sample)
+	(remaining arguments as in readIQ)
+*/
+void readIQ_fmt(void* samples, int format, int start_sample, int num_samples, int node_sock, int node_id, int buffer_id, int host_id);
+
+/*
+ Description: read IQ samples from several WARP nodes over a single socket from the calling thread;
+ sample packets are routed to the node arrays by their source address
+ 
+ Arguments: 
+	samples (double complex**) 		- array of sample arrays, one per node 
+	start_sample (int)				- offset to the first sample to read
+	num_samples (int)				- number of samples to read from each node (between 1 and 2^15)
+	node_sock (int)					- identifier of the socket shared by all nodes  
+	node_ids (int*)					- identifiers of the nodes  
+	numNodes (int)					- number of nodes
+	buffer_id (int)					- identifier of the buffer
+	host_id (int)					- identifier of the host 
+*/
+void readIQ_multi(double complex** samples, int start_sample, int num_samples, int node_sock, int* node_ids, int numNodes, int buffer_id, int host_id);
+
+/*
+ Description: same as readIQ_multi, but stores the samples in the given format (see readIQ_fmt)
+ 
+ Arguments: 
+	samples (void**) 				- array of sample arrays, one per node; for a mask of several buffers
+									  one per node and buffer: samples[node*(number of buffers) + buffer]
+	format (int)					- format of the sample arrays (WL_SAMPLE_*)
+	(remaining arguments as in readIQ_multi)
+*/
+void readIQ_multi_fmt(void** samples, int format, int start_sample, int num_samples, int node_sock, int* node_ids, int numNodes, int buffer_id, int host_id);
+
+/*
+ Description: read IQ samples from several RF buffers of a given WARP node with one request;
+ sample packets are routed to the buffer arrays by their buffer ID
+ 
+ Arguments: 
+	samples (void**) 				- array of sample arrays, one per buffer of the mask in increasing 
+									  bit order (eg {RFA, RFC} for 0x5)
+	format (int)					- format of the sample arrays (WL_SAMPLE_*)
+	buffer_mask (int)				- buffers to read: 1 for RFA, 2 for RFB, 4 for RFC, 8 for RFD (eg 0xF for all)
+	(remaining arguments as in readIQ)
+*/
+void readIQ_buffers(void** samples, int format, int start_sample, int num_samples, int node_sock, int node_id, int buffer_mask, int host_id);
+
 /*
  Description: write IQ samples to a given WARP node from a given array 
  
@@ -58,4 +248,50 @@ void readIQ(double complex* samples, int start_sample, int num_samples, int node
 */
 void writeIQ(double complex* samples, int start_sample, int num_samples, int node_sock, int node_id, int buffer_id, int host_id);
 
+/*
+ Description: same as writeIQ, but takes the samples in the given format so compact formats
+ are encoded straight in to the packets without going through double 
+ 
+ Arguments: 
+	samples (const void*) 			- pointer to sample array 
+	format (int)					- format of the sample array (WL_SAMPLE_DOUBLE, WL_SAMPLE_FLOAT or WL_SAMPLE_INT16)
+	(remaining arguments as in writeIQ)
+*/
+void writeIQ_fmt(const void* samples, int format, int start_sample, int num_samples, int node_sock, int node_id, int buffer_id, int host_id);
+
+/*
+ Description: encode samples once for writeIQ_waveform, which can then write them to any node 
+ any number of times without quantizing or encoding them again
+ 
+ Arguments: 
+	samples (const void*) 			- pointer to sample array 
+	format (int)					- format of the sample array (WL_SAMPLE_DOUBLE, WL_SAMPLE_FLOAT or WL_SAMPLE_INT16)
+	start_sample (int)				- offset to the first sample to write
+	num_samples (int)				- number of samples to write (between 1 and 2^15)
+
+ Returns: waveform handle (free with writeIQ_free)
+*/
+struct wl_waveform* writeIQ_prepare(const void* samples, int format, int start_sample, int num_samples);
+
+/*
+ Description: write a waveform prepared with writeIQ_prepare to a given WARP node; only the 
+ transport and command headers of the packets are filled in
+ 
+ Arguments: 
+	waveform (const wl_waveform*)	- waveform handle (may be written to several nodes from different threads)
+	node_sock (int)					- identifier of the node socket  
+	node_id (int)					- identifier of the node  
+	buffer_id (int)					- identifier of the buffer
+	host_id (int)					- identifier of the host 
+*/
+void writeIQ_waveform(const struct wl_waveform* waveform, int node_sock, int node_id, int buffer_id, int host_id);
+
+/*
+ Description: free a waveform prepared with writeIQ_prepare
+ 
+ Arguments: 
+	waveform (wl_waveform*) 		- waveform handle
+*/
+void writeIQ_free(struct wl_waveform* waveform);
+
 
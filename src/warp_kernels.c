@@ -0,0 +1,915 @@
+// include the header 
+#include "warp_kernels.h"
+#include <string.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define WL_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+
+/*********************** Global Variable Definitions *************************/
+
+// Kernels of one instruction set tier
+typedef struct 
+{
+    void (*decode_iq)( double complex *out, const uint8_t *payload, int num_samples );
+    void (*decode_iq_float)( float complex *out, const uint8_t *payload, int num_samples );
+    void (*decode_iq_int16)( int16_t *out, const uint8_t *payload, int num_samples );
+    void (*encode_iq)( uint8_t *payload, const double complex *in, int num_samples );
+    void (*encode_iq_float)( uint8_t *payload, const float complex *in, int num_samples );
+    void (*encode_iq_int16)( uint8_t *payload, const int16_t *in, int num_samples );
+} wl_kernel_table;
+
+static const wl_kernel_table  kernels_scalar = { 
+    wl_decode_iq_scalar, wl_decode_iq_float_scalar, wl_decode_iq_int16_scalar, 
+    wl_encode_iq_scalar, wl_encode_iq_float_scalar, wl_encode_iq_int16_scalar 
+};
+
+static int                    kernel_isa = -1;                 // Instruction set in use (-1 until first use)
+static const wl_kernel_table *kernels    = &kernels_scalar;    // Kernels of the instruction set in use
+
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_decode_iq_scalar
+*
+*  Reference decode of WARPLab sample words in to complex doubles.  Each word
+*  carries I in bits [29:16] and Q in bits [13:0] as 14 bit two's complement
+*  values; the result is bit-exact with the conversion in readSamples():
+*      1) Assemble the big-endian word
+*      2) Sign extend the 14 bit value to a true twos compliment value
+*      3) Scale by WL_FIX_14_13_SCALE so the resulting value is between +/- 1
+*
+******************************************************************************/
+void wl_decode_iq_scalar( double complex *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    uint32_t  word;
+    double   *dst = (double *) out;
+
+    for ( i = 0; i < num_samples; i++ ) {
+
+        word = ( (uint32_t) payload[4 * i    ] << 24 ) | 
+               ( (uint32_t) payload[4 * i + 1] << 16 ) | 
+               ( (uint32_t) payload[4 * i + 2] <<  8 ) | 
+               ( (uint32_t) payload[4 * i + 3]       );
+
+        dst[2 * i    ] = (double) ( (int32_t) ( word <<  2 ) >> 18 ) * WL_FIX_14_13_SCALE;
+        dst[2 * i + 1] = (double) ( (int32_t) ( word << 18 ) >> 18 ) * WL_FIX_14_13_SCALE;
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_decode_iq_float_scalar / wl_decode_iq_int16_scalar
+*
+*  Reference decode of WARPLab sample words in to complex floats (the 14 bit 
+*  values are scaled in single precision) and in to Q15 int16 I / Q pairs
+*
+******************************************************************************/
+void wl_decode_iq_float_scalar( float complex *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    uint32_t  word;
+    float    *dst = (float *) out;
+
+    for ( i = 0; i < num_samples; i++ ) {
+
+        word = ( (uint32_t) payload[4 * i    ] << 24 ) | 
+               ( (uint32_t) payload[4 * i + 1] << 16 ) | 
+               ( (uint32_t) payload[4 * i + 2] <<  8 ) | 
+               ( (uint32_t) payload[4 * i + 3]       );
+
+        dst[2 * i    ] = (float) ( (int32_t) ( word <<  2 ) >> 18 ) * (float) WL_FIX_14_13_SCALE;
+        dst[2 * i + 1] = (float) ( (int32_t) ( word << 18 ) >> 18 ) * (float) WL_FIX_14_13_SCALE;
+    }
+}
+
+void wl_decode_iq_int16_scalar( int16_t *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+
+    for ( i = 0; i < num_samples; i++ ) {
+        out[2 * i    ] = (int16_t) ( ( ( payload[4 * i    ] << 8 ) | payload[4 * i + 1] ) << 2 );
+        out[2 * i + 1] = (int16_t) ( ( ( payload[4 * i + 2] << 8 ) | payload[4 * i + 3] ) << 2 );
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_quantize / wl_quantize_float / wl_put_sample
+*
+*  Reference quantization of one sample component to UFix_16_15 and packing of 
+*  a sample in to a big-endian word of the payload.  The saturation is done 
+*  before the conversion in the same order as the vector kernels (max, then 
+*  min) so that out of range values and NaN encode identically.
+*
+******************************************************************************/
+static inline int16_t wl_quantize( double value ) {
+
+    value *= WL_FIX_16_15_SCALE;
+    value  = ( value > WL_FIX_16_15_MIN ) ? value : WL_FIX_16_15_MIN;
+    value  = ( value < WL_FIX_16_15_MAX ) ? value : WL_FIX_16_15_MAX;
+
+    return (int16_t) value;
+}
+
+static inline int16_t wl_quantize_float( float value ) {
+
+    value *= (float) WL_FIX_16_15_SCALE;
+    value  = ( value > (float) WL_FIX_16_15_MIN ) ? value : (float) WL_FIX_16_15_MIN;
+    value  = ( value < (float) WL_FIX_16_15_MAX ) ? value : (float) WL_FIX_16_15_MAX;
+
+    return (int16_t) value;
+}
+
+static inline void wl_put_sample( uint8_t *payload, int16_t i_val, int16_t q_val ) {
+
+    payload[0] = (uint8_t) ( (uint16_t) i_val >> 8 );
+    payload[1] = (uint8_t) ( (uint16_t) i_val      );
+    payload[2] = (uint8_t) ( (uint16_t) q_val >> 8 );
+    payload[3] = (uint8_t) ( (uint16_t) q_val      );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_encode_iq_scalar / wl_encode_iq_float_scalar
+*
+*  Reference encode of complex samples in to WARPLab sample words.  
+*
+*  NOTE:  The original conversion in writeIQ() ( (uint16) pow(2,15)*x ) relied
+*      on an out of range double to uint16 conversion for negative values and 
+*      wrapped +1.0 to -1.0.  These kernels truncate and saturate instead.
+*
+******************************************************************************/
+void wl_encode_iq_scalar( uint8_t *payload, const double complex *in, int num_samples ) {
+
+    int           i;
+    const double *src = (const double *) in;
+
+    for ( i = 0; i < num_samples; i++ ) {
+        wl_put_sample( payload + 4 * i, wl_quantize( src[2 * i] ), wl_quantize( src[2 * i + 1] ) );
+    }
+}
+
+void wl_encode_iq_float_scalar( uint8_t *payload, const float complex *in, int num_samples ) {
+
+    int           i;
+    const float  *src = (const float *) in;
+
+    for ( i = 0; i < num_samples; i++ ) {
+        wl_put_sample( payload + 4 * i, wl_quantize_float( src[2 * i] ), wl_quantize_float( src[2 * i + 1] ) );
+    }
+}
+
+void wl_encode_iq_int16_scalar( uint8_t *payload, const int16_t *in, int num_samples ) {
+
+    int           i;
+
+    for ( i = 0; i < num_samples; i++ ) {
+        wl_put_sample( payload + 4 * i, in[2 * i], in[2 * i + 1] );
+    }
+}
+
+
+#ifdef WL_KERNELS_X86
+
+/*****************************************************************************/
+/**
+*  Function:  wl_decode_iq_sse4
+*
+*  SSE4.1 decode; 4 samples per iteration
+*
+******************************************************************************/
+__attribute__((target("sse4.1")))
+static void wl_decode_iq_sse4( double complex *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    double   *dst   = (double *) out;
+
+    const __m128i bswap = _mm_set_epi8( 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3 );
+    const __m128d scale = _mm_set1_pd( WL_FIX_14_13_SCALE );
+
+    __m128i   word, iv, qv, lo, hi;
+
+    for ( i = 0; i + 4 <= num_samples; i += 4 ) {
+
+        word = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) ( payload + 4 * i ) ), bswap );
+
+        // Sign extend I (bits [29:16]) and Q (bits [13:0])
+        iv   = _mm_srai_epi32( _mm_slli_epi32( word,  2 ), 18 );
+        qv   = _mm_srai_epi32( _mm_slli_epi32( word, 18 ), 18 );
+
+        // Interleave in to I0 Q0 I1 Q1 / I2 Q2 I3 Q3
+        lo   = _mm_unpacklo_epi32( iv, qv );
+        hi   = _mm_unpackhi_epi32( iv, qv );
+
+        _mm_storeu_pd( dst + 2 * i    , _mm_mul_pd( _mm_cvtepi32_pd( lo ), scale ) );
+        _mm_storeu_pd( dst + 2 * i + 2, _mm_mul_pd( _mm_cvtepi32_pd( _mm_srli_si128( lo, 8 ) ), scale ) );
+        _mm_storeu_pd( dst + 2 * i + 4, _mm_mul_pd( _mm_cvtepi32_pd( hi ), scale ) );
+        _mm_storeu_pd( dst + 2 * i + 6, _mm_mul_pd( _mm_cvtepi32_pd( _mm_srli_si128( hi, 8 ) ), scale ) );
+    }
+
+    wl_decode_iq_scalar( out + i, payload + 4 * i, num_samples - i );
+}
+
+__attribute__((target("sse4.1")))
+static void wl_decode_iq_float_sse4( float complex *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    float    *dst   = (float *) out;
+
+    const __m128i bswap = _mm_set_epi8( 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3 );
+    const __m128  scale = _mm_set1_ps( (float) WL_FIX_14_13_SCALE );
+
+    __m128i   word, iv, qv;
+
+    for ( i = 0; i + 4 <= num_samples; i += 4 ) {
+
+        word = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) ( payload + 4 * i ) ), bswap );
+
+        iv   = _mm_srai_epi32( _mm_slli_epi32( word,  2 ), 18 );
+        qv   = _mm_srai_epi32( _mm_slli_epi32( word, 18 ), 18 );
+
+        _mm_storeu_ps( dst + 2 * i    , _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi32( iv, qv ) ), scale ) );
+        _mm_storeu_ps( dst + 2 * i + 4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi32( iv, qv ) ), scale ) );
+    }
+
+    wl_decode_iq_float_scalar( out + i, payload + 4 * i, num_samples - i );
+}
+
+__attribute__((target("sse4.1")))
+static void wl_decode_iq_int16_sse4( int16_t *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+
+    const __m128i bswap = _mm_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 );
+
+    for ( i = 0; i + 4 <= num_samples; i += 4 ) {
+        _mm_storeu_si128( (__m128i *) ( out + 2 * i ), 
+                          _mm_slli_epi16( _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) ( payload + 4 * i ) ), bswap ), 2 ) );
+    }
+
+    wl_decode_iq_int16_scalar( out + 2 * i, payload + 4 * i, num_samples - i );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_decode_iq_avx2
+*
+*  AVX2 decode; 8 samples per iteration
+*
+******************************************************************************/
+__attribute__((target("avx2")))
+static void wl_decode_iq_avx2( double complex *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    double   *dst   = (double *) out;
+
+    const __m256i bswap = _mm256_set_epi8( 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                           12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3 );
+    const __m256d scale = _mm256_set1_pd( WL_FIX_14_13_SCALE );
+
+    __m256i   word, iv, qv, lo, hi;
+
+    for ( i = 0; i + 8 <= num_samples; i += 8 ) {
+
+        word = _mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i *) ( payload + 4 * i ) ), bswap );
+
+        // Sign extend I (bits [29:16]) and Q (bits [13:0])
+        iv   = _mm256_srai_epi32( _mm256_slli_epi32( word,  2 ), 18 );
+        qv   = _mm256_srai_epi32( _mm256_slli_epi32( word, 18 ), 18 );
+
+        // Interleave within each 128 bit lane:  lo = { I0 Q0 I1 Q1 | I4 Q4 I5 Q5 }, hi = { I2 Q2 I3 Q3 | I6 Q6 I7 Q7 }
+        lo   = _mm256_unpacklo_epi32( iv, qv );
+        hi   = _mm256_unpackhi_epi32( iv, qv );
+
+        _mm256_storeu_pd( dst + 2 * i     , _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_castsi256_si128( lo ) ), scale ) );
+        _mm256_storeu_pd( dst + 2 * i +  4, _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_castsi256_si128( hi ) ), scale ) );
+        _mm256_storeu_pd( dst + 2 * i +  8, _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_extracti128_si256( lo, 1 ) ), scale ) );
+        _mm256_storeu_pd( dst + 2 * i + 12, _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_extracti128_si256( hi, 1 ) ), scale ) );
+    }
+
+    wl_decode_iq_scalar( out + i, payload + 4 * i, num_samples - i );
+}
+
+__attribute__((target("avx2")))
+static void wl_decode_iq_float_avx2( float complex *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    float    *dst   = (float *) out;
+
+    const __m256i bswap = _mm256_set_epi8( 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                           12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3 );
+    const __m256  scale = _mm256_set1_ps( (float) WL_FIX_14_13_SCALE );
+
+    __m256i   word, iv, qv, lo, hi;
+
+    for ( i = 0; i + 8 <= num_samples; i += 8 ) {
+
+        word = _mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i *) ( payload + 4 * i ) ), bswap );
+
+        iv   = _mm256_srai_epi32( _mm256_slli_epi32( word,  2 ), 18 );
+        qv   = _mm256_srai_epi32( _mm256_slli_epi32( word, 18 ), 18 );
+
+        // Interleave within each 128 bit lane and restore the sample order across lanes
+        lo   = _mm256_unpacklo_epi32( iv, qv );
+        hi   = _mm256_unpackhi_epi32( iv, qv );
+
+        _mm256_storeu_ps( dst + 2 * i    , _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_permute2x128_si256( lo, hi, 0x20 ) ), scale ) );
+        _mm256_storeu_ps( dst + 2 * i + 8, _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_permute2x128_si256( lo, hi, 0x31 ) ), scale ) );
+    }
+
+    wl_decode_iq_float_scalar( out + i, payload + 4 * i, num_samples - i );
+}
+
+__attribute__((target("avx2")))
+static void wl_decode_iq_int16_avx2( int16_t *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+
+    const __m256i bswap = _mm256_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+                                           14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 );
+
+    for ( i = 0; i + 8 <= num_samples; i += 8 ) {
+        _mm256_storeu_si256( (__m256i *) ( out + 2 * i ), 
+                             _mm256_slli_epi16( _mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i *) ( payload + 4 * i ) ), bswap ), 2 ) );
+    }
+
+    wl_decode_iq_int16_scalar( out + 2 * i, payload + 4 * i, num_samples - i );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_decode_iq_avx512
+*
+*  AVX-512 (F + BW) decode; 16 samples per iteration
+*
+******************************************************************************/
+__attribute__((target("avx512f,avx512bw")))
+static void wl_decode_iq_avx512( double complex *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    double   *dst   = (double *) out;
+
+    const __m512i bswap = _mm512_broadcast_i32x4( _mm_set_epi8( 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3 ) );
+    const __m512i idx_lo = _mm512_set_epi32( 23,  7, 22,  6, 21,  5, 20,  4, 19,  3, 18,  2, 17,  1, 16,  0 );
+    const __m512i idx_hi = _mm512_set_epi32( 31, 15, 30, 14, 29, 13, 28, 12, 27, 11, 26, 10, 25,  9, 24,  8 );
+    const __m512d scale = _mm512_set1_pd( WL_FIX_14_13_SCALE );
+
+    __m512i   word, iv, qv, lo, hi;
+
+    for ( i = 0; i + 16 <= num_samples; i += 16 ) {
+
+        word = _mm512_shuffle_epi8( _mm512_loadu_si512( (const void *) ( payload + 4 * i ) ), bswap );
+
+        // Sign extend I (bits [29:16]) and Q (bits [13:0])
+        iv   = _mm512_srai_epi32( _mm512_slli_epi32( word,  2 ), 18 );
+        qv   = _mm512_srai_epi32( _mm512_slli_epi32( word, 18 ), 18 );
+
+        // Interleave in to I0 Q0 ... I7 Q7 / I8 Q8 ... I15 Q15
+        lo   = _mm512_permutex2var_epi32( iv, idx_lo, qv );
+        hi   = _mm512_permutex2var_epi32( iv, idx_hi, qv );
+
+        _mm512_storeu_pd( dst + 2 * i     , _mm512_mul_pd( _mm512_cvtepi32_pd( _mm512_castsi512_si256( lo ) ), scale ) );
+        _mm512_storeu_pd( dst + 2 * i +  8, _mm512_mul_pd( _mm512_cvtepi32_pd( _mm512_extracti64x4_epi64( lo, 1 ) ), scale ) );
+        _mm512_storeu_pd( dst + 2 * i + 16, _mm512_mul_pd( _mm512_cvtepi32_pd( _mm512_castsi512_si256( hi ) ), scale ) );
+        _mm512_storeu_pd( dst + 2 * i + 24, _mm512_mul_pd( _mm512_cvtepi32_pd( _mm512_extracti64x4_epi64( hi, 1 ) ), scale ) );
+    }
+
+    wl_decode_iq_scalar( out + i, payload + 4 * i, num_samples - i );
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void wl_decode_iq_float_avx512( float complex *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    float    *dst   = (float *) out;
+
+    const __m512i bswap = _mm512_broadcast_i32x4( _mm_set_epi8( 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3 ) );
+    const __m512i idx_lo = _mm512_set_epi32( 23,  7, 22,  6, 21,  5, 20,  4, 19,  3, 18,  2, 17,  1, 16,  0 );
+    const __m512i idx_hi = _mm512_set_epi32( 31, 15, 30, 14, 29, 13, 28, 12, 27, 11, 26, 10, 25,  9, 24,  8 );
+    const __m512  scale = _mm512_set1_ps( (float) WL_FIX_14_13_SCALE );
+
+    __m512i   word, iv, qv;
+
+    for ( i = 0; i + 16 <= num_samples; i += 16 ) {
+
+        word = _mm512_shuffle_epi8( _mm512_loadu_si512( (const void *) ( payload + 4 * i ) ), bswap );
+
+        iv   = _mm512_srai_epi32( _mm512_slli_epi32( word,  2 ), 18 );
+        qv   = _mm512_srai_epi32( _mm512_slli_epi32( word, 18 ), 18 );
+
+        _mm512_storeu_ps( dst + 2 * i     , _mm512_mul_ps( _mm512_cvtepi32_ps( _mm512_permutex2var_epi32( iv, idx_lo, qv ) ), scale ) );
+        _mm512_storeu_ps( dst + 2 * i + 16, _mm512_mul_ps( _mm512_cvtepi32_ps( _mm512_permutex2var_epi32( iv, idx_hi, qv ) ), scale ) );
+    }
+
+    wl_decode_iq_float_scalar( out + i, payload + 4 * i, num_samples - i );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_encode_iq_sse4 / wl_encode_iq_float_sse4
+*
+*  SSE4.1 encode; 4 samples per iteration
+*
+******************************************************************************/
+__attribute__((target("sse4.1")))
+static void wl_encode_iq_sse4( uint8_t *payload, const double complex *in, int num_samples ) {
+
+    int           i;
+    const double *src   = (const double *) in;
+
+    const __m128i bswap = _mm_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 );
+    const __m128d scale = _mm_set1_pd( WL_FIX_16_15_SCALE );
+    const __m128d lo    = _mm_set1_pd( WL_FIX_16_15_MIN );
+    const __m128d hi    = _mm_set1_pd( WL_FIX_16_15_MAX );
+
+    __m128i       c0, c1, c2, c3, word;
+
+    for ( i = 0; i + 4 <= num_samples; i += 4 ) {
+
+        // Scale, saturate and truncate I0 Q0 / I1 Q1 / I2 Q2 / I3 Q3
+        c0   = _mm_cvttpd_epi32( _mm_min_pd( _mm_max_pd( _mm_mul_pd( _mm_loadu_pd( src + 2 * i     ), scale ), lo ), hi ) );
+        c1   = _mm_cvttpd_epi32( _mm_min_pd( _mm_max_pd( _mm_mul_pd( _mm_loadu_pd( src + 2 * i + 2 ), scale ), lo ), hi ) );
+        c2   = _mm_cvttpd_epi32( _mm_min_pd( _mm_max_pd( _mm_mul_pd( _mm_loadu_pd( src + 2 * i + 4 ), scale ), lo ), hi ) );
+        c3   = _mm_cvttpd_epi32( _mm_min_pd( _mm_max_pd( _mm_mul_pd( _mm_loadu_pd( src + 2 * i + 6 ), scale ), lo ), hi ) );
+
+        // Pack to I0 Q0 ... I3 Q3 (int16) and swap to big-endian
+        word = _mm_packs_epi32( _mm_unpacklo_epi64( c0, c1 ), _mm_unpacklo_epi64( c2, c3 ) );
+
+        _mm_storeu_si128( (__m128i *) ( payload + 4 * i ), _mm_shuffle_epi8( word, bswap ) );
+    }
+
+    wl_encode_iq_scalar( payload + 4 * i, in + i, num_samples - i );
+}
+
+__attribute__((target("sse4.1")))
+static void wl_encode_iq_float_sse4( uint8_t *payload, const float complex *in, int num_samples ) {
+
+    int           i;
+    const float  *src   = (const float *) in;
+
+    const __m128i bswap = _mm_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 );
+    const __m128  scale = _mm_set1_ps( (float) WL_FIX_16_15_SCALE );
+    const __m128  lo    = _mm_set1_ps( (float) WL_FIX_16_15_MIN );
+    const __m128  hi    = _mm_set1_ps( (float) WL_FIX_16_15_MAX );
+
+    __m128i       c0, c1, word;
+
+    for ( i = 0; i + 4 <= num_samples; i += 4 ) {
+
+        // Scale, saturate and truncate I0 Q0 I1 Q1 / I2 Q2 I3 Q3
+        c0   = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( src + 2 * i     ), scale ), lo ), hi ) );
+        c1   = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( src + 2 * i + 4 ), scale ), lo ), hi ) );
+
+        word = _mm_packs_epi32( c0, c1 );
+
+        _mm_storeu_si128( (__m128i *) ( payload + 4 * i ), _mm_shuffle_epi8( word, bswap ) );
+    }
+
+    wl_encode_iq_float_scalar( payload + 4 * i, in + i, num_samples - i );
+}
+
+__attribute__((target("sse4.1")))
+static void wl_encode_iq_int16_sse4( uint8_t *payload, const int16_t *in, int num_samples ) {
+
+    int           i;
+
+    const __m128i bswap = _mm_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 );
+
+    for ( i = 0; i + 4 <= num_samples; i += 4 ) {
+        _mm_storeu_si128( (__m128i *) ( payload + 4 * i ), 
+                          _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) ( in + 2 * i ) ), bswap ) );
+    }
+
+    wl_encode_iq_int16_scalar( payload + 4 * i, in + 2 * i, num_samples - i );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_encode_iq_avx2 / wl_encode_iq_float_avx2
+*
+*  AVX2 encode; 8 samples per iteration
+*
+******************************************************************************/
+__attribute__((target("avx2")))
+static void wl_encode_iq_avx2( uint8_t *payload, const double complex *in, int num_samples ) {
+
+    int           i;
+    const double *src   = (const double *) in;
+
+    const __m256i bswap = _mm256_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+                                           14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 );
+    const __m256d scale = _mm256_set1_pd( WL_FIX_16_15_SCALE );
+    const __m256d lo    = _mm256_set1_pd( WL_FIX_16_15_MIN );
+    const __m256d hi    = _mm256_set1_pd( WL_FIX_16_15_MAX );
+
+    __m128i       c0, c1, c2, c3;
+    __m256i       word;
+
+    for ( i = 0; i + 8 <= num_samples; i += 8 ) {
+
+        // Scale, saturate and truncate 2 samples per conversion
+        c0   = _mm256_cvttpd_epi32( _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( _mm256_loadu_pd( src + 2 * i      ), scale ), lo ), hi ) );
+        c1   = _mm256_cvttpd_epi32( _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( _mm256_loadu_pd( src + 2 * i +  4 ), scale ), lo ), hi ) );
+        c2   = _mm256_cvttpd_epi32( _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( _mm256_loadu_pd( src + 2 * i +  8 ), scale ), lo ), hi ) );
+        c3   = _mm256_cvttpd_epi32( _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( _mm256_loadu_pd( src + 2 * i + 12 ), scale ), lo ), hi ) );
+
+        // Pack to I0 Q0 ... I7 Q7 (int16) and swap to big-endian
+        word = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_packs_epi32( c0, c1 ) ), _mm_packs_epi32( c2, c3 ), 1 );
+
+        _mm256_storeu_si256( (__m256i *) ( payload + 4 * i ), _mm256_shuffle_epi8( word, bswap ) );
+    }
+
+    wl_encode_iq_scalar( payload + 4 * i, in + i, num_samples - i );
+}
+
+__attribute__((target("avx2")))
+static void wl_encode_iq_float_avx2( uint8_t *payload, const float complex *in, int num_samples ) {
+
+    int           i;
+    const float  *src   = (const float *) in;
+
+    const __m256i bswap = _mm256_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+                                           14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 );
+    const __m256  scale = _mm256_set1_ps( (float) WL_FIX_16_15_SCALE );
+    const __m256  lo    = _mm256_set1_ps( (float) WL_FIX_16_15_MIN );
+    const __m256  hi    = _mm256_set1_ps( (float) WL_FIX_16_15_MAX );
+
+    __m256i       c0, c1, word;
+
+    for ( i = 0; i + 8 <= num_samples; i += 8 ) {
+
+        // Scale, saturate and truncate:  c0 = { I0 Q0 I1 Q1 | I2 Q2 I3 Q3 }, c1 = { I4 Q4 I5 Q5 | I6 Q6 I7 Q7 }
+        c0   = _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( _mm256_mul_ps( _mm256_loadu_ps( src + 2 * i     ), scale ), lo ), hi ) );
+        c1   = _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( _mm256_mul_ps( _mm256_loadu_ps( src + 2 * i + 8 ), scale ), lo ), hi ) );
+
+        // Pack within each 128 bit lane ( { 0 1 4 5 | 2 3 6 7 } ) and restore the sample order
+        word = _mm256_permute4x64_epi64( _mm256_packs_epi32( c0, c1 ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+
+        _mm256_storeu_si256( (__m256i *) ( payload + 4 * i ), _mm256_shuffle_epi8( word, bswap ) );
+    }
+
+    wl_encode_iq_float_scalar( payload + 4 * i, in + i, num_samples - i );
+}
+
+__attribute__((target("avx2")))
+static void wl_encode_iq_int16_avx2( uint8_t *payload, const int16_t *in, int num_samples ) {
+
+    int           i;
+
+    const __m256i bswap = _mm256_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+                                           14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 );
+
+    for ( i = 0; i + 8 <= num_samples; i += 8 ) {
+        _mm256_storeu_si256( (__m256i *) ( payload + 4 * i ), 
+                             _mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i *) ( in + 2 * i ) ), bswap ) );
+    }
+
+    wl_encode_iq_int16_scalar( payload + 4 * i, in + 2 * i, num_samples - i );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_encode_iq_avx512 / wl_encode_iq_float_avx512
+*
+*  AVX-512 (F + BW) encode; 16 samples per iteration
+*
+******************************************************************************/
+__attribute__((target("avx512f,avx512bw")))
+static void wl_encode_iq_avx512( uint8_t *payload, const double complex *in, int num_samples ) {
+
+    int           i;
+    const double *src   = (const double *) in;
+
+    const __m512i bswap = _mm512_broadcast_i32x4( _mm_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 ) );
+    const __m512d scale = _mm512_set1_pd( WL_FIX_16_15_SCALE );
+    const __m512d lo    = _mm512_set1_pd( WL_FIX_16_15_MIN );
+    const __m512d hi    = _mm512_set1_pd( WL_FIX_16_15_MAX );
+
+    __m256i       c0, c1, c2, c3, w0, w1;
+
+    for ( i = 0; i + 16 <= num_samples; i += 16 ) {
+
+        // Scale, saturate and truncate 4 samples per conversion
+        c0   = _mm512_cvttpd_epi32( _mm512_min_pd( _mm512_max_pd( _mm512_mul_pd( _mm512_loadu_pd( src + 2 * i      ), scale ), lo ), hi ) );
+        c1   = _mm512_cvttpd_epi32( _mm512_min_pd( _mm512_max_pd( _mm512_mul_pd( _mm512_loadu_pd( src + 2 * i +  8 ), scale ), lo ), hi ) );
+        c2   = _mm512_cvttpd_epi32( _mm512_min_pd( _mm512_max_pd( _mm512_mul_pd( _mm512_loadu_pd( src + 2 * i + 16 ), scale ), lo ), hi ) );
+        c3   = _mm512_cvttpd_epi32( _mm512_min_pd( _mm512_max_pd( _mm512_mul_pd( _mm512_loadu_pd( src + 2 * i + 24 ), scale ), lo ), hi ) );
+
+        // Narrow to I0 Q0 ... I15 Q15 (int16) and swap to big-endian
+        w0   = _mm512_cvtsepi32_epi16( _mm512_inserti64x4( _mm512_castsi256_si512( c0 ), c1, 1 ) );
+        w1   = _mm512_cvtsepi32_epi16( _mm512_inserti64x4( _mm512_castsi256_si512( c2 ), c3, 1 ) );
+
+        _mm512_storeu_si512( (void *) ( payload + 4 * i ), 
+                             _mm512_shuffle_epi8( _mm512_inserti64x4( _mm512_castsi256_si512( w0 ), w1, 1 ), bswap ) );
+    }
+
+    wl_encode_iq_scalar( payload + 4 * i, in + i, num_samples - i );
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void wl_encode_iq_float_avx512( uint8_t *payload, const float complex *in, int num_samples ) {
+
+    int           i;
+    const float  *src   = (const float *) in;
+
+    const __m512i bswap = _mm512_broadcast_i32x4( _mm_set_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 ) );
+    const __m512  scale = _mm512_set1_ps( (float) WL_FIX_16_15_SCALE );
+    const __m512  lo    = _mm512_set1_ps( (float) WL_FIX_16_15_MIN );
+    const __m512  hi    = _mm512_set1_ps( (float) WL_FIX_16_15_MAX );
+
+    __m256i       w0, w1;
+
+    for ( i = 0; i + 16 <= num_samples; i += 16 ) {
+
+        // Scale, saturate, truncate and narrow 8 samples per conversion
+        w0   = _mm512_cvtsepi32_epi16( _mm512_cvttps_epi32( _mm512_min_ps( _mm512_max_ps( _mm512_mul_ps( _mm512_loadu_ps( src + 2 * i      ), scale ), lo ), hi ) ) );
+        w1   = _mm512_cvtsepi32_epi16( _mm512_cvttps_epi32( _mm512_min_ps( _mm512_max_ps( _mm512_mul_ps( _mm512_loadu_ps( src + 2 * i + 16 ), scale ), lo ), hi ) ) );
+
+        _mm512_storeu_si512( (void *) ( payload + 4 * i ), 
+                             _mm512_shuffle_epi8( _mm512_inserti64x4( _mm512_castsi256_si512( w0 ), w1, 1 ), bswap ) );
+    }
+
+    wl_encode_iq_float_scalar( payload + 4 * i, in + i, num_samples - i );
+}
+
+
+// Kernel tables of the vector instruction sets
+//     NOTE:  The int16 kernels are pure byte shuffles and memory bound, so AVX-512 uses the AVX2 ones
+static const wl_kernel_table  kernels_sse4 = { 
+    wl_decode_iq_sse4, wl_decode_iq_float_sse4, wl_decode_iq_int16_sse4, 
+    wl_encode_iq_sse4, wl_encode_iq_float_sse4, wl_encode_iq_int16_sse4 
+};
+
+static const wl_kernel_table  kernels_avx2 = { 
+    wl_decode_iq_avx2, wl_decode_iq_float_avx2, wl_decode_iq_int16_avx2, 
+    wl_encode_iq_avx2, wl_encode_iq_float_avx2, wl_encode_iq_int16_avx2 
+};
+
+static const wl_kernel_table  kernels_avx512 = { 
+    wl_decode_iq_avx512, wl_decode_iq_float_avx512, wl_decode_iq_int16_avx2, 
+    wl_encode_iq_avx512, wl_encode_iq_float_avx512, wl_encode_iq_int16_avx2 
+};
+
+#endif
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_kernel_select
+*
+*  Selects the instruction set of the sample kernels.  Requests for an 
+*  instruction set the CPU does not support fall back to the best one it does.
+*
+*  Returns:  Instruction set in use (WL_ISA_*)
+*
+******************************************************************************/
+int wl_kernel_select( int isa ) {
+
+    int best = WL_ISA_SCALAR;
+
+#ifdef WL_KERNELS_X86
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports("sse4.1") )                                          { best = WL_ISA_SSE4;   }
+    if ( __builtin_cpu_supports("avx2") )                                            { best = WL_ISA_AVX2;   }
+    if ( __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") )   { best = WL_ISA_AVX512; }
+#endif
+
+    if ( ( isa < 0 ) || ( isa > best ) ) {
+        isa = best;
+    }
+
+    switch ( isa ) {
+#ifdef WL_KERNELS_X86
+        case WL_ISA_SSE4:    kernels = &kernels_sse4;     break;
+        case WL_ISA_AVX2:    kernels = &kernels_avx2;     break;
+        case WL_ISA_AVX512:  kernels = &kernels_avx512;   break;
+#endif
+        default:
+            isa     = WL_ISA_SCALAR;
+            kernels = &kernels_scalar;
+        break;
+    }
+
+    kernel_isa = isa;
+
+    return isa;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_kernel_isa
+*
+*  Returns the instruction set of the sample kernels (selecting the best one 
+*  on first use)
+*
+******************************************************************************/
+int wl_kernel_isa( void ) {
+
+    if ( kernel_isa < 0 ) {
+        wl_kernel_select( -1 );
+    }
+
+    return kernel_isa;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_kernel_isa_name
+*
+*  Returns a printable name for an instruction set tier
+*
+******************************************************************************/
+const char * wl_kernel_isa_name( int isa ) {
+
+    switch ( isa ) {
+        case WL_ISA_SSE4:    return "sse4";
+        case WL_ISA_AVX2:    return "avx2";
+        case WL_ISA_AVX512:  return "avx512";
+        default:             return "scalar";
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_decode_iq / wl_decode_iq_float / wl_decode_iq_int16
+*
+*  Decodes sample packet payload with the selected instruction set (see 
+*  wl_decode_iq_scalar)
+*
+******************************************************************************/
+void wl_decode_iq( double complex *out, const uint8_t *payload, int num_samples ) {
+
+    if ( kernel_isa < 0 ) {
+        wl_kernel_select( -1 );
+    }
+
+    kernels->decode_iq( out, payload, num_samples );
+}
+
+void wl_decode_iq_float( float complex *out, const uint8_t *payload, int num_samples ) {
+
+    if ( kernel_isa < 0 ) {
+        wl_kernel_select( -1 );
+    }
+
+    kernels->decode_iq_float( out, payload, num_samples );
+}
+
+void wl_decode_iq_int16( int16_t *out, const uint8_t *payload, int num_samples ) {
+
+    if ( kernel_isa < 0 ) {
+        wl_kernel_select( -1 );
+    }
+
+    kernels->decode_iq_int16( out, payload, num_samples );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_decode_raw32
+*
+*  Assembles the big-endian sample words of a sample packet payload
+*
+******************************************************************************/
+void wl_decode_raw32( uint32_t *out, const uint8_t *payload, int num_samples ) {
+
+    int       i;
+    uint32_t  word;
+
+    for ( i = 0; i < num_samples; i++ ) {
+        memcpy( &word, payload + 4 * i, sizeof( word ) );
+        out[i] = __builtin_bswap32( word );
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_decode_samples
+*
+*  Decodes sample packet payload in to an output array of the given format
+*
+******************************************************************************/
+void wl_decode_samples( int format, void *output, uint32_t offset, const uint8_t *payload, int num_samples ) {
+
+    switch ( format ) {
+        case WL_SAMPLE_DOUBLE:
+            wl_decode_iq( (double complex *) output + offset, payload, num_samples );
+        break;
+
+        case WL_SAMPLE_FLOAT:
+            wl_decode_iq_float( (float complex *) output + offset, payload, num_samples );
+        break;
+
+        case WL_SAMPLE_INT16:
+            wl_decode_iq_int16( (int16_t *) output + 2 * offset, payload, num_samples );
+        break;
+
+        default:
+            wl_decode_raw32( (uint32_t *) output + offset, payload, num_samples );
+        break;
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_encode_iq / wl_encode_iq_float / wl_encode_iq_int16
+*
+*  Encodes complex samples in to sample packet payload with the selected 
+*  instruction set (see wl_encode_iq_scalar)
+*
+******************************************************************************/
+void wl_encode_iq( uint8_t *payload, const double complex *in, int num_samples ) {
+
+    if ( kernel_isa < 0 ) {
+        wl_kernel_select( -1 );
+    }
+
+    kernels->encode_iq( payload, in, num_samples );
+}
+
+void wl_encode_iq_float( uint8_t *payload, const float complex *in, int num_samples ) {
+
+    if ( kernel_isa < 0 ) {
+        wl_kernel_select( -1 );
+    }
+
+    kernels->encode_iq_float( payload, in, num_samples );
+}
+
+void wl_encode_iq_int16( uint8_t *payload, const int16_t *in, int num_samples ) {
+
+    if ( kernel_isa < 0 ) {
+        wl_kernel_select( -1 );
+    }
+
+    kernels->encode_iq_int16( payload, in, num_samples );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_encode_raw32
+*
+*  Stores sample words (I in bits [31:16], Q in bits [15:0]) big-endian in 
+*  a sample packet payload
+*
+******************************************************************************/
+void wl_encode_raw32( uint8_t *payload, const uint32_t *in, int num_samples ) {
+
+    int       i;
+    uint32_t  word;
+
+    for ( i = 0; i < num_samples; i++ ) {
+        word = __builtin_bswap32( in[i] );
+        memcpy( payload + 4 * i, &word, sizeof( word ) );
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_encode_samples
+*
+*  Encodes an input array of the given format in to sample packet payload
+*
+******************************************************************************/
+void wl_encode_samples( int format, uint8_t *payload, const void *input, uint32_t offset, int num_samples ) {
+
+    switch ( format ) {
+        case WL_SAMPLE_DOUBLE:
+            wl_encode_iq( payload, (const double complex *) input + offset, num_samples );
+        break;
+
+        case WL_SAMPLE_FLOAT:
+            wl_encode_iq_float( payload, (const float complex *) input + offset, num_samples );
+        break;
+
+        case WL_SAMPLE_INT16:
+            wl_encode_iq_int16( payload, (const int16_t *) input + 2 * offset, num_samples );
+        break;
+
+        default:
+            wl_encode_raw32( payload, (const uint32_t *) input + offset, num_samples );
+        break;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef WARP_KERNELS_H
+#define WARP_KERNELS_H
+
+/***************************** Include Files *********************************/
+#include <complex.h>
+#include <stdint.h>
+
+
+/*************************** Constant Definitions ****************************/
+
+// Instruction set tiers of the sample kernels (in order of preference)
+#define WL_ISA_SCALAR                   0
+#define WL_ISA_SSE4                     1
+#define WL_ISA_AVX2                     2
+#define WL_ISA_AVX512                   3
+
+// Sample formats of Read / Write IQ arrays
+#define WL_SAMPLE_RAW32                 0     // uint32 words as sent to / by the node (host byte order)
+#define WL_SAMPLE_DOUBLE                1     // double complex (16 bytes per sample)
+#define WL_SAMPLE_FLOAT                 2     // float complex (8 bytes per sample)
+#define WL_SAMPLE_INT16                 3     // interleaved int16 I / Q pairs, Q15 fixed point (4 bytes per sample)
+
+// Fix_14_13 scale factor used by the WARPLab MEX transport (bit-exact with readSamples)
+#define WL_FIX_14_13_SCALE              0.00012207
+
+// UFix_16_15 scale factor and saturation limits of Write IQ samples
+#define WL_FIX_16_15_SCALE              32768.0
+#define WL_FIX_16_15_MIN               -32768.0
+#define WL_FIX_16_15_MAX                32767.0
+
+
+/*************************** Function Prototypes *****************************/
+
+// Instruction set selection
+//     NOTE:  The best instruction set supported by the CPU is selected on first use.  
+//         wl_kernel_select() overrides it (clamped to what the CPU supports) and returns the tier in use.
+int          wl_kernel_isa( void );
+int          wl_kernel_select( int isa );
+const char * wl_kernel_isa_name( int isa );
+
+// Decode num_samples WARPLab samples from a sample packet payload (big-endian UFix_16_0 words)
+// in to Fix_14_13 complex doubles
+void         wl_decode_iq( double complex *out, const uint8_t *payload, int num_samples );
+void         wl_decode_iq_scalar( double complex *out, const uint8_t *payload, int num_samples );
+
+// Decode in to Fix_14_13 complex floats (scaled in single precision) or Q15 int16 I / Q pairs 
+//     NOTE:  The int16 format is the 14 bit sample shifted up by 2 bits, so it is lossless and full scale
+//         matches the Write IQ int16 format
+void         wl_decode_iq_float( float complex *out, const uint8_t *payload, int num_samples );
+void         wl_decode_iq_float_scalar( float complex *out, const uint8_t *payload, int num_samples );
+void         wl_decode_iq_int16( int16_t *out, const uint8_t *payload, int num_samples );
+void         wl_decode_iq_int16_scalar( int16_t *out, const uint8_t *payload, int num_samples );
+
+// Decode num_samples samples of a sample packet payload in to output[offset ...] in the given format (WL_SAMPLE_*)
+void         wl_decode_samples( int format, void *output, uint32_t offset, const uint8_t *payload, int num_samples );
+void         wl_decode_raw32( uint32_t *out, const uint8_t *payload, int num_samples );
+
+// Encode num_samples complex samples in to a sample packet payload (big-endian words, I in bits [31:16] 
+// and Q in bits [15:0]).  Each component is scaled by 2^15, truncated toward zero and saturated to int16;
+//     NOTE:  NaN encodes as the negative full scale value (0x8000)
+void         wl_encode_iq( uint8_t *payload, const double complex *in, int num_samples );
+void         wl_encode_iq_scalar( uint8_t *payload, const double complex *in, int num_samples );
+void         wl_encode_iq_float( uint8_t *payload, const float complex *in, int num_samples );
+void         wl_encode_iq_float_scalar( uint8_t *payload, const float complex *in, int num_samples );
+void         wl_encode_iq_int16( uint8_t *payload, const int16_t *in, int num_samples );
+void         wl_encode_iq_int16_scalar( uint8_t *payload, const int16_t *in, int num_samples );
+
+// Encode input[offset ...] of the given format (WL_SAMPLE_*) in to a sample packet payload
+void         wl_encode_samples( int format, uint8_t *payload, const void *input, uint32_t offset, int num_samples );
+void         wl_encode_raw32( uint8_t *payload, const uint32_t *in, int num_samples );
+
+#endif
@@ -0,0 +1,159 @@
+// include the header
+#include "warp_rtt.h"
+#include "warp_stats.h"
+
+#include <string.h>
+
+#ifdef WIN32
+#include <winsock.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+
+/*********************** Global Variable Definitions *************************/
+
+static wl_rtt     node_rtt[WL_RTT_MAX_NODES][WL_RTT_NUM_OPS];   // Estimates of each node
+static uint32_t   node_address[WL_RTT_MAX_NODES];               // Address of the node owning each slot (0 if free)
+
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_rtt_sample
+*
+*  Adds a round trip sample of an operation (WL_RTT_*) to the estimate of the
+*  node at address and recomputes its retransmission timeout
+*
+*  NOTE:  Only round trips of requests that were not retransmitted may be
+*      sampled (Karn's algorithm), otherwise the response could belong to an
+*      earlier request.
+*
+******************************************************************************/
+void wl_rtt_sample( uint32_t address, int op, uint32_t rtt_us ) {
+
+    int        slot;
+    int64_t    srtt, rttvar, delta, rto;
+    wl_rtt    *rtt;
+
+    slot = wl_stats_node_slot( node_address, WL_RTT_MAX_NODES, address, 1 );
+
+    if ( slot < 0 ) {
+        return;
+    }
+
+    rtt = &node_rtt[slot][op];
+
+    if ( __atomic_load_n( &(rtt->samples), __ATOMIC_RELAXED ) == 0 ) {
+        srtt   = rtt_us;
+        rttvar = rtt_us / 2;
+    } else {
+        srtt   = __atomic_load_n( &(rtt->srtt_us),   __ATOMIC_RELAXED );
+        rttvar = __atomic_load_n( &(rtt->rttvar_us), __ATOMIC_RELAXED );
+        delta  = srtt - (int64_t) rtt_us;
+
+        rttvar = ( 3 * rttvar + ( ( delta < 0 ) ? -delta : delta ) ) / 4;
+        srtt   = ( 7 * srtt + rtt_us ) / 8;
+    }
+
+    rto = srtt + 4 * rttvar;
+
+    if ( rto < WL_RTT_MIN_US ) { rto = WL_RTT_MIN_US; }
+    if ( rto > WL_RTT_MAX_US ) { rto = WL_RTT_MAX_US; }
+
+    __atomic_store_n( &(rtt->srtt_us),   (uint32_t) srtt,   __ATOMIC_RELAXED );
+    __atomic_store_n( &(rtt->rttvar_us), (uint32_t) rttvar, __ATOMIC_RELAXED );
+    __atomic_store_n( &(rtt->rto_us),    (uint32_t) rto,    __ATOMIC_RELAXED );
+    __atomic_store_n( &(rtt->last_us),   rtt_us,            __ATOMIC_RELAXED );
+    __atomic_fetch_add( &(rtt->samples), 1,                 __ATOMIC_RELAXED );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_rtt_timeout
+*
+*  Returns the retransmission timeout (in us) of an operation (WL_RTT_*) to
+*  the node at address after backoff consecutive timeouts:  the timeout is
+*  doubled on each one, up to max_us (WL_RTT_MAX_US if 0)
+*
+******************************************************************************/
+uint32_t wl_rtt_timeout( uint32_t address, int op, uint32_t backoff, uint32_t max_us ) {
+
+    int        slot;
+    uint64_t   rto        = 0;
+
+    if ( max_us == 0 ) {
+        max_us = WL_RTT_MAX_US;
+    }
+
+    slot = wl_stats_node_slot( node_address, WL_RTT_MAX_NODES, address, 0 );
+
+    if ( slot >= 0 ) {
+        rto = __atomic_load_n( &(node_rtt[slot][op].rto_us), __ATOMIC_RELAXED );
+    }
+
+    if ( rto == 0 ) {
+        rto = WL_RTT_INIT_US;
+    }
+
+    // Bounded exponential backoff
+    while ( ( backoff > 0 ) && ( rto < max_us ) ) {
+        rto     <<= 1;
+        backoff  -= 1;
+    }
+
+    return ( rto > max_us ) ? max_us : (uint32_t) rto;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_rtt_reset
+*
+*  Forgets the estimates of every node
+*
+******************************************************************************/
+void wl_rtt_reset( void ) {
+
+    int        i, j;
+
+    for ( i = 0; i < WL_RTT_MAX_NODES; i++ ) {
+        for ( j = 0; j < WL_RTT_NUM_OPS; j++ ) {
+            __atomic_store_n( &(node_rtt[i][j].samples),   0, __ATOMIC_RELAXED );
+            __atomic_store_n( &(node_rtt[i][j].rto_us),    0, __ATOMIC_RELAXED );
+            __atomic_store_n( &(node_rtt[i][j].srtt_us),   0, __ATOMIC_RELAXED );
+            __atomic_store_n( &(node_rtt[i][j].rttvar_us), 0, __ATOMIC_RELAXED );
+            __atomic_store_n( &(node_rtt[i][j].last_us),   0, __ATOMIC_RELAXED );
+        }
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_rtt_get
+*
+*  Copies the estimate of an operation (WL_RTT_*) to the node at address
+*  (IPv4, network byte order) in to rtt
+*
+*  Returns:  0 on success, -1 if the node has no estimate
+*
+******************************************************************************/
+int wl_rtt_get( uint32_t address, int op, wl_rtt *rtt ) {
+
+    int slot = wl_stats_node_slot( node_address, WL_RTT_MAX_NODES, address, 0 );
+
+    if ( ( slot < 0 ) || ( op < 0 ) || ( op >= WL_RTT_NUM_OPS ) ) {
+        memset( rtt, 0, sizeof( wl_rtt ) );
+        return -1;
+    }
+
+    rtt->srtt_us   = __atomic_load_n( &(node_rtt[slot][op].srtt_us),   __ATOMIC_RELAXED );
+    rtt->rttvar_us = __atomic_load_n( &(node_rtt[slot][op].rttvar_us), __ATOMIC_RELAXED );
+    rtt->rto_us    = __atomic_load_n( &(node_rtt[slot][op].rto_us),    __ATOMIC_RELAXED );
+    rtt->last_us   = __atomic_load_n( &(node_rtt[slot][op].last_us),   __ATOMIC_RELAXED );
+    rtt->samples   = __atomic_load_n( &(node_rtt[slot][op].samples),   __ATOMIC_RELAXED );
+
+    return ( rtt->samples > 0 ) ? 0 : -1;
+}
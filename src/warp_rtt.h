@@ -0,0 +1,50 @@
+#ifndef WARP_RTT_H
+#define WARP_RTT_H
+
+/***************************** Include Files *********************************/
+#include <stdint.h>
+
+
+/*************************** Constant Definitions ****************************/
+
+// Round trip times are estimated for each node address seen on the sockets
+#define WL_RTT_MAX_NODES                256
+
+// Round trips with an estimate
+#define WL_RTT_READ                     0     // Read IQ command sent to first sample packet received
+#define WL_RTT_WRITE                    1     // Last Write IQ packet sent to checksum ack received
+#define WL_RTT_NUM_OPS                  2
+
+// Retransmission timeout bounds (in us)
+#define WL_RTT_MIN_US                   1000      // Lower bound of the timeout
+#define WL_RTT_MAX_US                   1000000   // Upper bound of the timeout and of its backoff
+#define WL_RTT_INIT_US                  100000    // Timeout of a node without a round trip sample
+
+
+/*************************** Variable Definitions ****************************/
+
+// Round trip estimate of one node (RFC 6298:  srtt and rttvar are EWMAs with gains 1/8 and 1/4,
+// the timeout is srtt + 4 * rttvar)
+//     NOTE:  Fields are read and written with relaxed atomic accesses;  when two threads sample
+//         the same node at the same time one of the samples may be lost.
+typedef struct
+{
+    uint32_t           srtt_us;           // Smoothed round trip time
+    uint32_t           rttvar_us;         // Round trip time variation
+    uint32_t           rto_us;            // Retransmission timeout (before backoff)
+    uint32_t           last_us;           // Last sample
+    uint64_t           samples;           // Number of samples
+} wl_rtt;
+
+
+/*************************** Function Prototypes *****************************/
+
+// Estimates updated by the transport
+void         wl_rtt_sample( uint32_t address, int op, uint32_t rtt_us );
+uint32_t     wl_rtt_timeout( uint32_t address, int op, uint32_t backoff, uint32_t max_us );
+
+// Runtime queries
+void         wl_rtt_reset( void );
+int          wl_rtt_get( uint32_t address, int op, wl_rtt *rtt );
+
+#endif
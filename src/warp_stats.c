@@ -0,0 +1,428 @@
+// include the header
+#include "warp_stats.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <winsock.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+
+/*********************** Global Variable Definitions *************************/
+
+static wl_stats   socket_stats[WL_STATS_MAX_SOCKETS];   // Counters of each socket index
+static wl_stats   node_stats[WL_STATS_MAX_NODES];       // Counters of each node
+static uint32_t   node_address[WL_STATS_MAX_NODES];     // Address of the node owning each slot (0 if free)
+static wl_stats   overflow_stats;                       // Sink for out of range sockets and nodes
+
+// Names of the counters (in the order of wl_stats) for wl_stats_dump_json
+static const struct {
+    const char *name;
+    size_t      offset;
+} counter_names[] = {
+    { "pkts_sent",           offsetof( wl_stats, pkts_sent )           },
+    { "pkts_rcvd",           offsetof( wl_stats, pkts_rcvd )           },
+    { "bytes_sent",          offsetof( wl_stats, bytes_sent )          },
+    { "bytes_rcvd",          offsetof( wl_stats, bytes_rcvd )          },
+    { "read_cmds",           offsetof( wl_stats, read_cmds )           },
+    { "read_retrans_cmds",   offsetof( wl_stats, read_retrans_cmds )   },
+    { "read_timeouts",       offsetof( wl_stats, read_timeouts )       },
+    { "read_dup_pkts",       offsetof( wl_stats, read_dup_pkts )       },
+    { "read_stray_pkts",     offsetof( wl_stats, read_stray_pkts )     },
+    { "read_samples",        offsetof( wl_stats, read_samples )        },
+    { "write_cmds",          offsetof( wl_stats, write_cmds )          },
+    { "write_timeouts",      offsetof( wl_stats, write_timeouts )      },
+    { "write_chksum_errors", offsetof( wl_stats, write_chksum_errors ) },
+    { "write_resumes",       offsetof( wl_stats, write_resumes )       },
+    { "write_samples",       offsetof( wl_stats, write_samples )       },
+    { "wait_spin",           offsetof( wl_stats, wait_spin )           },
+    { "wait_block",          offsetof( wl_stats, wait_block )          },
+    { "wait_timeouts",       offsetof( wl_stats, wait_timeouts )       },
+};
+
+static const char *op_names[WL_STATS_NUM_OPS] = { "read", "write" };
+
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_socket
+*
+*  Returns the counters of a socket index
+*
+******************************************************************************/
+wl_stats * wl_stats_socket( int index ) {
+
+    if ( ( index < 0 ) || ( index >= WL_STATS_MAX_SOCKETS ) ) {
+        return &overflow_stats;
+    }
+
+    return &socket_stats[index];
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_node_slot
+*
+*  Returns the slot of a node (IPv4 address in network byte order) in a table 
+*  of num_slots owner addresses (0 for a free slot);  a free slot is claimed 
+*  for a new node if claim is set.  Also used by the round trip estimates 
+*  (see warp_rtt.c).
+*
+*  Returns:  Index of the slot or -1 if the node has no slot
+*
+******************************************************************************/
+int wl_stats_node_slot( uint32_t *owners, int num_slots, uint32_t address, int claim ) {
+
+    int        i, slot;
+    uint32_t   owner;
+
+    if ( address == 0 ) {
+        return -1;
+    }
+
+    // Nodes are usually on one subnet, so hash on the host part of the address
+    slot = ntohl( address ) % num_slots;
+
+    for ( i = 0; i < num_slots; i++ ) {
+
+        owner = __atomic_load_n( &owners[slot], __ATOMIC_ACQUIRE );
+
+        if ( owner == address ) {
+            return slot;
+        }
+
+        if ( owner == 0 ) {
+            if ( !claim ) {
+                return -1;
+            }
+
+            // Another thread may claim the slot first (for this node or another one)
+            if ( __atomic_compare_exchange_n( &owners[slot], &owner, address, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ||
+                 ( owner == address ) ) {
+                return slot;
+            }
+        }
+
+        slot = ( slot + 1 ) % num_slots;
+    }
+
+    return -1;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_node
+*
+*  Returns the counters of the node at address (IPv4, network byte order)
+*
+******************************************************************************/
+wl_stats * wl_stats_node( uint32_t address ) {
+
+    int slot = wl_stats_node_slot( node_address, WL_STATS_MAX_NODES, address, 1 );
+
+    if ( slot < 0 ) {
+        return &overflow_stats;
+    }
+
+    return &node_stats[slot];
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_hist_add
+*
+*  Adds a latency to a histogram
+*
+******************************************************************************/
+static void wl_stats_hist_add( wl_stats_hist *hist, uint64_t latency_us ) {
+
+    int        bucket;
+    uint64_t   max_us;
+
+    bucket = ( latency_us == 0 ) ? 0 : ( 64 - __builtin_clzll( latency_us ) );
+
+    if ( bucket >= WL_STATS_HIST_BUCKETS ) {
+        bucket = WL_STATS_HIST_BUCKETS - 1;
+    }
+
+    __atomic_fetch_add( &(hist->count),           1,          __ATOMIC_RELAXED );
+    __atomic_fetch_add( &(hist->total_us),        latency_us, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &(hist->buckets[bucket]), 1,          __ATOMIC_RELAXED );
+
+    max_us = __atomic_load_n( &(hist->max_us), __ATOMIC_RELAXED );
+
+    while ( ( latency_us > max_us ) &&
+            !__atomic_compare_exchange_n( &(hist->max_us), &max_us, latency_us, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_op
+*
+*  Records the latency of an operation (WL_STATS_OP_*) on a socket to the node
+*  at address
+*
+******************************************************************************/
+void wl_stats_op( int index, uint32_t address, int op, const struct timespec *start, const struct timespec *end ) {
+
+    int64_t    latency_ns;
+
+    latency_ns = ( (int64_t) ( end->tv_sec - start->tv_sec ) * 1000000000LL ) + ( end->tv_nsec - start->tv_nsec );
+
+    if ( latency_ns < 0 ) {
+        latency_ns = 0;
+    }
+
+    wl_stats_hist_add( &( wl_stats_socket( index )->latency[op] ), (uint64_t) latency_ns / 1000 );
+    wl_stats_hist_add( &( wl_stats_node( address )->latency[op] ),  (uint64_t) latency_ns / 1000 );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_clear / wl_stats_copy
+*
+*  Reset / copy a set of counters one word at a time
+*
+******************************************************************************/
+static void wl_stats_clear( wl_stats *stats ) {
+
+    size_t     i;
+    uint64_t  *words = (uint64_t *) stats;
+
+    for ( i = 0; i < sizeof( wl_stats ) / sizeof( uint64_t ); i++ ) {
+        __atomic_store_n( &words[i], 0, __ATOMIC_RELAXED );
+    }
+}
+
+static void wl_stats_copy( wl_stats *dest, wl_stats *src ) {
+
+    size_t     i;
+    uint64_t  *dest_words = (uint64_t *) dest;
+    uint64_t  *src_words  = (uint64_t *) src;
+
+    for ( i = 0; i < sizeof( wl_stats ) / sizeof( uint64_t ); i++ ) {
+        dest_words[i] = __atomic_load_n( &src_words[i], __ATOMIC_RELAXED );
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_reset
+*
+*  Resets the counters of every socket and node
+*
+******************************************************************************/
+void wl_stats_reset( void ) {
+
+    int i;
+
+    for ( i = 0; i < WL_STATS_MAX_SOCKETS; i++ ) {
+        wl_stats_clear( &socket_stats[i] );
+    }
+
+    for ( i = 0; i < WL_STATS_MAX_NODES; i++ ) {
+        wl_stats_clear( &node_stats[i] );
+    }
+
+    wl_stats_clear( &overflow_stats );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_reset_socket
+*
+*  Resets the counters of a socket (called when the socket index is reused)
+*
+******************************************************************************/
+void wl_stats_reset_socket( int index ) {
+
+    if ( ( index >= 0 ) && ( index < WL_STATS_MAX_SOCKETS ) ) {
+        wl_stats_clear( &socket_stats[index] );
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_get_socket / wl_stats_get_node
+*
+*  Copy the counters of a socket / of the node at address (IPv4, network byte
+*  order) in to stats
+*
+*  Returns:  0 on success, -1 if there are no counters for the socket / node
+*
+******************************************************************************/
+int wl_stats_get_socket( int index, wl_stats *stats ) {
+
+    if ( ( index < 0 ) || ( index >= WL_STATS_MAX_SOCKETS ) ) {
+        return -1;
+    }
+
+    wl_stats_copy( stats, &socket_stats[index] );
+
+    return 0;
+}
+
+int wl_stats_get_node( uint32_t address, wl_stats *stats ) {
+
+    int slot = wl_stats_node_slot( node_address, WL_STATS_MAX_NODES, address, 0 );
+
+    if ( slot < 0 ) {
+        memset( stats, 0, sizeof( wl_stats ) );
+        return -1;
+    }
+
+    wl_stats_copy( stats, &node_stats[slot] );
+
+    return 0;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_percentile
+*
+*  Estimates the p-th percentile (0 - 100) of a latency histogram in us;
+*  latencies are spread evenly over their bucket
+*
+******************************************************************************/
+double wl_stats_percentile( const wl_stats_hist *hist, double p ) {
+
+    int        b;
+    double     target;
+    double     low, high;
+    uint64_t   seen = 0;
+
+    if ( hist->count == 0 ) {
+        return 0.0;
+    }
+
+    target = ( p / 100.0 ) * (double) hist->count;
+
+    for ( b = 0; b < WL_STATS_HIST_BUCKETS; b++ ) {
+
+        if ( ( hist->buckets[b] > 0 ) && ( (double) ( seen + hist->buckets[b] ) >= target ) ) {
+
+            low  = ( b == 0 ) ? 0.0 : (double) ( 1ULL << ( b - 1 ) );
+            high = ( b == WL_STATS_HIST_BUCKETS - 1 ) ? (double) hist->max_us : (double) ( 1ULL << b );
+
+            if ( high > (double) hist->max_us ) {
+                high = (double) hist->max_us;
+            }
+
+            return low + ( high - low ) * ( ( target - (double) seen ) / (double) hist->buckets[b] );
+        }
+
+        seen += hist->buckets[b];
+    }
+
+    return (double) hist->max_us;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_print_json
+*
+*  Prints one set of counters as the members of a JSON object
+*
+******************************************************************************/
+static void wl_stats_print_json( FILE *fp, wl_stats *stats ) {
+
+    int              i, b;
+    size_t           c;
+    wl_stats_hist   *hist;
+
+    for ( c = 0; c < sizeof( counter_names ) / sizeof( counter_names[0] ); c++ ) {
+        fprintf( fp, "\"%s\": %llu, ", counter_names[c].name,
+                 (unsigned long long) *( (uint64_t *) ( (char *) stats + counter_names[c].offset ) ) );
+    }
+
+    for ( i = 0; i < WL_STATS_NUM_OPS; i++ ) {
+
+        hist = &( stats->latency[i] );
+
+        fprintf( fp, "\"%s_latency_us\": {\"count\": %llu, \"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, \"max\": %llu, \"buckets\": [",
+                 op_names[i], (unsigned long long) hist->count,
+                 ( hist->count == 0 ) ? 0.0 : ( (double) hist->total_us / (double) hist->count ),
+                 wl_stats_percentile( hist, 50.0 ), wl_stats_percentile( hist, 99.0 ),
+                 (unsigned long long) hist->max_us );
+
+        for ( b = 0; b < WL_STATS_HIST_BUCKETS; b++ ) {
+            fprintf( fp, "%s%llu", ( b == 0 ) ? "" : ", ", (unsigned long long) hist->buckets[b] );
+        }
+
+        fprintf( fp, "]}%s", ( i == WL_STATS_NUM_OPS - 1 ) ? "" : ", " );
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_stats_dump_json
+*
+*  Prints the counters of every socket and node that has seen traffic as a
+*  JSON object:  {"sockets": [...], "nodes": [...]}
+*
+******************************************************************************/
+void wl_stats_dump_json( FILE *fp ) {
+
+    int              i;
+    int              first;
+    uint32_t         address;
+    struct in_addr   in;
+    wl_stats         stats;
+
+    fprintf( fp, "{\"sockets\": [" );
+
+    first = 1;
+    for ( i = 0; i < WL_STATS_MAX_SOCKETS; i++ ) {
+
+        wl_stats_copy( &stats, &socket_stats[i] );
+
+        if ( ( stats.pkts_sent == 0 ) && ( stats.pkts_rcvd == 0 ) ) {
+            continue;
+        }
+
+        fprintf( fp, "%s\n  {\"index\": %d, ", first ? "" : ",", i );
+        wl_stats_print_json( fp, &stats );
+        fprintf( fp, "}" );
+
+        first = 0;
+    }
+
+    fprintf( fp, "],\n \"nodes\": [" );
+
+    first = 1;
+    for ( i = 0; i < WL_STATS_MAX_NODES; i++ ) {
+
+        address = __atomic_load_n( &node_address[i], __ATOMIC_ACQUIRE );
+
+        if ( address == 0 ) {
+            continue;
+        }
+
+        wl_stats_copy( &stats, &node_stats[i] );
+
+        in.s_addr = address;
+
+        fprintf( fp, "%s\n  {\"ip_addr\": \"%s\", ", first ? "" : ",", inet_ntoa( in ) );
+        wl_stats_print_json( fp, &stats );
+        fprintf( fp, "}" );
+
+        first = 0;
+    }
+
+    fprintf( fp, "]}\n" );
+}
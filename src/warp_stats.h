@@ -0,0 +1,93 @@
+#ifndef WARP_STATS_H
+#define WARP_STATS_H
+
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+
+/*************************** Constant Definitions ****************************/
+
+// Statistics are kept for each socket index and for each node address seen on the sockets
+#define WL_STATS_MAX_SOCKETS            1024  // Also the bound of the socket registry (TRANSPORT_MAX_SOCKETS)
+#define WL_STATS_MAX_NODES              256
+
+// Latency histograms:  bucket 0 is [0, 1) us, bucket b is [2^(b-1), 2^b) us, the last bucket is open
+#define WL_STATS_HIST_BUCKETS           24
+
+// Operations with a latency histogram
+#define WL_STATS_OP_READ                0     // Read IQ of one node (all chunks and retransmits)
+#define WL_STATS_OP_WRITE               1     // Write IQ of one node (including the checksum ack)
+#define WL_STATS_NUM_OPS                2
+
+
+/*************************** Variable Definitions ****************************/
+
+// Latency histogram
+typedef struct
+{
+    uint64_t           count;             // Number of operations
+    uint64_t           total_us;          // Sum of the latencies
+    uint64_t           max_us;            // Largest latency
+    uint64_t           buckets[WL_STATS_HIST_BUCKETS];
+} wl_stats_hist;
+
+// Transport counters
+//     NOTE:  Every field is a uint64_t so that a counter set can be reset and copied word by word
+//         with atomic accesses (see wl_stats_reset_socket / wl_stats_get_socket).  Counters are
+//         updated with relaxed atomic adds, so readers get a consistent value per counter but not
+//         a consistent snapshot across counters.
+typedef struct
+{
+    uint64_t           pkts_sent;         // Packets sent
+    uint64_t           pkts_rcvd;         // Packets received
+    uint64_t           bytes_sent;        // Bytes sent (UDP payload)
+    uint64_t           bytes_rcvd;        // Bytes received (UDP payload)
+    uint64_t           read_cmds;         // Read IQ commands sent (including retransmit requests)
+    uint64_t           read_retrans_cmds; // Read IQ commands sent to re-request missing packets
+    uint64_t           read_timeouts;     // Read IQ response timer expirations
+    uint64_t           read_dup_pkts;     // Duplicate sample packets dropped
+    uint64_t           read_stray_pkts;   // Sample packets that did not match a transfer
+    uint64_t           read_samples;      // Samples received
+    uint64_t           write_cmds;        // Write IQ packets sent (including retransmissions)
+    uint64_t           write_timeouts;    // Write IQ packets retransmitted after a response timeout
+    uint64_t           write_chksum_errors;  // Write IQ checksum mismatches
+    uint64_t           write_resumes;     // Write IQ windows resent from the last good checkpoint
+    uint64_t           write_samples;     // Samples written
+    uint64_t           wait_spin;         // Response waits that ended with a packet while spinning
+    uint64_t           wait_block;        // Response waits that ended with a packet after blocking in ppoll()
+    uint64_t           wait_timeouts;     // Response waits that ended with the timer (socket counters only)
+    wl_stats_hist      latency[WL_STATS_NUM_OPS];    // Latency of the operations (WL_STATS_OP_*)
+} wl_stats;
+
+
+/***************************** Macro Definitions *****************************/
+
+// Add to a counter of a socket and of the node at address (IPv4, network byte order)
+#define WL_STATS_ADD(index, address, field, n)                                                      \
+    {                                                                                              \
+        __atomic_fetch_add( &( wl_stats_socket( index )->field ),    (uint64_t) (n), __ATOMIC_RELAXED ); \
+        __atomic_fetch_add( &( wl_stats_node( address )->field ),    (uint64_t) (n), __ATOMIC_RELAXED ); \
+    }
+
+
+/*************************** Function Prototypes *****************************/
+
+// Counters updated by the transport
+wl_stats *   wl_stats_socket( int index );
+wl_stats *   wl_stats_node( uint32_t address );
+void         wl_stats_op( int index, uint32_t address, int op, const struct timespec *start, const struct timespec *end );
+
+// Slot of a node address in a table of node addresses (shared with warp_rtt.c)
+int          wl_stats_node_slot( uint32_t *owners, int num_slots, uint32_t address, int claim );
+
+// Runtime queries
+void         wl_stats_reset( void );
+void         wl_stats_reset_socket( int index );
+int          wl_stats_get_socket( int index, wl_stats *stats );
+int          wl_stats_get_node( uint32_t address, wl_stats *stats );
+double       wl_stats_percentile( const wl_stats_hist *hist, double p );
+void         wl_stats_dump_json( FILE *fp );
+
+#endif
@@ -0,0 +1,410 @@
+// include the header
+#include "warp_trace.h"
+
+#include <string.h>
+
+#ifdef WIN32
+#include <winsock.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+
+/*********************** Global Variable Definitions *************************/
+
+static int               trace_enabled = 0;                     // Take timestamps in the transport
+static wl_trace_record   trace_ring[WL_TRACE_MAX_RECORDS];     // Most recent records
+static uint64_t          trace_head    = 0;                     // Sequence number of the next record committed
+static uint64_t          trace_tail    = 0;                     // Sequence number of the next record read
+
+static const char *op_names[] = { "read", "write" };
+
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_enable / wl_trace_enabled
+*
+*  Turn the collection of trace records on or off / return whether it is on
+*
+******************************************************************************/
+void wl_trace_enable( int enable ) {
+
+    __atomic_store_n( &trace_enabled, ( enable != 0 ), __ATOMIC_RELAXED );
+}
+
+int wl_trace_enabled( void ) {
+
+    return __atomic_load_n( &trace_enabled, __ATOMIC_RELAXED );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_now / wl_trace_ns
+*
+*  Return the current CLOCK_MONOTONIC time / a timespec in ns
+*
+******************************************************************************/
+uint64_t wl_trace_ns( const struct timespec *time ) {
+
+    return ( (uint64_t) time->tv_sec * 1000000000ULL ) + (uint64_t) time->tv_nsec;
+}
+
+uint64_t wl_trace_now( void ) {
+
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return wl_trace_ns( &now );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_kernel_ns
+*
+*  Converts a kernel receive timestamp (CLOCK_REALTIME) to CLOCK_MONOTONIC ns
+*
+******************************************************************************/
+uint64_t wl_trace_kernel_ns( const struct timespec *stamp ) {
+
+    struct timespec realtime;
+    uint64_t        monotonic_ns;
+    uint64_t        realtime_ns;
+
+    monotonic_ns = wl_trace_now();
+    clock_gettime( CLOCK_REALTIME, &realtime );
+    realtime_ns  = wl_trace_ns( &realtime );
+
+    // The packet was received before now, so it is never later than monotonic_ns
+    if ( realtime_ns - wl_trace_ns( stamp ) > monotonic_ns ) {
+        return 0;
+    }
+
+    return monotonic_ns - ( realtime_ns - wl_trace_ns( stamp ) );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_begin
+*
+*  Starts a trace record for an operation (WL_TRACE_OP_*) on a socket to the
+*  node at address
+*
+******************************************************************************/
+void wl_trace_begin( wl_trace_record *record, int op, int index, uint32_t address, uint64_t start_ns ) {
+
+    memset( record, 0, sizeof( wl_trace_record ) );
+
+    record->op       = op;
+    record->index    = index;
+    record->address  = address;
+    record->start_ns = start_ns;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_merge
+*
+*  Adds the phases of one Read IQ transfer to a record;  the record of a
+*  chunked read spans every chunk of the node
+*
+******************************************************************************/
+static void wl_trace_min( uint64_t *value, uint64_t time ) {
+    if ( ( time != 0 ) && ( ( *value == 0 ) || ( time < *value ) ) ) { *value = time; }
+}
+
+static void wl_trace_max( uint64_t *value, uint64_t time ) {
+    if ( time > *value ) { *value = time; }
+}
+
+void wl_trace_merge( wl_trace_record *record, const wl_trace_phases *phases ) {
+
+    wl_trace_min( &(record->request_ns),      phases->request_ns );
+    wl_trace_min( &(record->first_pkt_ns),    phases->first_pkt_ns );
+    wl_trace_max( &(record->last_pkt_ns),     phases->last_pkt_ns );
+    wl_trace_min( &(record->kernel_first_ns), phases->kernel_first_ns );
+    wl_trace_max( &(record->kernel_last_ns),  phases->kernel_last_ns );
+    wl_trace_min( &(record->decode_start_ns), phases->decode_start_ns );
+    wl_trace_max( &(record->decode_end_ns),   phases->decode_end_ns );
+
+    record->decode_ns += phases->decode_ns;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_commit
+*
+*  Ends a record:  turns its timestamps in to times since the start of the
+*  operation and stores it in the ring.  Writers only contend on the head of
+*  the ring, so records can be committed from several threads.
+*
+******************************************************************************/
+static void wl_trace_offset( uint64_t *time, uint64_t start_ns ) {
+    if ( *time != 0 ) { *time = ( *time > start_ns ) ? ( *time - start_ns ) : 0; }
+}
+
+void wl_trace_commit( wl_trace_record *record, uint64_t end_ns ) {
+
+    uint32_t           i;
+    uint64_t           seq;
+    wl_trace_record   *slot;
+
+    record->end_ns = end_ns;
+
+    wl_trace_offset( &(record->end_ns),          record->start_ns );
+    wl_trace_offset( &(record->request_ns),      record->start_ns );
+    wl_trace_offset( &(record->first_pkt_ns),    record->start_ns );
+    wl_trace_offset( &(record->last_pkt_ns),     record->start_ns );
+    wl_trace_offset( &(record->kernel_first_ns), record->start_ns );
+    wl_trace_offset( &(record->kernel_last_ns),  record->start_ns );
+    wl_trace_offset( &(record->decode_start_ns), record->start_ns );
+    wl_trace_offset( &(record->decode_end_ns),   record->start_ns );
+
+    for ( i = 0; i < record->num_pkt_times; i++ ) {
+        wl_trace_offset( &(record->pkt_send_ns[i]), record->start_ns );
+    }
+
+    seq  = __atomic_fetch_add( &trace_head, 1, __ATOMIC_RELAXED );
+    slot = &trace_ring[seq % WL_TRACE_MAX_RECORDS];
+
+    // The slot is marked invalid while it is written, then published with its sequence number
+    __atomic_store_n( &(slot->seq), 0, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+
+    memcpy( (char *) slot + sizeof( uint64_t ), (char *) record + sizeof( uint64_t ), sizeof( wl_trace_record ) - sizeof( uint64_t ) );
+
+    __atomic_store_n( &(slot->seq), seq + 1, __ATOMIC_RELEASE );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_get
+*
+*  Copies the record with sequence number seq out of the ring
+*
+*  Returns:  1 on success, 0 if the record was overwritten or is being written
+*
+******************************************************************************/
+static int wl_trace_get( uint64_t seq, wl_trace_record *record ) {
+
+    wl_trace_record   *slot = &trace_ring[seq % WL_TRACE_MAX_RECORDS];
+
+    if ( __atomic_load_n( &(slot->seq), __ATOMIC_ACQUIRE ) != seq + 1 ) {
+        return 0;
+    }
+
+    memcpy( record, slot, sizeof( wl_trace_record ) );
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+    if ( __atomic_load_n( &(slot->seq), __ATOMIC_RELAXED ) != seq + 1 ) {
+        return 0;
+    }
+
+    record->seq = seq;
+
+    return 1;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_first
+*
+*  Returns the sequence number of the oldest record still in the ring that
+*  has not been read (see wl_trace_read)
+*
+******************************************************************************/
+static uint64_t wl_trace_first( uint64_t head ) {
+
+    uint64_t tail = __atomic_load_n( &trace_tail, __ATOMIC_RELAXED );
+
+    if ( head - tail > WL_TRACE_MAX_RECORDS ) {
+        tail = head - WL_TRACE_MAX_RECORDS;
+    }
+
+    return tail;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_reset
+*
+*  Drops every record in the ring
+*
+******************************************************************************/
+void wl_trace_reset( void ) {
+
+    __atomic_store_n( &trace_tail, __atomic_load_n( &trace_head, __ATOMIC_RELAXED ), __ATOMIC_RELAXED );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_read
+*
+*  Copies up to max_records of the oldest unread records in to records and
+*  removes them from the ring
+*
+*  Returns:  Number of records copied
+*
+******************************************************************************/
+int wl_trace_read( wl_trace_record *records, int max_records ) {
+
+    int        num  = 0;
+    uint64_t   head = __atomic_load_n( &trace_head, __ATOMIC_RELAXED );
+    uint64_t   seq  = wl_trace_first( head );
+
+    for ( ; ( seq < head ) && ( num < max_records ); seq++ ) {
+        if ( wl_trace_get( seq, &records[num] ) ) {
+            num += 1;
+        }
+    }
+
+    __atomic_store_n( &trace_tail, seq, __ATOMIC_RELAXED );
+
+    return num;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_dump_json
+*
+*  Prints every unread record in the ring as one JSON object per line
+*  (records are not removed)
+*
+******************************************************************************/
+void wl_trace_dump_json( FILE *fp ) {
+
+    uint32_t          i;
+    uint64_t          head = __atomic_load_n( &trace_head, __ATOMIC_RELAXED );
+    uint64_t          seq;
+    struct in_addr    in;
+    wl_trace_record   record;
+
+    for ( seq = wl_trace_first( head ); seq < head; seq++ ) {
+
+        if ( !wl_trace_get( seq, &record ) ) {
+            continue;
+        }
+
+        in.s_addr = record.address;
+
+        fprintf( fp, "{\"seq\": %llu, \"op\": \"%s\", \"index\": %d, \"ip_addr\": \"%s\", \"num_samples\": %u, \"num_pkts\": %u, "
+                     "\"num_cmds\": %u, \"retrans_rounds\": %u, \"start_ns\": %llu, \"total_ns\": %llu, ",
+                 (unsigned long long) record.seq, op_names[record.op], record.index, inet_ntoa( in ),
+                 record.num_samples, record.num_pkts, record.num_cmds, record.retrans_rounds,
+                 (unsigned long long) record.start_ns, (unsigned long long) record.end_ns );
+
+        if ( record.op == WL_TRACE_OP_READ ) {
+            fprintf( fp, "\"request_ns\": %llu, \"first_pkt_ns\": %llu, \"last_pkt_ns\": %llu, \"kernel_first_ns\": %llu, "
+                         "\"kernel_last_ns\": %llu, \"decode_start_ns\": %llu, \"decode_end_ns\": %llu, \"decode_ns\": %llu}\n",
+                     (unsigned long long) record.request_ns, (unsigned long long) record.first_pkt_ns,
+                     (unsigned long long) record.last_pkt_ns, (unsigned long long) record.kernel_first_ns,
+                     (unsigned long long) record.kernel_last_ns, (unsigned long long) record.decode_start_ns,
+                     (unsigned long long) record.decode_end_ns, (unsigned long long) record.decode_ns );
+        } else {
+            fprintf( fp, "\"encode_ns\": %llu, \"send_ns\": %llu, \"ack_wait_ns\": %llu, \"pace_ns\": %llu, \"pkt_send_ns\": [",
+                     (unsigned long long) record.encode_ns, (unsigned long long) record.send_ns,
+                     (unsigned long long) record.ack_wait_ns, (unsigned long long) record.pace_ns );
+
+            for ( i = 0; i < record.num_pkt_times; i++ ) {
+                fprintf( fp, "%s%llu", ( i == 0 ) ? "" : ", ", (unsigned long long) record.pkt_send_ns[i] );
+            }
+
+            fprintf( fp, "]}\n" );
+        }
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_trace_print_summary
+*
+*  Prints the mean time (in us) spent in each phase over the unread records
+*  in the ring
+*
+******************************************************************************/
+void wl_trace_print_summary( FILE *fp ) {
+
+    int               op;
+    uint64_t          head = __atomic_load_n( &trace_head, __ATOMIC_RELAXED );
+    uint64_t          seq;
+    double            count[2]   = { 0.0, 0.0 };
+    double            total[2]   = { 0.0, 0.0 };
+    double            rounds[2]  = { 0.0, 0.0 };
+    double            request    = 0.0;         // Start to request sent
+    double            first      = 0.0;         // Request sent to first packet
+    double            train      = 0.0;         // First to last packet
+    double            tail       = 0.0;         // Last packet to end
+    double            decode     = 0.0;
+    double            wakeup     = 0.0;         // Kernel receive to first packet handed to the transfer
+    double            stamped    = 0.0;
+    double            encode     = 0.0;
+    double            send       = 0.0;
+    double            ack_wait   = 0.0;
+    double            pace       = 0.0;
+    wl_trace_record   r;
+
+    for ( seq = wl_trace_first( head ); seq < head; seq++ ) {
+
+        if ( !wl_trace_get( seq, &r ) ) {
+            continue;
+        }
+
+        op           = r.op;
+        count[op]   += 1.0;
+        total[op]   += r.end_ns;
+        rounds[op]  += r.retrans_rounds;
+
+        if ( op == WL_TRACE_OP_READ ) {
+            request += r.request_ns;
+            first   += (double) r.first_pkt_ns - (double) r.request_ns;
+            train   += (double) r.last_pkt_ns  - (double) r.first_pkt_ns;
+            tail    += (double) r.end_ns       - (double) r.last_pkt_ns;
+            decode  += r.decode_ns;
+
+            if ( r.kernel_first_ns != 0 ) {
+                wakeup  += (double) r.first_pkt_ns - (double) r.kernel_first_ns;
+                stamped += 1.0;
+            }
+        } else {
+            encode   += r.encode_ns;
+            send     += r.send_ns;
+            ack_wait += r.ack_wait_ns;
+            pace     += r.pace_ns;
+        }
+    }
+
+    if ( count[WL_TRACE_OP_READ] > 0.0 ) {
+        op = WL_TRACE_OP_READ;
+        fprintf( fp, "Read IQ:  %.0f ops, mean %.1f us:  request %.1f, to first packet %.1f, packet train %.1f, after last packet %.1f "
+                     "(decode %.1f), %.2f retransmit rounds",
+                 count[op], total[op] / count[op] / 1e3, request / count[op] / 1e3, first / count[op] / 1e3,
+                 train / count[op] / 1e3, tail / count[op] / 1e3, decode / count[op] / 1e3, rounds[op] / count[op] );
+
+        if ( stamped > 0.0 ) {
+            fprintf( fp, ", kernel to user %.1f", wakeup / stamped / 1e3 );
+        }
+
+        fprintf( fp, "\n" );
+    }
+
+    if ( count[WL_TRACE_OP_WRITE] > 0.0 ) {
+        op = WL_TRACE_OP_WRITE;
+        fprintf( fp, "Write IQ: %.0f ops, mean %.1f us:  encode %.1f, send %.1f, ack wait %.1f, pacing %.1f, other %.1f, "
+                     "%.2f retransmit rounds\n",
+                 count[op], total[op] / count[op] / 1e3, encode / count[op] / 1e3, send / count[op] / 1e3,
+                 ack_wait / count[op] / 1e3, pace / count[op] / 1e3,
+                 ( total[op] - encode - send - ack_wait - pace ) / count[op] / 1e3, rounds[op] / count[op] );
+    }
+}
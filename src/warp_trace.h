@@ -0,0 +1,97 @@
+#ifndef WARP_TRACE_H
+#define WARP_TRACE_H
+
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+
+/*************************** Constant Definitions ****************************/
+
+// Number of trace records kept; the oldest record is overwritten when the ring is full
+#define WL_TRACE_MAX_RECORDS            4096
+
+// Number of Write IQ packets with a send time in a record (a 32K sample write is 15 jumbo packets)
+#define WL_TRACE_MAX_PKTS               64
+
+// Operations (same values as WL_STATS_OP_*)
+#define WL_TRACE_OP_READ                0     // Read IQ of one node (all chunks and retransmits)
+#define WL_TRACE_OP_WRITE               1     // Write IQ of one node (including the checksum ack)
+
+
+/*************************** Variable Definitions ****************************/
+
+// Phase timestamps of one Read IQ transfer (absolute CLOCK_MONOTONIC time in ns, 0 if the phase did not happen)
+//     NOTE:  Samples are decoded as the packets arrive, so decoding starts with the first packet and
+//         ends after the last one;  decode_ns is the time actually spent in the decode kernels.
+//         Kernel receive times (SO_TIMESTAMPNS, see set_receive_timestamps) are converted from
+//         CLOCK_REALTIME when they are taken.
+typedef struct
+{
+    uint64_t           request_ns;        // First Read IQ command sent
+    uint64_t           first_pkt_ns;      // First sample packet handed to the transfer
+    uint64_t           last_pkt_ns;       // Last sample packet handed to the transfer
+    uint64_t           kernel_first_ns;   // Kernel receive time of the first sample packet
+    uint64_t           kernel_last_ns;    // Kernel receive time of the last sample packet
+    uint64_t           decode_start_ns;   // First decode started
+    uint64_t           decode_end_ns;     // Last decode finished
+    uint64_t           decode_ns;         // Total time spent decoding
+} wl_trace_phases;
+
+// Trace record of one Read IQ / Write IQ operation to one node
+//     NOTE:  All times except start_ns are in ns since start_ns (0 if the phase did not happen)
+typedef struct
+{
+    uint64_t           seq;               // Sequence number of the record (set by wl_trace_commit)
+    int                op;                // Operation (WL_TRACE_OP_*)
+    int                index;             // Socket index
+    uint32_t           address;           // Node address (IPv4, network byte order)
+    uint32_t           num_samples;       // Samples transferred
+    uint32_t           num_pkts;          // Sample packets received (read) / sent (write, including retransmissions)
+    uint32_t           num_cmds;          // Read IQ commands sent (read) / packets that asked for an ack (write)
+    uint32_t           retrans_rounds;    // Retransmit rounds (read timeouts / write timeouts and checkpoint resumes)
+    uint64_t           start_ns;          // Start of the operation (CLOCK_MONOTONIC)
+    uint64_t           end_ns;            // End of the operation (total latency)
+
+    // Read IQ phases
+    uint64_t           request_ns;        // First Read IQ command sent
+    uint64_t           first_pkt_ns;      // First sample packet received
+    uint64_t           last_pkt_ns;       // Last sample packet received
+    uint64_t           kernel_first_ns;   // Kernel receive time of the first sample packet (SO_TIMESTAMPNS)
+    uint64_t           kernel_last_ns;    // Kernel receive time of the last sample packet (SO_TIMESTAMPNS)
+    uint64_t           decode_start_ns;   // First decode started
+    uint64_t           decode_end_ns;     // Last decode finished
+    uint64_t           decode_ns;         // Time spent decoding
+
+    // Write IQ phases
+    uint64_t           encode_ns;         // Time spent encoding
+    uint64_t           send_ns;           // Time spent in send calls
+    uint64_t           ack_wait_ns;       // Time spent waiting for checksum acks
+    uint64_t           pace_ns;           // Time spent in the inter-packet delay
+    uint32_t           num_pkt_times;     // Packets in pkt_send_ns
+    uint64_t           pkt_send_ns[WL_TRACE_MAX_PKTS];   // Time each packet was handed to the socket
+} wl_trace_record;
+
+
+/*************************** Function Prototypes *****************************/
+
+// Tracing is off by default;  the transport only takes timestamps while it is on
+void         wl_trace_enable( int enable );
+int          wl_trace_enabled( void );
+uint64_t     wl_trace_now( void );
+uint64_t     wl_trace_ns( const struct timespec *time );
+uint64_t     wl_trace_kernel_ns( const struct timespec *stamp );
+
+// Records filled in by the transport
+void         wl_trace_begin( wl_trace_record *record, int op, int index, uint32_t address, uint64_t start_ns );
+void         wl_trace_merge( wl_trace_record *record, const wl_trace_phases *phases );
+void         wl_trace_commit( wl_trace_record *record, uint64_t end_ns );
+
+// Runtime queries
+void         wl_trace_reset( void );
+int          wl_trace_read( wl_trace_record *records, int max_records );
+void         wl_trace_dump_json( FILE *fp );
+void         wl_trace_print_summary( FILE *fp );
+
+#endif
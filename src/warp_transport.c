@@ -6,9 +6,91 @@
 /*********************** Global Variable Definitions *************************/
 
 int       initialized    = 0;   // Global variable to initialize the driver
-static int       tx_buffer_size = 0;   // Global variable for TX buffer size
-static int       rx_buffer_size = 0;   // Global variable for RX buffer size
-wl_trans_socket  sockets[TRANSPORT_MAX_SOCKETS];  // Global structure of socket connections
+
+// Socket registry
+//     NOTE:  Sockets are added TRANSPORT_SOCKET_CHUNK at a time and never move, so a socket is used
+//         without taking the registry lock while other threads create and close sockets.
+static wl_trans_socket *socket_chunks[TRANSPORT_MAX_SOCKETS / TRANSPORT_SOCKET_CHUNK];
+static int       num_sockets    = 0;   // Number of sockets in the registry
+static int       free_sockets   = -1;  // First socket of the free list (-1 if empty)
+static int       registry_lock  = 0;   // Lock of the free list
+
+#ifdef WIN32
+static WSADATA   wsaData;              // Structure for WinSock setup communication 
+#endif
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_socket
+*
+*  Returns the socket at index in the registry
+*
+******************************************************************************/
+static inline wl_trans_socket * wl_socket( int index ) {
+
+    return &( socket_chunks[index / TRANSPORT_SOCKET_CHUNK][index % TRANSPORT_SOCKET_CHUNK] );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_registry_lock / wl_registry_unlock
+*
+*  Take / release the lock of the socket registry (only held while a socket 
+*  is taken from or put back on the free list)
+*
+******************************************************************************/
+static void wl_registry_lock( void ) {
+
+    while ( __atomic_exchange_n( &registry_lock, 1, __ATOMIC_ACQUIRE ) ) { }
+}
+
+static void wl_registry_unlock( void ) {
+
+    __atomic_store_n( &registry_lock, 0, __ATOMIC_RELEASE );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_registry_grow
+*
+*  Adds TRANSPORT_SOCKET_CHUNK free sockets to the registry (called with the 
+*  registry lock held when the free list is empty)
+*
+******************************************************************************/
+static void wl_registry_grow( void ) {
+
+    wl_trans_socket    *chunk;
+    int                 i;
+
+    // Check to see if we cannot allocate a socket
+    if ( num_sockets == TRANSPORT_MAX_SOCKETS ) {
+        die_with_error("Error:  Cannot allocate a socket");
+    }
+
+    chunk = (wl_trans_socket *) calloc( TRANSPORT_SOCKET_CHUNK, sizeof(wl_trans_socket) );
+
+    if ( chunk == NULL ) {
+        die_with_error("Error:  Cannot allocate memory for sockets.");
+    }
+
+    // Chain the new sockets on the free list in index order
+    for ( i = 0; i < TRANSPORT_SOCKET_CHUNK; i++ ) {
+        chunk[i].handle    = INVALID_SOCKET;
+        chunk[i].status    = TRANSPORT_SOCKET_FREE;
+        chunk[i].next_free = num_sockets + i + 1;
+    }
+
+    chunk[TRANSPORT_SOCKET_CHUNK - 1].next_free = free_sockets;
+
+    socket_chunks[num_sockets / TRANSPORT_SOCKET_CHUNK] = chunk;
+
+    free_sockets = num_sockets;
+
+    __atomic_store_n( &num_sockets, num_sockets + TRANSPORT_SOCKET_CHUNK, __ATOMIC_RELEASE );
+}
 
 
 
@@ -22,20 +104,11 @@ wl_trans_socket  sockets[TRANSPORT_MAX_SOCKETS];  // Global structure of socket
 ******************************************************************************/
 
 void init_wl_mex_udp_transport( void ) {
-    int i;
 
     // Print initalization information
     // printf("Loaded wl_mex_udp_transport version %s \n", WL_MEX_UDP_TRANSPORT_VERSION );
 
-    // Initialize Socket datastructure
-    for ( i = 0; i < TRANSPORT_MAX_SOCKETS; i++ ) {
-        memset( &sockets[i], 0, sizeof(wl_trans_socket) );
-        
-        sockets[i].handle  = INVALID_SOCKET;
-        sockets[i].status  = TRANSPORT_SOCKET_FREE;
-        sockets[i].timeout = 0;
-        sockets[i].packet  = NULL;
-    }
+    // Socket datastructure grows on the first call to init_socket (see wl_registry_grow)
 
 #ifdef WIN32
     // Load the Winsock 2.0 DLL
@@ -56,38 +129,63 @@ void init_wl_mex_udp_transport( void ) {
 /**
 *  Function:  init_socket
 *
-*  Initializes a socket and returns the index in to the sockets array
+*  Initializes a socket and returns the index in to the socket registry.  All
+*  state of the socket (receive packet, batch storage, checksum, buffer 
+*  sizes) is allocated here, so sockets can be created from several threads 
+*  and each used by its own thread without locks.
 *
 ******************************************************************************/
 
 int init_socket( void ) {
     int i;
     
-    // Allocate a socket in the datastructure
-    for ( i = 0; i < TRANSPORT_MAX_SOCKETS; i++ ) {
-        if ( sockets[i].status == TRANSPORT_SOCKET_FREE ) {  break; }    
-    }
+    // Take the first socket of the free list (growing the registry if it is empty)
+    wl_registry_lock();
 
-    // Check to see if we cannot allocate a socket
-    if ( i == TRANSPORT_MAX_SOCKETS) {
-        die_with_error("Error:  Cannot allocate a socket");
+    if ( free_sockets == -1 ) {
+        wl_registry_grow();
     }
+
+    i            = free_sockets;
+    free_sockets = wl_socket( i )->next_free;
+
+    wl_socket( i )->status = TRANSPORT_SOCKET_IN_USE;
+
+    wl_registry_unlock();
         
     // Create a best-effort datagram socket using UDP
-    if ( ( sockets[i].handle = socket( PF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) < 0) {
+    if ( ( wl_socket( i )->handle = socket( PF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) < 0) {
         die_with_error("socket() failed");
     }
 
-    // Update the status field of the socket
-    sockets[i].status = TRANSPORT_SOCKET_IN_USE;
+    // Allocate the receive state of the socket
+    wl_socket( i )->packet = (wl_trans_data_pkt *) calloc( 1, sizeof(wl_trans_data_pkt) );
+
+    if ( wl_socket( i )->packet == NULL ) {
+        die_with_error("Error:  Cannot allocate memory for packet.");        
+    }
+
+    alloc_socket_batch( i );
+
+    wl_socket( i )->write_window   = TRANSPORT_WRITE_WINDOW_MAX;
+    wl_socket( i )->wait_phase     = TRANSPORT_WAIT_PHASE_NONE;
+    wl_socket( i )->spin_us        = TRANSPORT_WAIT_SPIN_US;
+    wl_socket( i )->pace_mode      = TRANSPORT_PACE_SPIN;
+    wl_socket( i )->pace_rate      = 0;
+    wl_socket( i )->tx_buffer_size = 0;
+    wl_socket( i )->rx_buffer_size = 0;
+    wl_socket( i )->checksum       = 0;
+
+    // Counters of a previous socket at this index are dropped (see warp_stats.c)
+    wl_stats_reset_socket( i );
     
     // Set the reuse_address and broadcast flags for all sockets
     set_reuse_address( i, 1 );
     set_broadcast( i, 1 );
     
     // Listen on the socket; Make sure we have a non-blocking socket
-    listen( sockets[i].handle, TRANSPORT_NUM_PENDING );
-    non_blocking_socket( sockets[i].handle );
+    listen( wl_socket( i )->handle, TRANSPORT_NUM_PENDING );
+    non_blocking_socket( wl_socket( i )->handle );
 
     return i;    
 }
@@ -97,12 +195,14 @@ int init_socket( void ) {
 /**
 *  Function:  set_so_timeout
 *
-*  Sets the Socket Timeout to the value (in ms)
+*  Sets the Socket Timeout to the value (in ms):  the upper bound of the 
+*  adaptive response timeouts on the socket (see wl_timeout_us);  0 for 
+*  WL_RTT_MAX_US
 *
 ******************************************************************************/
 void set_so_timeout( int index, int value ) {
 
-    sockets[index].timeout = value;
+    wl_socket( index )->timeout = value;
 }
 
 
@@ -118,10 +218,10 @@ void set_reuse_address( int index, int value ) {
 
     if ( value ) {
         optval = 1;
-        setsockopt( sockets[index].handle, SOL_SOCKET, SO_REUSEADDR, (const char *)&optval, sizeof(optval) );
+        setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_REUSEADDR, (const char *)&optval, sizeof(optval) );
     } else {
         optval = 0;
-        setsockopt( sockets[index].handle, SOL_SOCKET, SO_REUSEADDR, (const char *)&optval, sizeof(optval) );
+        setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_REUSEADDR, (const char *)&optval, sizeof(optval) );
     }    
 }
 
@@ -137,14 +237,329 @@ void set_broadcast( int index, int value ) {
 
     if ( value ) {
         optval = 1;
-        setsockopt( sockets[index].handle, SOL_SOCKET, SO_BROADCAST, (const char *)&optval, sizeof(optval) );
+        setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_BROADCAST, (const char *)&optval, sizeof(optval) );
     } else {
         optval = 0;
-        setsockopt( sockets[index].handle, SOL_SOCKET, SO_BROADCAST, (const char *)&optval, sizeof(optval) );
+        setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_BROADCAST, (const char *)&optval, sizeof(optval) );
     }    
 }
 
 
+/*****************************************************************************/
+/**
+*  Function:  set_receive_batch
+*
+*  Enables batched receives on the socket (see receive_socket_batch)
+*
+******************************************************************************/
+void set_receive_batch( int index, int value ) {
+
+    wl_socket( index )->batch_mode = ( value != 0 );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  set_wait_mode
+*
+*  Sets how the read / write IQ functions wait for responses on the socket:
+*      TRANSPORT_WAIT_SPIN   - Poll the non-blocking socket
+*      TRANSPORT_WAIT_EVENT  - Sleep until data arrives
+*      TRANSPORT_WAIT_HYBRID - Poll for the spin budget (see set_wait_spin), 
+*                              then sleep until data arrives
+*  In all modes responses time out on a wall-clock deadline (see wl_timeout_us)
+*
+******************************************************************************/
+void set_wait_mode( int index, int mode ) {
+
+    wl_socket( index )->wait_mode  = mode;
+    wl_socket( index )->wait_phase = TRANSPORT_WAIT_PHASE_NONE;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  set_wait_spin
+*
+*  Sets the spin budget (in us) of TRANSPORT_WAIT_HYBRID:  how long a wait 
+*  polls the socket before it sleeps.  If busy_poll_us is not 0, receives on 
+*  the socket also busy poll the device queue for up to busy_poll_us 
+*  (SO_BUSY_POLL, preferred over interrupts with SO_PREFER_BUSY_POLL where 
+*  supported), so packets are picked up without waiting for the interrupt.
+*
+*  NOTE:  Raising SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN;  
+*      the socket keeps spinning on its queue if it cannot be set.
+*
+******************************************************************************/
+void set_wait_spin( int index, int spin_us, int busy_poll_us ) {
+
+    wl_socket( index )->spin_us = ( spin_us > 0 ) ? spin_us : 0;
+
+    if ( busy_poll_us <= 0 ) {
+        return;
+    }
+
+#ifdef SO_BUSY_POLL
+    int                 optval = busy_poll_us;
+
+    if ( setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_BUSY_POLL, (const char *)&optval, sizeof(optval) ) != 0 ) {
+        printf("WARNING:  SO_BUSY_POLL could not be set on socket %d (%s). \n", index, strerror( errno ));
+        return;
+    }
+
+#ifdef SO_PREFER_BUSY_POLL
+    optval = 1;
+
+    setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_PREFER_BUSY_POLL, (const char *)&optval, sizeof(optval) );
+#endif
+#else
+    printf("WARNING:  SO_BUSY_POLL is not supported;  socket %d spins on its queue only. \n", index);
+#endif
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  set_receive_timestamps
+*
+*  Enables kernel receive timestamps (SO_TIMESTAMPNS) on the socket;  batched
+*  receives then keep the time each packet was received (see 
+*  get_receive_timestamp)
+*
+******************************************************************************/
+void set_receive_timestamps( int index, int value ) {
+
+#ifndef WIN32
+    int optval = ( value != 0 );
+
+    setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_TIMESTAMPNS, (const char *)&optval, sizeof(optval) );
+
+    wl_socket( index )->timestamps = optval;
+#endif
+}
+
+
+#ifndef WIN32
+/*****************************************************************************/
+/**
+*  Function:  wl_ring_filter
+*
+*  Attaches the BPF filter of the receive ring:  unfragmented UDP datagrams
+*  from the node ports (TRANSPORT_RING_PORT_MIN to TRANSPORT_RING_PORT_MAX) to 
+*  the local port of the UDP socket, which is bound first if it is not yet
+*
+*  Returns:  0 on success, -1 otherwise
+*
+******************************************************************************/
+static int wl_ring_filter( int index ) {
+
+    wl_trans_ring      *ring = wl_socket( index )->ring;
+    struct sockaddr_in  address;
+    socklen_t           address_size = sizeof(address);
+    struct sock_fprog   prog;
+
+    if ( getsockname( wl_socket( index )->handle, (struct sockaddr *) &address, &address_size ) != 0 ) {
+        return -1;
+    }
+
+    if ( address.sin_port == 0 ) {
+        wl_resolve_address( "0.0.0.0", 0, &address );
+
+        if ( ( bind( wl_socket( index )->handle, (struct sockaddr *) &address, sizeof(address) ) != 0 ) ||
+             ( getsockname( wl_socket( index )->handle, (struct sockaddr *) &address, &address_size ) != 0 ) ) {
+            return -1;
+        }
+    }
+
+    ring->port = address.sin_port;
+
+    // Offsets are from the IP header (SOCK_DGRAM packet socket)
+    struct sock_filter  code[] = {
+        BPF_STMT( BPF_LD  | BPF_B   | BPF_ABS, 9 ),                                    // IP protocol
+        BPF_JUMP( BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP, 0, 8 ),
+        BPF_STMT( BPF_LD  | BPF_H   | BPF_ABS, 6 ),                                    // Flags and fragment offset
+        BPF_JUMP( BPF_JMP | BPF_JSET | BPF_K,  0x3FFF, 6, 0 ),
+        BPF_STMT( BPF_LDX | BPF_B   | BPF_MSH, 0 ),                                    // IP header length
+        BPF_STMT( BPF_LD  | BPF_H   | BPF_IND, 0 ),                                    // UDP source port
+        BPF_JUMP( BPF_JMP | BPF_JGE | BPF_K,   TRANSPORT_RING_PORT_MIN, 0, 3 ),
+        BPF_JUMP( BPF_JMP | BPF_JGT | BPF_K,   TRANSPORT_RING_PORT_MAX, 2, 0 ),
+        BPF_STMT( BPF_LD  | BPF_H   | BPF_IND, 2 ),                                    // UDP destination port
+        BPF_JUMP( BPF_JMP | BPF_JEQ | BPF_K,   ntohs( ring->port ), 1, 0 ),
+        BPF_STMT( BPF_RET | BPF_K,             0 ),
+        BPF_STMT( BPF_RET | BPF_K,             0xFFFFFFFF ),
+    };
+
+    prog.len    = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+
+    return setsockopt( ring->handle, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog) );
+}
+#endif
+
+
+/*****************************************************************************/
+/**
+*  Function:  set_receive_ring
+*
+*  Receives the packets of the socket from a memory mapped AF_PACKET ring 
+*  (TPACKET_V3) of size bytes (0 for TRANSPORT_RING_SIZE) on interface ifname
+*  (NULL for all interfaces) instead of from the socket:  the kernel writes 
+*  the datagrams from the node ports to the local port of the socket straight
+*  in to the ring, and the transport parses their IP / UDP headers and hands 
+*  out pointers to the payloads in the ring (see receive_ring) without a 
+*  system call or copy per packet.  The UDP socket is filtered so that the 
+*  kernel does not queue a second copy of each datagram.
+*
+*  NOTE:  Needs CAP_NET_RAW.  The nodes never fragment their packets;  
+*      fragments do not reach the ring.  UDP checksums are not verified.
+*
+*  Returns:  0 on success, -1 if the ring could not be set up (the socket then
+*      keeps receiving from its own queue)
+*
+******************************************************************************/
+int set_receive_ring( int index, const char *ifname, int size ) {
+
+#ifdef WIN32
+    printf("WARNING:  Receive rings are not supported;  socket %d receives from its own queue. \n", index);
+    return -1;
+#else
+    wl_trans_ring      *ring;
+    struct tpacket_req3 req;
+    struct sockaddr_ll  address;
+    struct sock_filter  drop = BPF_STMT( BPF_RET | BPF_K, 0 );
+    struct sock_fprog   prog = { 1, &drop };
+    int                 optval;
+
+    free_receive_ring( index );
+
+    ring = (wl_trans_ring *) calloc( 1, sizeof(wl_trans_ring) );
+
+    if ( ring == NULL ) {
+        die_with_error("Error:  Cannot allocate memory for receive ring.");
+    }
+
+    ring->handle     = INVALID_SOCKET;
+    ring->map        = MAP_FAILED;
+    ring->block_size = TRANSPORT_RING_BLOCK_SIZE;
+    ring->num_blocks = ( ( size > 0 ) ? size : TRANSPORT_RING_SIZE ) / TRANSPORT_RING_BLOCK_SIZE;
+
+    if ( ring->num_blocks < 2 ) {
+        ring->num_blocks = 2;
+    }
+
+    wl_socket( index )->ring = ring;
+
+    // Ring of blocks of variable size frames
+    memset( &req, 0, sizeof(req) );
+    req.tp_block_size       = ring->block_size;
+    req.tp_block_nr         = ring->num_blocks;
+    req.tp_frame_size       = TPACKET_ALIGN( TRANSPORT_MAX_PKT_LENGTH + 256 );
+    req.tp_frame_size       = ring->block_size / ( ring->block_size / req.tp_frame_size );
+    req.tp_frame_size      &= ~( TPACKET_ALIGNMENT - 1 );
+    req.tp_frame_nr         = ( ring->block_size / req.tp_frame_size ) * ring->num_blocks;
+    req.tp_retire_blk_tov   = TRANSPORT_RING_BLOCK_TOV_MS;
+
+    optval = TPACKET_V3;
+
+    memset( &address, 0, sizeof(address) );
+    address.sll_family      = AF_PACKET;
+    address.sll_protocol    = htons( ETH_P_IP );
+    address.sll_ifindex     = ( ifname != NULL ) ? if_nametoindex( ifname ) : 0;
+
+    if ( ( ( ring->handle = socket( AF_PACKET, SOCK_DGRAM, htons( ETH_P_IP ) ) ) < 0 ) ||
+         ( setsockopt( ring->handle, SOL_PACKET, PACKET_VERSION, &optval, sizeof(optval) ) != 0 ) ||
+         ( wl_ring_filter( index ) != 0 ) ||
+         ( setsockopt( ring->handle, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req) ) != 0 ) ||
+         ( ( ring->map = (uint8 *) mmap( NULL, (size_t) ring->block_size * ring->num_blocks, PROT_READ | PROT_WRITE, 
+                                         MAP_SHARED, ring->handle, 0 ) ) == MAP_FAILED ) ||
+         ( ( ifname != NULL ) && ( address.sll_ifindex == 0 ) ) ||
+         ( bind( ring->handle, (struct sockaddr *) &address, sizeof(address) ) != 0 ) ) {
+
+        printf("WARNING:  Could not set up the receive ring of socket %d (%s);  it receives from its own queue. \n", 
+               index, strerror( errno ));
+
+        free_receive_ring( index );
+        return -1;
+    }
+
+    // Everything for the socket now arrives through the ring
+    setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog) );
+
+    return 0;
+#endif
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  free_receive_ring
+*
+*  Releases the receive ring of the socket (see set_receive_ring);  the 
+*  socket receives from its own queue again
+*
+******************************************************************************/
+void free_receive_ring( int index ) {
+
+#ifndef WIN32
+    wl_trans_ring      *ring = wl_socket( index )->ring;
+    int                 optval = 0;
+
+    if ( ring == NULL ) {
+        return;
+    }
+
+    if ( ring->map != MAP_FAILED ) {
+        munmap( ring->map, (size_t) ring->block_size * ring->num_blocks );
+    }
+
+    if ( ring->handle != INVALID_SOCKET ) {
+        close( ring->handle );
+    }
+
+    setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_DETACH_FILTER, &optval, sizeof(optval) );
+
+    free( ring );
+    wl_socket( index )->ring = NULL;
+#endif
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  set_write_pacing
+*
+*  Sets how Write IQ packets are paced on the socket (TRANSPORT_PACE_*) and
+*  the target rate in Mbps (0 to space the packets by the gap the node needs,
+*  see wl_pacer_gap_ns).  TRANSPORT_PACE_TXTIME falls back to 
+*  TRANSPORT_PACE_SPIN when the kernel does not support SO_TXTIME.
+*
+*  NOTE:  The kernel only holds SO_TXTIME packets until their departure time
+*      when the interface uses the fq (or etf) qdisc, eg:
+*          tc qdisc replace dev eth0 root fq
+*
+******************************************************************************/
+void set_write_pacing( int index, int mode, uint32 rate_mbps ) {
+
+    wl_socket( index )->pace_mode = TRANSPORT_PACE_SPIN;
+    wl_socket( index )->pace_rate = rate_mbps;
+
+    if ( mode == TRANSPORT_PACE_TXTIME ) {
+#ifdef SO_TXTIME
+        struct sock_txtime  txtime;
+
+        txtime.clockid = CLOCK_MONOTONIC;
+        txtime.flags   = 0;
+
+        if ( setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_TXTIME, (const char *)&txtime, sizeof(txtime) ) == 0 ) {
+            wl_socket( index )->pace_mode = TRANSPORT_PACE_TXTIME;
+            return;
+        }
+#endif
+        printf("WARNING:  SO_TXTIME is not supported on socket %d;  pacing Write IQ packets with the spin pacer. \n", index);
+    }
+}
+
+
 /*****************************************************************************/
 /**
 *  Function:  set_send_buffer_size
@@ -155,10 +570,10 @@ void set_broadcast( int index, int value ) {
 void set_send_buffer_size( int index, int size ) {
     int optval = size;
 
-    // Set the global variable to what we requested the transmit buffer size to be
-    tx_buffer_size = size;
+    // The OS may clamp the request, so the socket size is unknown until it is read back
+    wl_socket( index )->tx_buffer_size = 0;
 
-    setsockopt( sockets[index].handle, SOL_SOCKET, SO_SNDBUF, (const char *)&optval, sizeof(optval) );
+    setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_SNDBUF, (const char *)&optval, sizeof(optval) );
 }
 
 
@@ -174,7 +589,7 @@ int get_send_buffer_size( int index ) {
     int optlen = sizeof(int);
     int retval = 0;
     
-    if ( (retval = getsockopt( sockets[index].handle, SOL_SOCKET, SO_SNDBUF, (char *)&optval, (socklen_t *)&optlen )) != 0 ) {
+    if ( (retval = getsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_SNDBUF, (char *)&optval, (socklen_t *)&optlen )) != 0 ) {
         die_with_error("Error:  Could not get socket option - send buffer size"); 
     }
     
@@ -182,8 +597,8 @@ int get_send_buffer_size( int index ) {
     printf("Send Buffer Size:  %d \n", optval );
 #endif
     
-    // Set the global variable to what the OS reports that it is
-    tx_buffer_size = optval;
+    // Keep what the OS reports that it is
+    wl_socket( index )->tx_buffer_size = optval;
 
     return optval;
 }
@@ -199,10 +614,10 @@ int get_send_buffer_size( int index ) {
 void set_receive_buffer_size( int index, int size ) {
     int optval = size;
 
-    // Set the global variable to what we requested the receive buffer size to be
-    rx_buffer_size = size;
+    // The OS may clamp the request, so the socket size is unknown until it is read back
+    wl_socket( index )->rx_buffer_size = 0;
 
-    setsockopt( sockets[index].handle, SOL_SOCKET, SO_RCVBUF, (const char *)&optval, sizeof(optval) );
+    setsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_RCVBUF, (const char *)&optval, sizeof(optval) );
 }
 
 
@@ -218,7 +633,7 @@ int get_receive_buffer_size( int index ) {
     int optlen = sizeof(int);
     int retval = 0;
     
-    if ( (retval = getsockopt( sockets[index].handle, SOL_SOCKET, SO_RCVBUF, (char *)&optval, (socklen_t *)&optlen )) != 0 ) {
+    if ( (retval = getsockopt( wl_socket( index )->handle, SOL_SOCKET, SO_RCVBUF, (char *)&optval, (socklen_t *)&optlen )) != 0 ) {
         die_with_error("Error:  Could not get socket option - send buffer size"); 
     }
     
@@ -226,8 +641,8 @@ int get_receive_buffer_size( int index ) {
     printf("Rcvd Buffer Size:  %d \n", optval );
 #endif
     
-    // Set the global variable to what the OS reports that it is
-    rx_buffer_size = optval;
+    // Keep what the OS reports that it is
+    wl_socket( index )->rx_buffer_size = optval;
 
     return optval;
 }
@@ -246,679 +661,1825 @@ void close_socket( int index ) {
     printf("Close Socket: %d\n", index);
 #endif    
 
-    if ( sockets[index].handle != INVALID_SOCKET ) {
-        close( sockets[index].handle );
+    if ( ( index < 0 ) || ( index >= __atomic_load_n( &num_sockets, __ATOMIC_ACQUIRE ) ) ) {
+        printf( "WARNING:  Connection %d does not exist.\n", index );
+        return;
+    }
+
+    if ( wl_socket( index )->handle != INVALID_SOCKET ) {
+        free_receive_ring( index );
+
+        close( wl_socket( index )->handle );
         
-        if ( sockets[index].packet != NULL ) {
-            free( sockets[index].packet );
+        if ( wl_socket( index )->packet != NULL ) {
+            free( wl_socket( index )->packet );
+        }
+
+        if ( wl_socket( index )->batch != NULL ) {
+            free( wl_socket( index )->batch->buf );
+            free( wl_socket( index )->batch );
+        }
+
+        if ( wl_socket( index )->ctx != NULL ) {
+            free_socket_context( wl_socket( index )->ctx );
         }
     } else {
         printf( "WARNING:  Connection %d already closed.\n", index );
     }
 
-    sockets[index].handle  = INVALID_SOCKET;
-    sockets[index].status  = TRANSPORT_SOCKET_FREE;
-    sockets[index].timeout = 0;
-    sockets[index].packet  = NULL;
+    wl_socket( index )->handle  = INVALID_SOCKET;
+    wl_socket( index )->timeout = 0;
+    wl_socket( index )->packet  = NULL;
+    wl_socket( index )->batch_mode = 0;
+    wl_socket( index )->batch   = NULL;
+    wl_socket( index )->wait_mode = TRANSPORT_WAIT_SPIN;
+    wl_socket( index )->timestamps = 0;
+    wl_socket( index )->connected = 0;
+    wl_socket( index )->sent    = 0;
+    wl_socket( index )->ctx     = NULL;
+
+    // Put the socket back on the free list last, so init_socket never takes it half reset
+    wl_registry_lock();
+
+    if ( wl_socket( index )->status == TRANSPORT_SOCKET_IN_USE ) {
+        wl_socket( index )->status    = TRANSPORT_SOCKET_FREE;
+        wl_socket( index )->next_free = free_sockets;
+        free_sockets                  = index;
+    }
+
+    wl_registry_unlock();
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  send_socket
+*  Function:  wl_aligned_alloc
 *
-*  Sends the buffer to the IP address / Port that is passed in
+*  Allocates a TRANSPORT_BUFFER_ALIGN aligned buffer; dies on failure
 *
 ******************************************************************************/
-int send_socket( int index, char *buffer, int length, char *ip_addr, int port ) {
-
-    struct sockaddr_in socket_addr;  // Socket address
-    int                length_sent;
-    int                size;
+void * wl_aligned_alloc( size_t size ) {
+    void *ptr = NULL;
 
-    // Construct the address structure
-    memset( &socket_addr, 0, sizeof(socket_addr) );        // Zero out structure 
-    socket_addr.sin_family      = AF_INET;                 // Internet address family
-    socket_addr.sin_addr.s_addr = inet_addr(ip_addr);      // IP address 
-    socket_addr.sin_port        = htons(port);             // Port 
+#ifdef WIN32
+    ptr = _aligned_malloc( size, TRANSPORT_BUFFER_ALIGN );
+#else
+    if ( posix_memalign( &ptr, TRANSPORT_BUFFER_ALIGN, size ) != 0 ) {
+        ptr = NULL;
+    }
+#endif
 
-    // If we are sending a large amount of data, we need to make sure the entire 
-    // buffer has been sent.
-    
-    length_sent = 0;
-    size        = 0xFFFF;
-    
-    if ( sockets[index].status != TRANSPORT_SOCKET_IN_USE ) {
-        return length_sent;
+    if ( ptr == NULL ) {
+        die_with_error("Error:  Cannot allocate aligned buffer.");
     }
 
-    while ( length_sent < length ) {
-    
-        // If we did not send more than MIN_SEND_SIZE, then wait a bit
-        if ( size < TRANSPORT_MIN_SEND_SIZE ) {
-            usleep( TRANSPORT_SLEEP_TIME );
-        }
+    return ptr;
+}
 
-        // Send as much data as possible to the address
-        size = sendto( sockets[index].handle, &buffer[length_sent], (length - length_sent), 0, 
-                      (struct sockaddr *) &socket_addr, sizeof(socket_addr) );
 
-        // Check the return value    
-        if ( size == SOCKET_ERROR )  {
-            if ( get_last_error != EWOULDBLOCK ) {
-                die_with_error("Error:  Socket Error.");
-            } else {
-                // If the socket is not ready, then we did not send any bytes
-                length_sent += 0;
-            }
-        } else {
-            // Update how many bytes we sent
-            length_sent += size;        
-        }
+/*****************************************************************************/
+/**
+*  Function:  wl_aligned_free
+*
+*  Frees a buffer allocated with wl_aligned_alloc
+*
+******************************************************************************/
+void wl_aligned_free( void *ptr ) {
 
-        // TODO:  IMPLEMENT A TIMEOUT SO WE DONT GET STUCK HERE FOREVER
-        //        FOR WARPLab 7.3.0, this is not implemented and has not 
-        //        been an issue during testing.
-    }
-    
-    return length_sent;
+#ifdef WIN32
+    _aligned_free( ptr );
+#else
+    free( ptr );
+#endif
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  receive_socket
+*  Function:  init_socket_context
 *
-*  Reads data from the socket; will return 0 if no data is available
+*  Creates the transfer context of the socket:  all packet, tracker and sample
+*  staging buffers used by the Read / Write IQ functions, sized for transfers 
+*  of up to max_samples samples, so that none of it happens on the first 
+*  transfer.
 *
 ******************************************************************************/
-int receive_socket( int index, int length, char * buffer ) {
+void init_socket_context( int index, int max_samples ) {
 
-    wl_trans_data_pkt  *pkt;           
-    int                 size;
-    int                 socket_addr_size = sizeof(struct sockaddr_in);
-    
-    // Allocate a packet in memory if necessary
-    if ( sockets[index].packet == NULL ) {
-        sockets[index].packet = (wl_trans_data_pkt *) malloc( sizeof(wl_trans_data_pkt) );
-        
-	  // only required is matlab as the memory in it is non persistent
-      //  make_persistent( sockets[index].packet );
+    wl_trans_ctx *ctx;
 
-        if ( sockets[index].packet == NULL ) {
-            die_with_error("Error:  Cannot allocate memory for packet.");        
-        }
+    if ( wl_socket( index )->ctx != NULL ) {
+        if ( wl_socket( index )->ctx->max_samples >= max_samples ) { return; }
 
-        memset( sockets[index].packet, 0, sizeof(wl_trans_data_pkt));        
+        free_socket_context( wl_socket( index )->ctx );
+        wl_socket( index )->ctx = NULL;
     }
 
-    // Get the packet associcated with the index
-    pkt = sockets[index].packet;
+    ctx = (wl_trans_ctx *) calloc( 1, sizeof( wl_trans_ctx ) );
+    if ( ctx == NULL ) { die_with_error("Error:  Cannot allocate transfer context."); }
 
-    // If we have a packet from the last recevie call, then zero out the address structure    
-    if ( pkt->length != 0 ) {
-        memset( &(pkt->address), 0, sizeof(socket_addr_size));
-    }
+    ctx->max_samples  = max_samples;
+    ctx->rcvd_buffer  = (char   *) wl_aligned_alloc( TRANSPORT_MAX_PKT_LENGTH );
+    ctx->samples_iq   = (uint32 *) wl_aligned_alloc( sizeof( uint32 ) * max_samples );
+    ctx->write_hdrs   = (char   *) wl_aligned_alloc( TRANSPORT_MAX_SEND_BATCH * TRANSPORT_MAX_HDR_LENGTH );
+    ctx->write_payload = (uint8 *) wl_aligned_alloc( sizeof( uint32 ) * max_samples );
 
-    // Receive a response 
-    size = recvfrom( sockets[index].handle, buffer, length, 0, 
-                    (struct sockaddr *) &(pkt->address), (socklen_t *) &socket_addr_size );
-
-
-    // Check on error conditions
-    if ( size == SOCKET_ERROR )  {
-        if ( get_last_error != EWOULDBLOCK ) {
-            die_with_error("Error:  Socket Error.");
-        } else {
-            // If the socket is not ready, then just return a size of 0 so the function can be 
-            // called again
-            size = 0;
-        }
-    } else {
-                    
-        // Update the packet associated with the socket
-        //   NOTE:  pkt.address was updated via the function call
-        // printf("index = %d, received size = %d\n", index, size);
-        pkt->buf     = buffer;
-        pkt->offset  = 0;
-    }
-
-    // Update the packet length so we can determine when we need to zero out pkt.address
-    pkt->length  = size;
-
-    return size;
+    wl_socket( index )->ctx = ctx;
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  cleanup
+*  Function:  get_socket_context
 *
-*  Function called by atMexExit to close everything
+*  Returns the transfer context of the socket (created on first use if 
+*  init_socket_context was not called)
 *
 ******************************************************************************/
-void cleanup( void ) {
-    int i;
-
-    // printf("MEX-file is terminating\n");
+wl_trans_ctx * get_socket_context( int index ) {
 
-    // Close all sockets
-    for ( i = 0; i < TRANSPORT_MAX_SOCKETS; i++ ) {
-        if ( sockets[i].handle != INVALID_SOCKET ) {  close_socket( i ); }    
+    if ( wl_socket( index )->ctx == NULL ) {
+        init_socket_context( index, TRANSPORT_MAX_SAMPLES );
     }
 
-#ifdef WIN32
-    WSACleanup();  // Cleanup Winsock 
-#endif
-
+    return wl_socket( index )->ctx;
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  print_version
+*  Function:  reserve_socket_context
 *
-* This function will print the version of the wl_mex_udp_transport driver
+*  Grows the readSamplesMulti() staging of the context to hold at least 
+*  num_states transfers.  Memory is only allocated when a request is larger 
+*  than any request before it.
 *
 ******************************************************************************/
-void print_version( ) {
+static void reserve_socket_context( wl_trans_ctx *ctx, int num_states ) {
 
-    printf("WARPLab MEX UDP Transport v%s (compiled %s %s)\n", WL_MEX_UDP_TRANSPORT_VERSION, __DATE__, __TIME__);
-    printf("Copyright 2013, Mango Communications. All rights reserved.\n");
-    printf("Distributed under the WARP license:  http://warpproject.org/license  \n");
+    if ( num_states > ctx->max_states ) {
+        wl_aligned_free( ctx->states );
+        ctx->states     = (wl_read_state *) wl_aligned_alloc( sizeof( wl_read_state ) * num_states );
+        ctx->max_states = num_states;
+    }
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  print_usage
+*  Function:  free_socket_context
 *
-* This function will print the usage of the wl_mex_udp_transport driver
+*  Frees a transfer context
 *
 ******************************************************************************/
-void print_usage( ) {
-
-    printf("Usage:  WARPLab MEX Transport v%s \n", WL_MEX_UDP_TRANSPORT_VERSION );
-    printf("Standard WARPLab transport functions: \n");
-    printf("    1.                  wl_mex_udp_transport('version') \n");
-    printf("    2. index          = wl_mex_udp_transport('init_socket') \n");
-    printf("    3.                  wl_mex_udp_transport('set_so_timeout', index, timeout) \n");
-    printf("    4.                  wl_mex_udp_transport('set_send_buf_size', index, size) \n");
-    printf("    5. size           = wl_mex_udp_transport('get_send_buf_size', index) \n");
-    printf("    6.                  wl_mex_udp_transport('set_rcvd_buf_size', index, size) \n");
-    printf("    7. size           = wl_mex_udp_transport('get_rcvd_buf_size', index) \n");
-    printf("    8.                  wl_mex_udp_transport('close', index) \n");
-    printf("    9. size           = wl_mex_udp_transport('send', index, buffer, length, ip_addr, port) \n");
-    printf("   10. [size, buffer] = wl_mex_udp_transport('receive', index, length ) \n");
-    printf("\n");
-    printf("Additional WARPLab MEX UDP transport functions: \n");
-    printf("    1. [num_samples, cmds_used, samples]  = wl_mex_udp_transport('read_rssi' / 'read_iq', \n");
-    printf("                                                index, buffer, length, ip_addr, port, \n");
-    printf("                                                number_samples, buffer_id, start_sample) \n");
-    printf("    2. cmds_used                          = wl_mex_udp_transport('write_iq', \n");
-    printf("                                                index, cmd_buffer, max_length, ip_addr, port, \n");
-    printf("                                                number_samples, sample_buffer, buffer_id, \n");
-    printf("                                                start_sample, num_pkts, max_samples, hw_ver) \n");
-    printf("\n");
-    printf("See documentation for further details.\n");
-    printf("\n");
+void free_socket_context( wl_trans_ctx *ctx ) {
+
+    wl_aligned_free( ctx->rcvd_buffer );
+    wl_aligned_free( ctx->samples_iq );
+    wl_aligned_free( ctx->write_hdrs );
+    wl_aligned_free( ctx->write_payload );
+    wl_aligned_free( ctx->states );
+    free( ctx );
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  die
+*  Function:  wl_resolve_address
 *
-*  Generates an error message and cause the program to halt
+*  Fills in the socket address of the IP address / Port
 *
 ******************************************************************************/
-void die( ) {
-    //mexErrMsgTxt("Error:  See description above.");
-    printf("Error:  See description above.");
-	cleanup();
-	exit(0);
+void wl_resolve_address( char *ip_addr, int port, struct sockaddr_in *address ) {
+
+    memset( address, 0, sizeof(struct sockaddr_in) );      // Zero out structure 
+    address->sin_family      = AF_INET;                    // Internet address family
+    address->sin_addr.s_addr = inet_addr(ip_addr);         // IP address 
+    address->sin_port        = htons(port);                // Port 
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  die_with_error
+*  Function:  connect_socket
 *
-* This function will error out of the wl_mex_udp_transport function call
+*  Connects the socket to the node at the IP address / Port:  packets to the 
+*  node are sent without handing its address to the kernel, and datagrams 
+*  from any other address are dropped by the kernel.
+*
+*  NOTE:  A connected socket that is used to exchange packets with another 
+*      address is disconnected (see wl_socket_target) and stays so.
 *
 ******************************************************************************/
-void die_with_error(char *errorMessage) {
-    printf("%s \n   Socket Error Code: %d\n", errorMessage, get_last_error );
-    die();
-}
+void connect_socket( int index, char *ip_addr, int port ) {
 
+    struct sockaddr_in address;
 
+    wl_resolve_address( ip_addr, port, &address );
 
-/*****************************************************************************/
-/**
-*  Function:  print_sockets
-*
-*  Debug function to print socket table
-*
-******************************************************************************/
-void print_sockets( void ) {
-    int i;
-    
-    printf("Sockets: \n");    
-    
-    for ( i = 0; i < TRANSPORT_MAX_SOCKETS; i++ ) {
-        printf("    socket[%d]:  handle = 0x%4x,   timeout = 0x%4x,  status = 0x%4x", 
-               i, sockets[i].handle, sockets[i].timeout, sockets[i].status);
+    if ( connect( wl_socket( index )->handle, (struct sockaddr *) &address, sizeof(address) ) != 0 ) {
+        printf("WARNING:  Could not connect socket %d to %s:%d;  addressing every packet instead. \n", index, ip_addr, port);
+        return;
     }
 
-    printf("\n");
+    wl_socket( index )->peer      = address;
+    wl_socket( index )->connected = 1;
 }
 
 
-#ifdef _DEBUG_
 /*****************************************************************************/
 /**
-*  Function:  print_buffer
+*  Function:  connect_socket_once
 *
-*  Debug function to print a buffer
+*  Connects the socket to the node at the IP address / Port (see 
+*  connect_socket) if nothing was sent on the socket yet;  a socket that 
+*  already talked to any address is left as is, so it is never disconnected 
+*  and connected again (which may lose responses, see disconnect_socket).
+*
+*  Returns:  1 if the socket is connected to the node, 0 otherwise
 *
 ******************************************************************************/
-void print_buffer(unsigned char *buf, int size) {
-	int i;
+int connect_socket_once( int index, char *ip_addr, int port ) {
 
-	printf("Buffer: (0x%x bytes)\n", size);
+    struct sockaddr_in address;
 
-	for (i=0; i<size; i++) {
-        printf("%2x ", buf[i] );
-        if ( (((i + 1) % 16) == 0) && ((i + 1) != size) ) {
-            printf("\n");
-        }
-	}
-	printf("\n\n");
+    if ( !wl_socket( index )->connected && !wl_socket( index )->sent ) {
+        connect_socket( index, ip_addr, port );
+    }
+
+    if ( !wl_socket( index )->connected ) {
+        return 0;
+    }
+
+    wl_resolve_address( ip_addr, port, &address );
+
+    return ( ( wl_socket( index )->peer.sin_addr.s_addr == address.sin_addr.s_addr ) && 
+             ( wl_socket( index )->peer.sin_port        == address.sin_port        ) );
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  print_buffer_16
+*  Function:  disconnect_socket
 *
-*  Debug function to print a buffer
+*  Dissolves the association of a connected socket (see connect_socket);  the
+*  socket then exchanges packets with any address
+*
+*  NOTE:  The kernel releases the local port of the socket, which is bound 
+*      again right away;  if another socket took the port in between, 
+*      responses to the old port are lost.
 *
 ******************************************************************************/
-void print_buffer_16(uint16 *buf, int size) {
-	int i;
+void disconnect_socket( int index ) {
 
-	printf("Buffer: (0x%x bytes)\n", (2*size));
+    struct sockaddr    address;
+    struct sockaddr_in local;
+    socklen_t          local_size = sizeof(local);
 
-	for (i=0; i<size; i++) {
-        printf("%4x ", buf[i] );
-        if ( (((i + 1) % 16) == 0) && ((i + 1) != size) ) {
-            printf("\n");
+    if ( !wl_socket( index )->connected ) {
+        return;
+    }
+
+    memset( &local, 0, sizeof(local) );
+    getsockname( wl_socket( index )->handle, (struct sockaddr *) &local, &local_size );
+
+    memset( &address, 0, sizeof(address) );
+    address.sa_family = AF_UNSPEC;
+
+    connect( wl_socket( index )->handle, &address, sizeof(address) );
+
+    wl_socket( index )->connected = 0;
+
+    // Keep the local port
+    local.sin_addr.s_addr = htonl( INADDR_ANY );
+
+    if ( bind( wl_socket( index )->handle, (struct sockaddr *) &local, sizeof(local) ) != 0 ) {
+        printf("WARNING:  Socket %d could not keep its local port %d after disconnecting. \n", index, ntohs( local.sin_port ));
+
+#ifndef WIN32
+        if ( wl_socket( index )->ring != NULL ) {
+            wl_ring_filter( index );
         }
-	}
-	printf("\n\n");
+#endif
+    }
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  print_buffer_32
+*  Function:  wl_socket_target
 *
-*  Debug function to print a buffer
+*  Returns the address to hand to the kernel to send a packet to address on 
+*  the socket:  NULL if the socket is connected to it.  A socket connected 
+*  to another node is disconnected, so the responses are not dropped.
 *
 ******************************************************************************/
-void print_buffer_32(uint32 *buf, int size) {
-	int i;
+const struct sockaddr_in * wl_socket_target( int index, const struct sockaddr_in *address ) {
 
-	printf("Buffer: (0x%x bytes)\n", (4*size));
+    wl_socket( index )->sent = 1;
 
-	for (i=0; i<size; i++) {
-        printf("%8x ", buf[i] );
-        if ( (((i + 1) % 8) == 0) && ((i + 1) != size) ) {
-            printf("\n");
+    if ( wl_socket( index )->connected ) {
+        if ( ( wl_socket( index )->peer.sin_addr.s_addr == address->sin_addr.s_addr ) && 
+             ( wl_socket( index )->peer.sin_port        == address->sin_port        ) ) {
+            return NULL;
         }
-	}
-	printf("\n\n");
-}
 
-#endif
+        disconnect_socket( index );
+    }
+
+    return address;
+}
 
 
 /*****************************************************************************/
 /**
-*  Function:  endian_swap_16
+*  Function:  send_socket
 *
-* This function will perform an byte endian swap on a 16-bit value 
+*  Sends the buffer to the IP address / Port that is passed in
 *
 ******************************************************************************/
-uint16 endian_swap_16(uint16 value) {
+int send_socket( int index, char *buffer, int length, char *ip_addr, int port ) {
 
-	return (((value & 0xFF00) >> 8) | ((value & 0x00FF) << 8));
+    struct sockaddr_in socket_addr;  // Socket address
+
+    wl_resolve_address( ip_addr, port, &socket_addr );
+
+    return send_socket_to( index, buffer, length, &socket_addr );
 }
 
 
 /*****************************************************************************/
 /**
-*  Function:  endian_swap_32
+*  Function:  send_socket_to
 *
-* This function will perform an byte endian swap on a 32-bit value 
+*  Sends the buffer to the socket address that is passed in (see 
+*  wl_resolve_address);  with send() if the socket is connected to it
 *
 ******************************************************************************/
-uint32 endian_swap_32(uint32 value) {
-	uint16 lo;
-	uint16 hi;
-
-	// get each of the half words from the 32 bit word
-	lo = (uint16) (value & 0x0000FFFF);
-	hi = (uint16) ((value & 0xFFFF0000) >> 16);
-
-	// byte swap each of the 16 bit half words
-	lo = (((lo & 0xFF00) >> 8) | ((lo & 0x00FF) << 8));
-	hi = (((hi & 0xFF00) >> 8) | ((hi & 0x00FF) << 8));
+int send_socket_to( int index, char *buffer, int length, const struct sockaddr_in *address ) {
 
-	// swap the half words before returning the value
-	return (uint32) ((lo << 16) | hi);
-}
+    const struct sockaddr_in *target;
+    int                length_sent;
+    int                size;
 
+    target = wl_socket_target( index, address );
 
+    // If we are sending a large amount of data, we need to make sure the entire 
+    // buffer has been sent.
+    
+    length_sent = 0;
+    size        = 0xFFFF;
+    
+    if ( wl_socket( index )->status != TRANSPORT_SOCKET_IN_USE ) {
+        return length_sent;
+    }
 
-//------------------------------------------------------
-        // size = wl_mex_udp_transport('send', handle, buffer, length, ip_addr, port)
-        //   - Arguments:
-        //     - handle (int)     - index to the requested socket
-        //     - buffer (char *)  - Buffer of data to be sent
-        //     - length (int)     - Length of data to be sent
-        //     - ip_addr          - IP Address to send data to
-        //     - port             - Port to send data to
-        //   - Returns:
-        //     - size (int)       - size of data sent (in bytes)
+    while ( length_sent < length ) {
+    
+        // If we did not send more than MIN_SEND_SIZE, then wait for room in the send buffer
+        if ( size < TRANSPORT_MIN_SEND_SIZE ) {
+#ifdef WIN32
+            usleep( TRANSPORT_SLEEP_TIME );
+#else
+            struct pollfd       pfd;
 
-int sendData(int handle, char* buffer, int length, char* ip_addr, int port){
+            pfd.fd      = wl_socket( index )->handle;
+            pfd.events  = POLLOUT;
+            pfd.revents = 0;
 
-#ifdef _DEBUG_
-            printf("Function : TRANSPORT_SEND\n");
+            poll( &pfd, 1, TRANSPORT_SLEEP_TIME / 1000 );
 #endif
-            
+        }
 
-#ifdef _DEBUG_
-            printf("index = %d, length = %d, port = %d, ip_addr = %s \n", handle, length, port, ip_addr);
-#endif
-                       
-            // Call function
-            int size = 0;
-			size = send_socket( handle, buffer, length, ip_addr, port );
-            //free (ip_addr);
+        // Send as much data as possible to the address
+        if ( target == NULL ) {
+            size = send( wl_socket( index )->handle, &buffer[length_sent], (length - length_sent), 0 );
+        } else {
+            size = sendto( wl_socket( index )->handle, &buffer[length_sent], (length - length_sent), 0, 
+                          (struct sockaddr *) target, sizeof(struct sockaddr_in) );
+        }
 
+        // Check the return value    
+        if ( size == SOCKET_ERROR )  {
+            if ( get_last_error != EWOULDBLOCK ) {
+                die_with_error("Error:  Socket Error.");
+            } else {
+                // If the socket is not ready, then we did not send any bytes
+                length_sent += 0;
+            }
+        } else {
+            // Update how many bytes we sent
+            length_sent += size;        
+        }
 
-#ifdef _DEBUG_
-            print_buffer( buffer, length );
-            printf("END TRANSPORT_SEND \n");
-#endif
+        // TODO:  IMPLEMENT A TIMEOUT SO WE DONT GET STUCK HERE FOREVER
+        //        FOR WARPLab 7.3.0, this is not implemented and has not 
+        //        been an issue during testing.
+    }
 
-			return size;
+    WL_STATS_ADD( index, address->sin_addr.s_addr, pkts_sent, 1 );
+    WL_STATS_ADD( index, address->sin_addr.s_addr, bytes_sent, length_sent );
+    
+    return length_sent;
 }
 
 
-//------------------------------------------------------
-        // [size, buffer] = wl_mex_udp_transport('receive', handle, length )
-        //   - Arguments:
-        //     - handle (int)     - index to the requested socket
-        //     - length (int)     - length of data to be received (in bytes)
-        //     - buffer (char *)  - Buffer of data received
-		//   - Returns:
-		//       size 
+/*****************************************************************************/
+/**
+*  Function:  send_socket_gather
+*
+*  Sends packets to the socket address that is passed in;  the headers and 
+*  the payload of each packet are gathered from separate buffers and up to 
+*  TRANSPORT_MAX_SEND_BATCH packets are handed to the kernel with a single 
+*  sendmmsg() call.  On a socket paced with SO_TXTIME (see set_write_pacing)
+*  each packet leaves the host at its txtime_ns.
+*
+*  Returns:  Number of bytes sent
+*
+******************************************************************************/
+int send_socket_gather( int index, wl_trans_sg_pkt *pkts, int num_pkts, const struct sockaddr_in *address ) {
 
+    int                 length_sent = 0;
+    int                 i;
 
-int receiveData(char* buffer, int handle, int length){
+    if ( wl_socket( index )->status != TRANSPORT_SOCKET_IN_USE ) {
+        return length_sent;
+    }
 
-                        
-#ifdef _DEBUG_
-            printf("Function : TRANSPORT_RECEIVE\n");
-#endif
+#ifdef WIN32
+    // No sendmmsg() on this platform;  copy each packet in to one buffer
+    char                buffer[TRANSPORT_MAX_PKT_LENGTH];
 
+    for ( i = 0; i < num_pkts; i++ ) {
+        memcpy( buffer, pkts[i].hdr, pkts[i].hdr_length );
+        memcpy( buffer + pkts[i].hdr_length, pkts[i].payload, pkts[i].payload_length );
 
-#ifdef _DEBUG_
-            printf("index = %d, length = %d \n", handle, length );
+        length_sent += send_socket_to( index, buffer, pkts[i].hdr_length + pkts[i].payload_length, address );
+    }
+#else
+    const struct sockaddr_in *target = wl_socket_target( index, address );
+    struct mmsghdr      msgs[TRANSPORT_MAX_SEND_BATCH];
+    struct iovec        iovs[2 * TRANSPORT_MAX_SEND_BATCH];
+    char                control[TRANSPORT_MAX_SEND_BATCH][CMSG_SPACE( sizeof( uint64_t ) )];
+    struct cmsghdr     *cmsg;
+    struct pollfd       pfd;
+    int                 num_msgs;
+    int                 next;
+    int                 size;
+
+    while ( num_pkts > 0 ) {
+
+        num_msgs = ( num_pkts < TRANSPORT_MAX_SEND_BATCH ) ? num_pkts : TRANSPORT_MAX_SEND_BATCH;
+
+        memset( msgs, 0, sizeof( struct mmsghdr ) * num_msgs );
+
+        for ( i = 0; i < num_msgs; i++ ) {
+            iovs[2 * i].iov_base           = pkts[i].hdr;
+            iovs[2 * i].iov_len            = pkts[i].hdr_length;
+            iovs[2 * i + 1].iov_base       = pkts[i].payload;
+            iovs[2 * i + 1].iov_len        = pkts[i].payload_length;
+            msgs[i].msg_hdr.msg_iov        = &iovs[2 * i];
+            msgs[i].msg_hdr.msg_iovlen     = ( pkts[i].payload_length > 0 ) ? 2 : 1;
+            msgs[i].msg_hdr.msg_name       = (void *) target;
+            msgs[i].msg_hdr.msg_namelen    = ( target == NULL ) ? 0 : sizeof( struct sockaddr_in );
+
+#ifdef SO_TXTIME
+            if ( wl_socket( index )->pace_mode == TRANSPORT_PACE_TXTIME ) {
+                memset( control[i], 0, sizeof( control[i] ) );
+                msgs[i].msg_hdr.msg_control    = control[i];
+                msgs[i].msg_hdr.msg_controllen = sizeof( control[i] );
+
+                cmsg             = CMSG_FIRSTHDR( &(msgs[i].msg_hdr) );
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type  = SCM_TXTIME;
+                cmsg->cmsg_len   = CMSG_LEN( sizeof( uint64_t ) );
+                memcpy( CMSG_DATA( cmsg ), &(pkts[i].txtime_ns), sizeof( uint64_t ) );
+            }
 #endif
+        }
 
-            // Allocate memory for the buffer
-            int i;
-			if( buffer == NULL ) { printf("Error: Did not receive a valid buffer"); die();}
-            for ( i = 0; i < length; i++ ) { buffer[i] = 0; }
+        // Send the packets;  if the send buffer is full, wait for room
+        for ( next = 0; next < num_msgs; ) {
 
-            // Call function
-            int size = 0;
-			size = receive_socket( handle, length, buffer );                       
+            size = sendmmsg( wl_socket( index )->handle, &msgs[next], num_msgs - next, 0 );
 
-            
-#ifdef _DEBUG_
-            if ( size != 0 ) {
-                printf("Buffer size = %d \n", size);
-                print_buffer( (char *) buffer, size );
+            if ( size == SOCKET_ERROR ) {
+                if ( ( get_last_error != EWOULDBLOCK ) && ( get_last_error != EAGAIN ) ) {
+                    die_with_error("Error:  Socket Error.");
+                }
+
+                pfd.fd      = wl_socket( index )->handle;
+                pfd.events  = POLLOUT;
+                pfd.revents = 0;
+
+                poll( &pfd, 1, TRANSPORT_SLEEP_TIME / 1000 );
+            } else {
+                for ( i = next; i < ( next + size ); i++ ) {
+                    length_sent += msgs[i].msg_len;
+                }
+                next += size;
             }
-            printf("END TRANSPORT_RECEIVE \n");
+        }
+
+        WL_STATS_ADD( index, address->sin_addr.s_addr, pkts_sent, num_msgs );
+
+        pkts     += num_msgs;
+        num_pkts -= num_msgs;
+    }
+
+    WL_STATS_ADD( index, address->sin_addr.s_addr, bytes_sent, length_sent );
 #endif
 
-			return size;
+    return length_sent;
 }
 
 
-//------------------------------------------------------
-        //[num_samples, cmds_used, samples]  = wl_mex_udp_transport('read_rssi' / 'read_iq', 
-        //                                        handle, buffer, length, ip_addr, port,
-        //                                        number_samples, buffer_id, start_sample);
-        //   - Arguments:
-        //     - samples      (double *)    - Array of samples received		  
-        //     - handle       (int)         - index to the requested socket
-        //     - buffer       (char *)      - Buffer of data to be sent
-        //     - length       (int)         - Length of data to be sent
-        //     - ip_addr      (char *)      - IP Address to send data to
-        //     - port         (int)         - Port to send data to
-        //     - num_samples  (int)         - Number of samples requested
-        //     - buffer_id    (int)         - WARP RF buffer to obtain samples from
-        //     - start_sample (int)         - Starting address in the array for the samples
-		//     -max_length	(int)
-		//     -num_pkts	(int)
-        //   - Returns:
-        //     - num_samples  (int)         - Number of samples received
-        //     ?? cmds_used    (int)         - Number of transport commands used to obtain samples
+/*****************************************************************************/
+/**
+*  Function:  wl_wait_done
+*
+*  Called when a receive on the socket returns a packet (from the node at 
+*  address);  ends the wait in progress and counts the phase it ended in
+*  (see wl_timer_wait)
+*
+******************************************************************************/
+static void wl_wait_done( int index, uint32 address ) {
 
+    if ( wl_socket( index )->wait_phase == TRANSPORT_WAIT_PHASE_SPIN ) {
+        WL_STATS_ADD( index, address, wait_spin, 1 );
+    } else if ( wl_socket( index )->wait_phase == TRANSPORT_WAIT_PHASE_BLOCK ) {
+        WL_STATS_ADD( index, address, wait_block, 1 );
+    }
 
-int readSamples(double complex* samples, int handle, char* buffer, int length, char* ip_addr, int port, int num_samples, uint32 buffer_id, int start_sample, int max_length, int num_pkts){
+    wl_socket( index )->wait_phase = TRANSPORT_WAIT_PHASE_NONE;
+}
 
-#ifdef _DEBUG_
-            printf("Function : TRANSPORT_READ_IQ \ TRANSPORT_READ_RSSI\n");
-#endif
-        
-            int i;
 
-    int     max_samples             = 0;
-    uint32  num_cmds                = 0;
-    uint32  start_sample_to_request = 0;
-    uint32  num_samples_to_request  = 0;
-    uint32  num_pkts_to_request     = 0;
-    double  temp_I_val                = 0.0;
-    double  temp_Q_val                = 0.0;
-    uint32 *output_array            = NULL;
-    uint32 *command_args            = NULL;			
-	int size = 0;
+/*****************************************************************************/
+/**
+*  Function:  receive_socket
+*
+*  Reads data from the socket; will return 0 if no data is available
+*
+******************************************************************************/
+int receive_socket( int index, int length, char * buffer ) {
 
-			if( buffer == NULL ) { printf("Error: Did not receive a valid buffer"); die();}
+    wl_trans_data_pkt  *pkt;           
+    int                 size;
+    int                 socket_addr_size = sizeof(struct sockaddr_in);
+    char               *data;
+    
+    // Get the packet associcated with the index (allocated by init_socket)
+    pkt = wl_socket( index )->packet;
 
-            if( samples == NULL ) { printf("Error: Did not receive a valid samples buffer"); die();}
-            
-            //for ( i = 0; i < num_samples; i++ ) { samples[i] = 0; }
+    // If we have a packet from the last recevie call, then zero out the address structure    
+    if ( pkt->length != 0 ) {
+        memset( &(pkt->address), 0, sizeof(socket_addr_size));
+    }
 
+    // Copy the response out of the receive ring (see set_receive_ring)
+    if ( wl_socket( index )->ring != NULL ) {
+        size = receive_ring( index, &data, &(pkt->address) );
 
+        if ( size > 0 ) {
+            size         = ( size < length ) ? size : length;
+            memcpy( buffer, data, size );
 
-            // IP address input must be a string 
-            
+            pkt->buf     = buffer;
+            pkt->offset  = 0;
+        }
 
-#ifdef _DEBUG_
-            // Print initial debug information
-            printf("index = %d, length = %d, port = %d, ip_addr = %s \n", handle, length, port, ip_addr);
-            printf("num_sample = %d, start_sample = %d, buffer_id = %d \n", num_samples, start_sample, buffer_id);
-            print_buffer( buffer, length );
-#endif
-            
-            // Allocate memory and initialize the output buffer
-            output_array      = (uint32 *) malloc( sizeof( uint32 ) * num_samples );
-            if( output_array == NULL ) { printf("Error:  Could not allocate receive buffer"); die();}
-            
-            //for ( i = 0; i < num_samples; i++ ) { output_array[i] = 0; }
+        pkt->length  = size;
 
-            
-            // Set the useful RX buffer size to 90% of the RX buffer
-            //     NOTE:  This is integer division so the rx_buffer_size will be truncated by the divide
-            //
-            uint32 useful_rx_buffer_size  = 0;
-            useful_rx_buffer_size  = 9 * ( rx_buffer_size / 10 );
-            
+        return size;
+    }
 
-            // Update the buffer with the correct command arguments since it is too expensive to do in MATLAB
-            command_args    = (uint32 *) ( buffer + sizeof( wl_transport_header ) + sizeof( wl_command_header ) );
-            command_args[0] = endian_swap_32( buffer_id );
-            command_args[3] = endian_swap_32( max_length );
+    // Receive a response 
+    size = recvfrom( wl_socket( index )->handle, buffer, length, 0, 
+                    (struct sockaddr *) &(pkt->address), (socklen_t *) &socket_addr_size );
 
-            // printf("newBuffID = %d, old = %d: index=%d \n", endian_swap_32( command_args[0]) , buffer_id, handle);
-			
-                
-            // Check to see if we have enough receive buffer space for the requested packets.
-            // If not, then break the request up in to multiple requests.
-            
-            if( num_samples < ( useful_rx_buffer_size >> 2 ) ) {
 
-                // Call receive function normally
-                command_args[1] = endian_swap_32( start_sample );
-                command_args[2] = endian_swap_32( num_samples );
-                command_args[4] = endian_swap_32( num_pkts );
+    // Check on error conditions
+    if ( size == SOCKET_ERROR )  {
+        if ( get_last_error != EWOULDBLOCK ) {
+            die_with_error("Error:  Socket Error.");
+        } else {
+            // If the socket is not ready, then just return a size of 0 so the function can be 
+            // called again
+            size = 0;
+        }
+    } else {
+                    
+        // Update the packet associated with the socket
+        //   NOTE:  pkt.address was updated via the function call
+        // printf("index = %d, received size = %d\n", index, size);
+        pkt->buf     = buffer;
+        pkt->offset  = 0;
 
-                // Call function
+        WL_STATS_ADD( index, pkt->address.sin_addr.s_addr, pkts_rcvd, 1 );
+        WL_STATS_ADD( index, pkt->address.sin_addr.s_addr, bytes_rcvd, size );
 
+        wl_wait_done( index, pkt->address.sin_addr.s_addr );
+    }
 
-                size = wl_read_baseband_buffer( handle, buffer, length, ip_addr, port,
-                                                num_samples, start_sample, buffer_id,
-                                                output_array, &num_cmds );
+    // Update the packet length so we can determine when we need to zero out pkt.address
+    pkt->length  = size;
 
-            } else {
+    return size;
+}
 
-                // Since we are requesting more data than can fit in to the receive buffer, break this 
-                // request in to multiple function calls, so we do not hit the timeout functions
 
-                // Number of packets that can fit in the receive buffer
-                num_pkts_to_request     = useful_rx_buffer_size / max_length;            // RX buffer size in bytes / Max packet size in bytes
-                
-                // Number of samples in a request (number of samples in a packet * number of packets in a request)
-                num_samples_to_request  = (max_length >> 2) * num_pkts_to_request;
-                
-                // Starting sample
-                start_sample_to_request = start_sample;
-
-                // Error checking to make sure something bad did not happen
-                if ( num_pkts_to_request > num_pkts ) {
-                    printf("ERROR:  Read IQ / Read RSSI - Parameter mismatch \n");
-                    printf("    Requested %d packet(s) and %d sample(s) in function call.  \n", num_pkts, num_samples);
-                    printf("    Receive buffer can hold %d samples (ie %d packets).  \n", num_samples_to_request, num_pkts_to_request);
-                    printf("    Since, the number of samples requested is greater than what the receive buffer can hold, \n");
-                    printf("    the number of packets requested should be greater than what the receive buffer can hold. \n");
-                    die_with_error("Error:  Read IQ / Read RSSI - Parameter mismatch.  See above for debug information.");
-                }
-                
-                command_args[2] = endian_swap_32( num_samples_to_request );
-                command_args[4] = endian_swap_32( num_pkts_to_request );
+/*****************************************************************************/
+/**
+*  Function:  alloc_socket_batch
+*
+*  Allocates the batched receive storage of the socket
+*
+******************************************************************************/
+void alloc_socket_batch( int index ) {
 
-                for( i = num_pkts; i > 0; i -= num_pkts_to_request ) {
+    wl_socket( index )->batch = (wl_trans_batch *) calloc( 1, sizeof(wl_trans_batch) );
 
-                    int j = i - num_pkts_to_request;
-                
-                    // If we are requesting the last set of packets, then just request the remaining samples
-                    if ( j < 0 ) {
-                        num_samples_to_request = num_samples - ( (num_pkts - i) * (max_length >> 2) );
-                        command_args[2]        = endian_swap_32( num_samples_to_request );
-                        
-                        num_pkts_to_request    = i;
-                        command_args[4]        = endian_swap_32( num_pkts_to_request );
-                    }
+    if ( wl_socket( index )->batch == NULL ) {
+        die_with_error("Error:  Cannot allocate memory for batch.");
+    }
 
-                    command_args[1] = endian_swap_32( start_sample_to_request );
+    wl_socket( index )->batch->length = TRANSPORT_MAX_PKT_LENGTH;
+    wl_socket( index )->batch->buf    = (char *) wl_aligned_alloc( TRANSPORT_MAX_BATCH * TRANSPORT_MAX_PKT_LENGTH );
+}
 
-                    // Call function
-                    size = wl_read_baseband_buffer( handle, buffer, length, ip_addr, port,
-                                                    num_samples_to_request, start_sample_to_request, buffer_id,
-                                                    output_array, &num_cmds );
-                    
-                    start_sample_to_request += num_samples_to_request;                    
+
+/*****************************************************************************/
+/**
+*  Function:  receive_socket_batch
+*
+*  Returns the next packet queued on the socket; will return 0 if no data is
+*  available.  When the packets held from the last call have been handed out,
+*  every datagram queued on the socket (up to TRANSPORT_MAX_BATCH) is drained
+*  with a single recvmmsg() call.  On return, *buffer points in to the batch
+*  storage and is only valid until the next call on the same socket.  The 
+*  source address of the packet is returned in address (if not NULL).
+*
+******************************************************************************/
+int receive_socket_batch( int index, char **buffer, struct sockaddr_in *address ) {
+
+    wl_trans_batch     *batch;
+    int                 size;
+    int                 i;
+
+    // Packets in the receive ring are handed out in place (see set_receive_ring)
+    if ( wl_socket( index )->ring != NULL ) {
+        return receive_ring( index, buffer, address );
+    }
+
+    // Get the batch storage associated with the index (allocated by init_socket)
+    batch = wl_socket( index )->batch;
+
+    // Refill the batch once every held packet has been handed out
+    if ( batch->next >= batch->count ) {
+
+        batch->next  = 0;
+        batch->count = 0;
+
+#ifdef WIN32
+        // No recvmmsg() on this platform; fall back to a single receive
+        size = receive_socket( index, batch->length, batch->buf );
+
+        if ( size > 0 ) {
+            batch->size[0]    = size;
+            batch->address[0] = wl_socket( index )->packet->address;
+            batch->count      = 1;
+        }
+#else
+        struct mmsghdr      msgs[TRANSPORT_MAX_BATCH];
+        struct iovec        iovs[TRANSPORT_MAX_BATCH];
+
+        memset( msgs, 0, sizeof(msgs) );
+
+        for ( i = 0; i < TRANSPORT_MAX_BATCH; i++ ) {
+            iovs[i].iov_base           = batch->buf + ( i * batch->length );
+            iovs[i].iov_len            = batch->length;
+            msgs[i].msg_hdr.msg_iov    = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name    = &(batch->address[i]);
+            msgs[i].msg_hdr.msg_namelen = sizeof( struct sockaddr_in );
+
+            if ( wl_socket( index )->timestamps ) {
+                msgs[i].msg_hdr.msg_control    = batch->control[i];
+                msgs[i].msg_hdr.msg_controllen = sizeof( batch->control[i] );
+            }
+        }
+
+        // Receive all queued packets
+        size = recvmmsg( wl_socket( index )->handle, msgs, TRANSPORT_MAX_BATCH, MSG_DONTWAIT, NULL );
+
+        // Check on error conditions
+        if ( size == SOCKET_ERROR ) {
+            if ( ( get_last_error != EWOULDBLOCK ) && ( get_last_error != EAGAIN ) ) {
+                die_with_error("Error:  Socket Error.");
+            }
+            size = 0;
+        }
+
+        for ( i = 0; i < size; i++ ) {
+            batch->size[i] = msgs[i].msg_len;
+
+            if ( wl_socket( index )->timestamps ) {
+                struct cmsghdr *cmsg;
+
+                memset( &(batch->stamp[i]), 0, sizeof( struct timespec ) );
+
+                for ( cmsg = CMSG_FIRSTHDR( &(msgs[i].msg_hdr) ); cmsg != NULL; cmsg = CMSG_NXTHDR( &(msgs[i].msg_hdr), cmsg ) ) {
+                    if ( ( cmsg->cmsg_level == SOL_SOCKET ) && ( cmsg->cmsg_type == SCM_TIMESTAMPNS ) ) {
+                        memcpy( &(batch->stamp[i]), CMSG_DATA( cmsg ), sizeof( struct timespec ) );
+                    }
                 }
-                
-                size = num_samples;
             }
 
+            WL_STATS_ADD( index, batch->address[i].sin_addr.s_addr, pkts_rcvd, 1 );
+            WL_STATS_ADD( index, batch->address[i].sin_addr.s_addr, bytes_rcvd, msgs[i].msg_len );
+        }
 
-            
+        batch->count = size;
+#endif
 
-            if ( size != 0 ) {
+        if ( batch->count == 0 ) {
+            return 0;
+        }
 
-                // Process returned output array
-      //TODO: For now only consider IQ
-				//         if ( function == TRANSPORT_READ_IQ ) {
+        wl_wait_done( index, batch->address[0].sin_addr.s_addr );
+    }
 
+    // Hand out the next held packet
+    i       = batch->next++;
+    *buffer = batch->buf + ( i * batch->length );
 
-                    // Need to unpack the WARPLab sample
-                    //   NOTE:  This performs a conversion from an UFix_16_0 to a Fix_14_13 
-                    //      (in WARPv3, we convert Fix_12_11 to Fix_14_13 by zeroing out the two LSBs)
-                    //      Process:
-                    //          1) Mask upper two bits
-                    //          2) Sign exten the value so you have a true twos compliment 16 bit value
-                    //          3) Divide by range / 2 to move the decimal point so resulting value is between +/- 1
-                    
-                    for ( i = 0; i < size; i++ ) {
-                        // I samples
-                        temp_I_val = (double) ((int16) (((output_array[i] >> 16) & 0x3FFF) | 
-                                                      (((output_array[i] >> 29) & 0x1) * 0xC000)));
-                        
-                        // Q samples
-                        temp_Q_val = (double) ((int16) ((output_array[i]        & 0x3FFF) | 
-                                                      (((output_array[i] >> 13) & 0x1) * 0xC000)));
-                        samples[i] = ( temp_I_val*0.00012207 ) + (temp_Q_val*0.00012207)*I;                        
-                        //printf("temp_I_val = %f\n", (double) 0x2000);
-                        // samples[i] =  (temp_Q_val/ 8192)*I;                        
+    if ( address != NULL ) {
+        *address = batch->address[i];
+    }
 
-                    }
-                    
-       //         } else { // TRANSPORT_READ_RSSI
+    return batch->size[i];
+}
 
-                
-        //               for ( i = 0; i < (2*size); i += 2 ) {
-        //                 samples[i]     = (double)((output_array[(i/2)] >> 16) & 0x03FF);
-        //                samples[i + 1] = (double) (output_array[(i/2)]        & 0x03FF);
-        //            }
-        //        }
-            } else {
-                // Return an empty array
-				printf("Nothing returned fro read\n");
-				// 
+
+/*****************************************************************************/
+/**
+*  Function:  receive_ring
+*
+*  Hands out the next datagram of the receive ring of the socket (see 
+*  set_receive_ring);  returns 0 if no block of the ring is ready.  The IP 
+*  and UDP headers are parsed here:  *buffer points to the UDP payload in 
+*  the ring and is only valid until the next call on the same socket, when 
+*  a block whose packets have all been handed out goes back to the kernel.
+*  The source address of the datagram is returned in address (if not NULL).
+*
+******************************************************************************/
+int receive_ring( int index, char **buffer, struct sockaddr_in *address ) {
+
+#ifdef WIN32
+    return 0;
+#else
+    wl_trans_ring             *ring = wl_socket( index )->ring;
+    struct tpacket_block_desc *desc;
+    struct tpacket3_hdr       *hdr;
+    struct sockaddr_ll        *sll;
+    uint8                     *ip;
+    uint8                     *udp;
+    uint32                     ip_hdr_size;
+    int                        size;
+
+    while ( 1 ) {
+
+        // Open the next block once every packet of the current one has been handed out
+        if ( ring->pkts_left == 0 ) {
+
+            desc = (struct tpacket_block_desc *) ( ring->map + ( (size_t) ring->block * ring->block_size ) );
+
+            if ( ring->pkt != NULL ) {
+                __atomic_store_n( &(desc->hdr.bh1.block_status), TP_STATUS_KERNEL, __ATOMIC_RELEASE );
+
+                ring->pkt   = NULL;
+                ring->block = ( ring->block + 1 ) % ring->num_blocks;
+                desc        = (struct tpacket_block_desc *) ( ring->map + ( (size_t) ring->block * ring->block_size ) );
             }
 
-            
-            // Free allocated memory
-            //free( ip_addr );
-            free( output_array );
-            
-#ifdef _DEBUG_
-            printf("END TRANSPORT_READ_IQ \ TRANSPORT_READ_RSSI\n");
-#endif  
+            if ( ( __atomic_load_n( &(desc->hdr.bh1.block_status), __ATOMIC_ACQUIRE ) & TP_STATUS_USER ) == 0 ) {
+                return 0;
+            }
 
+            ring->pkts_left = desc->hdr.bh1.num_pkts;
+            ring->pkt       = (uint8 *) desc + desc->hdr.bh1.offset_to_first_pkt;
 
-			return size;
+            continue;
+        }
 
-}
+        hdr              = (struct tpacket3_hdr *) ring->pkt;
+        ring->pkt       += hdr->tp_next_offset;
+        ring->pkts_left -= 1;
 
+        sll = (struct sockaddr_ll *) ( (uint8 *) hdr + TPACKET_ALIGN( sizeof(struct tpacket3_hdr) ) );
+        ip  = (uint8 *) hdr + hdr->tp_net;
 
-//------------------------------------------------------
-        // cmds_used = wl_mex_udp_transport('write_iq', handle, cmd_buffer, max_length, ip_addr, port, 
-        //                                          number_samples, sample_buffer, buffer_id, start_sample, num_pkts, max_samples, hw_ver);
-        //
-        //   - Arguments:
+        // Skip packets sent by the host and truncated packets
+        if ( ( sll->sll_pkttype == PACKET_OUTGOING ) || ( hdr->tp_snaplen != hdr->tp_len ) ) {
+            continue;
+        }
+
+        ip_hdr_size = 4 * ( ip[0] & 0x0F );
+        udp         = ip + ip_hdr_size;
+        size        = ( ( udp[4] << 8 ) | udp[5] ) - 8;
+
+        if ( ( size < 0 ) || ( ( ip_hdr_size + 8 + size ) > hdr->tp_snaplen ) ) {
+            continue;
+        }
+
+        *buffer = (char *) ( udp + 8 );
+
+        if ( address != NULL ) {
+            memset( address, 0, sizeof(struct sockaddr_in) );
+            address->sin_family = AF_INET;
+            memcpy( &(address->sin_addr.s_addr), ip + 12, 4 );
+            memcpy( &(address->sin_port), udp, 2 );
+        }
+
+        ring->stamp.tv_sec  = hdr->tp_sec;
+        ring->stamp.tv_nsec = hdr->tp_nsec;
+
+        WL_STATS_ADD( index, *( (uint32 *) ( ip + 12 ) ), pkts_rcvd, 1 );
+        WL_STATS_ADD( index, *( (uint32 *) ( ip + 12 ) ), bytes_rcvd, size );
+
+        wl_wait_done( index, *( (uint32 *) ( ip + 12 ) ) );
+
+        return size;
+    }
+#endif
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  get_receive_timestamp
+*
+*  Returns (in stamp, CLOCK_REALTIME) the kernel receive time of the packet 
+*  last handed out by receive_socket_batch()
+*
+*  Returns:  1 if the packet has a timestamp, 0 otherwise
+*
+******************************************************************************/
+int get_receive_timestamp( int index, struct timespec *stamp ) {
+
+    wl_trans_batch     *batch = wl_socket( index )->batch;
+
+    // The ring keeps the receive time of every packet
+    if ( wl_socket( index )->timestamps && ( wl_socket( index )->ring != NULL ) ) {
+        *stamp = wl_socket( index )->ring->stamp;
+
+        return ( ( stamp->tv_sec != 0 ) || ( stamp->tv_nsec != 0 ) );
+    }
+
+    if ( ( !wl_socket( index )->timestamps ) || ( batch == NULL ) || ( batch->next == 0 ) ) {
+        return 0;
+    }
+
+    *stamp = batch->stamp[batch->next - 1];
+
+    return ( ( stamp->tv_sec != 0 ) || ( stamp->tv_nsec != 0 ) );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_timeout_us
+*
+*  Returns the response timeout (in us) of an operation (WL_RTT_*) to the node
+*  at address after backoff consecutive timeouts:  the retransmission timeout
+*  estimated from the round trip times of the node (see warp_rtt.h), doubled 
+*  on each timeout and bounded by the socket timeout (see set_so_timeout)
+*
+******************************************************************************/
+uint32 wl_timeout_us( int index, uint32 address, int op, uint32 backoff ) {
+
+    return wl_rtt_timeout( address, op, backoff, ( wl_socket( index )->timeout > 0 ) ? 1000 * wl_socket( index )->timeout : 0 );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_timer_start
+*
+*  (Re)starts a response timer;  it runs out timeout_us from now
+*
+******************************************************************************/
+void wl_timer_start( wl_trans_timer *timer, uint32 timeout_us ) {
+
+    timer->timeout_us = timeout_us;
+    timer->expired    = 0;
+
+    clock_gettime( CLOCK_MONOTONIC, &(timer->deadline) );
+
+    timer->deadline.tv_sec  += timeout_us / 1000000;
+    timer->deadline.tv_nsec += ( timeout_us % 1000000 ) * 1000L;
+
+    if ( timer->deadline.tv_nsec >= 1000000000L ) {
+        timer->deadline.tv_sec  += 1;
+        timer->deadline.tv_nsec -= 1000000000L;
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_timer_check
+*
+*  Checks the timer without waiting.  Returns 1 (and sets timer->expired) 
+*  once the timer has run out, 0 otherwise.
+*
+******************************************************************************/
+int wl_timer_check( wl_trans_timer *timer ) {
+
+    struct timespec     now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    if ( ( now.tv_sec > timer->deadline.tv_sec ) ||
+         ( ( now.tv_sec == timer->deadline.tv_sec ) && ( now.tv_nsec >= timer->deadline.tv_nsec ) ) ) {
+        timer->expired = 1;
+    }
+
+    return timer->expired;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_timer_wait
+*
+*  Called after a receive on the socket came back empty.  Waits for the next
+*  packet according to the wait mode of the socket and returns 1 (and sets 
+*  timer->expired) once the timer has run out, 0 otherwise.
+*
+*  The first empty receive starts a wait, which ends with the next packet 
+*  (see wl_wait_done) or with the timer;  the phase it ends in (spinning or
+*  blocked) is counted in the statistics of the socket.
+*
+******************************************************************************/
+int wl_timer_wait( int index, wl_trans_timer *timer ) {
+
+    wl_trans_socket    *sock = wl_socket( index );
+    struct timespec     now;
+    struct timespec     remaining;
+
+    if ( sock->wait_phase == TRANSPORT_WAIT_PHASE_NONE ) {
+        sock->wait_phase = TRANSPORT_WAIT_PHASE_SPIN;
+
+        if ( sock->wait_mode == TRANSPORT_WAIT_EVENT ) {
+            sock->wait_phase  = TRANSPORT_WAIT_PHASE_BLOCK;
+        } else if ( sock->wait_mode == TRANSPORT_WAIT_HYBRID ) {
+            sock->spin_end_ns = wl_trace_now() + ( 1000 * (uint64_t) sock->spin_us );
+        }
+    }
+
+    // Spin until the spin budget runs out
+    if ( ( sock->wait_phase == TRANSPORT_WAIT_PHASE_SPIN ) && ( sock->wait_mode == TRANSPORT_WAIT_HYBRID ) && 
+         ( wl_trace_now() >= sock->spin_end_ns ) ) {
+        sock->wait_phase = TRANSPORT_WAIT_PHASE_BLOCK;
+    }
+
+    if ( sock->wait_phase == TRANSPORT_WAIT_PHASE_BLOCK ) {
+
+        clock_gettime( CLOCK_MONOTONIC, &now );
+
+        remaining.tv_sec  = timer->deadline.tv_sec  - now.tv_sec;
+        remaining.tv_nsec = timer->deadline.tv_nsec - now.tv_nsec;
+
+        if ( remaining.tv_nsec < 0 ) {
+            remaining.tv_sec  -= 1;
+            remaining.tv_nsec += 1000000000L;
+        }
+
+        if ( remaining.tv_sec >= 0 ) {
+#ifdef WIN32
+            usleep( 10 );
+#else
+            struct pollfd       pfd;
+
+            pfd.fd      = ( sock->ring != NULL ) ? sock->ring->handle : sock->handle;
+            pfd.events  = POLLIN;
+            pfd.revents = 0;
+
+            // Sleep until a packet is queued on the socket (or a block of its ring is ready) or the deadline passes
+            ppoll( &pfd, 1, &remaining, NULL );
+#endif
+        }
+    }
+
+    if ( wl_timer_check( timer ) ) {
+        WL_STATS_ADD( index, 0, wait_timeouts, 1 );
+
+        sock->wait_phase = TRANSPORT_WAIT_PHASE_NONE;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_timer_compare
+*
+*  Orders two timers by the time they expire (negative if a expires first)
+*
+******************************************************************************/
+int wl_timer_compare( wl_trans_timer *a, wl_trans_timer *b ) {
+
+    if ( a->deadline.tv_sec != b->deadline.tv_sec ) {
+        return ( a->deadline.tv_sec < b->deadline.tv_sec ) ? -1 : 1;
+    }
+    if ( a->deadline.tv_nsec != b->deadline.tv_nsec ) {
+        return ( a->deadline.tv_nsec < b->deadline.tv_nsec ) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_pacer_start
+*
+*  (Re)starts the pacer;  the next packet may leave right away
+*
+******************************************************************************/
+void wl_pacer_start( wl_trans_pacer *pacer ) {
+
+    pacer->next_ns   = wl_trace_now();
+    pacer->depart_ns = pacer->next_ns;
+    pacer->wait_ns   = 0;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_pacer_gap_ns
+*
+*  Returns the time between the departures of two packets of length bytes on
+*  the socket:  the time the packet takes at the target rate of the socket 
+*  (see set_write_pacing), or gap_us (the gap the node needs) if the socket
+*  has no target rate
+*
+******************************************************************************/
+uint64_t wl_pacer_gap_ns( int index, int length, uint32 gap_us ) {
+
+    if ( wl_socket( index )->pace_rate > 0 ) {
+        return ( (uint64_t) length * 8000 ) / wl_socket( index )->pace_rate;
+    }
+
+    return (uint64_t) gap_us * 1000;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_pacer_wait
+*
+*  Waits for the departure time of the next packet:  sleeps until 
+*  TRANSPORT_PACE_SPIN_NS before it and spins on the clock for the rest 
+*  (usleep() overshoots short delays by tens of us)
+*
+******************************************************************************/
+static void wl_pacer_wait( wl_trans_pacer *pacer ) {
+
+    uint64_t            now_ns = wl_trace_now();
+    uint64_t            wait_ns;
+    struct timespec     wait;
+
+    // A packet never leaves before now (the pacer does not save up time)
+    if ( pacer->next_ns <= now_ns ) {
+        pacer->next_ns = now_ns;
+        return;
+    }
+
+    wait_ns = pacer->next_ns - now_ns;
+
+    if ( wait_ns > TRANSPORT_PACE_SPIN_NS ) {
+        wait_ns     -= TRANSPORT_PACE_SPIN_NS;
+        wait.tv_sec  = wait_ns / 1000000000ULL;
+        wait.tv_nsec = wait_ns % 1000000000ULL;
+
+        nanosleep( &wait, NULL );
+    }
+
+    while ( wl_trace_now() < pacer->next_ns ) {
+        // Spin until the departure time
+    }
+
+    pacer->wait_ns += pacer->next_ns - now_ns;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_pacer_send
+*
+*  Sends packets (see send_socket_gather) at their departure times, spaced by
+*  the gap of each packet (see wl_pacer_gap_ns).  The spin pacer waits for 
+*  each departure time (see wl_pacer_wait) and submits the packets that are
+*  due together with one call;  on a socket paced with SO_TXTIME all packets
+*  are handed to the kernel right away with their departure times.  The 
+*  departure time of each packet is returned in its txtime_ns.
+*
+*  Returns:  Number of bytes sent
+*
+******************************************************************************/
+int wl_pacer_send( int index, wl_trans_pacer *pacer, wl_trans_sg_pkt *pkts, int num_pkts, const struct sockaddr_in *address, uint32 gap_us ) {
+
+    uint64_t            now_ns = wl_trace_now();
+    uint64_t            gap_ns = 0;
+    int                 first;
+    int                 i;
+    int                 size   = 0;
+
+    if ( wl_socket( index )->pace_mode == TRANSPORT_PACE_TXTIME ) {
+
+        // A packet never leaves before now (the pacer does not save up time)
+        if ( pacer->next_ns < now_ns ) {
+            pacer->next_ns = now_ns;
+        }
+
+        for ( i = 0; i < num_pkts; i++ ) {
+            pkts[i].txtime_ns  = pacer->next_ns;
+            pacer->depart_ns   = pacer->next_ns;
+            pacer->next_ns    += wl_pacer_gap_ns( index, pkts[i].hdr_length + pkts[i].payload_length, gap_us );
+        }
+
+        return send_socket_gather( index, pkts, num_pkts, address );
+    }
+
+    for ( first = 0; first < num_pkts; first = i ) {
+
+        wl_pacer_wait( pacer );
+
+        // Packets without a gap leave together
+        for ( i = first; i < num_pkts; ) {
+            gap_ns             = wl_pacer_gap_ns( index, pkts[i].hdr_length + pkts[i].payload_length, gap_us );
+            pkts[i].txtime_ns  = pacer->next_ns;
+            pacer->depart_ns   = pacer->next_ns;
+            pacer->next_ns    += gap_ns;
+            i                 += 1;
+
+            if ( gap_ns > 0 ) { break; }
+        }
+
+        size += send_socket_gather( index, &pkts[first], i - first, address );
+    }
+
+    return size;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_pacer_pending_us
+*
+*  Returns how long (in us) until the last packet leaves the host (only
+*  non-zero on a socket paced with SO_TXTIME)
+*
+******************************************************************************/
+uint32 wl_pacer_pending_us( wl_trans_pacer *pacer ) {
+
+    uint64_t            now_ns = wl_trace_now();
+
+    return ( pacer->depart_ns > now_ns ) ? (uint32) ( ( pacer->depart_ns - now_ns ) / 1000 ) : 0;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  cleanup
+*
+*  Function called by atMexExit to close everything
+*
+******************************************************************************/
+void cleanup( void ) {
+    int i;
+
+    // printf("MEX-file is terminating\n");
+
+    // Close all sockets
+    for ( i = 0; i < num_sockets; i++ ) {
+        if ( wl_socket( i )->handle != INVALID_SOCKET ) {  close_socket( i ); }    
+    }
+
+#ifdef WIN32
+    WSACleanup();  // Cleanup Winsock 
+#endif
+
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  print_version
+*
+* This function will print the version of the wl_mex_udp_transport driver
+*
+******************************************************************************/
+void print_version( ) {
+
+    printf("WARPLab MEX UDP Transport v%s (compiled %s %s)\n", WL_MEX_UDP_TRANSPORT_VERSION, __DATE__, __TIME__);
+    printf("Copyright 2013, Mango Communications. All rights reserved.\n");
+    printf("Distributed under the WARP license:  http://warpproject.org/license  \n");
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  print_usage
+*
+* This function will print the usage of the wl_mex_udp_transport driver
+*
+******************************************************************************/
+void print_usage( ) {
+
+    printf("Usage:  WARPLab MEX Transport v%s \n", WL_MEX_UDP_TRANSPORT_VERSION );
+    printf("Standard WARPLab transport functions: \n");
+    printf("    1.                  wl_mex_udp_transport('version') \n");
+    printf("    2. index          = wl_mex_udp_transport('init_socket') \n");
+    printf("    3.                  wl_mex_udp_transport('set_so_timeout', index, timeout) \n");
+    printf("    4.                  wl_mex_udp_transport('set_send_buf_size', index, size) \n");
+    printf("    5. size           = wl_mex_udp_transport('get_send_buf_size', index) \n");
+    printf("    6.                  wl_mex_udp_transport('set_rcvd_buf_size', index, size) \n");
+    printf("    7. size           = wl_mex_udp_transport('get_rcvd_buf_size', index) \n");
+    printf("    8.                  wl_mex_udp_transport('close', index) \n");
+    printf("    9. size           = wl_mex_udp_transport('send', index, buffer, length, ip_addr, port) \n");
+    printf("   10. [size, buffer] = wl_mex_udp_transport('receive', index, length ) \n");
+    printf("\n");
+    printf("Additional WARPLab MEX UDP transport functions: \n");
+    printf("    1. [num_samples, cmds_used, samples]  = wl_mex_udp_transport('read_rssi' / 'read_iq', \n");
+    printf("                                                index, buffer, length, ip_addr, port, \n");
+    printf("                                                number_samples, buffer_id, start_sample) \n");
+    printf("    2. cmds_used                          = wl_mex_udp_transport('write_iq', \n");
+    printf("                                                index, cmd_buffer, max_length, ip_addr, port, \n");
+    printf("                                                number_samples, sample_buffer, buffer_id, \n");
+    printf("                                                start_sample, num_pkts, max_samples, hw_ver) \n");
+    printf("\n");
+    printf("See documentation for further details.\n");
+    printf("\n");
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  die
+*
+*  Generates an error message and cause the program to halt
+*
+******************************************************************************/
+void die( ) {
+    //mexErrMsgTxt("Error:  See description above.");
+    printf("Error:  See description above.");
+	cleanup();
+	exit(0);
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  die_with_error
+*
+* This function will error out of the wl_mex_udp_transport function call
+*
+******************************************************************************/
+void die_with_error(char *errorMessage) {
+    printf("%s \n   Socket Error Code: %d\n", errorMessage, get_last_error );
+    die();
+}
+
+
+
+/*****************************************************************************/
+/**
+*  Function:  print_sockets
+*
+*  Debug function to print socket table
+*
+******************************************************************************/
+void print_sockets( void ) {
+    int i;
+    
+    printf("Sockets: \n");    
+    
+    for ( i = 0; i < num_sockets; i++ ) {
+        printf("    socket[%d]:  handle = 0x%4x,   timeout = 0x%4x,  status = 0x%4x", 
+               i, wl_socket( i )->handle, wl_socket( i )->timeout, wl_socket( i )->status);
+    }
+
+    printf("\n");
+}
+
+
+#ifdef _DEBUG_
+/*****************************************************************************/
+/**
+*  Function:  print_buffer
+*
+*  Debug function to print a buffer
+*
+******************************************************************************/
+void print_buffer(unsigned char *buf, int size) {
+	int i;
+
+	printf("Buffer: (0x%x bytes)\n", size);
+
+	for (i=0; i<size; i++) {
+        printf("%2x ", buf[i] );
+        if ( (((i + 1) % 16) == 0) && ((i + 1) != size) ) {
+            printf("\n");
+        }
+	}
+	printf("\n\n");
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  print_buffer_16
+*
+*  Debug function to print a buffer
+*
+******************************************************************************/
+void print_buffer_16(uint16 *buf, int size) {
+	int i;
+
+	printf("Buffer: (0x%x bytes)\n", (2*size));
+
+	for (i=0; i<size; i++) {
+        printf("%4x ", buf[i] );
+        if ( (((i + 1) % 16) == 0) && ((i + 1) != size) ) {
+            printf("\n");
+        }
+	}
+	printf("\n\n");
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  print_buffer_32
+*
+*  Debug function to print a buffer
+*
+******************************************************************************/
+void print_buffer_32(uint32 *buf, int size) {
+	int i;
+
+	printf("Buffer: (0x%x bytes)\n", (4*size));
+
+	for (i=0; i<size; i++) {
+        printf("%8x ", buf[i] );
+        if ( (((i + 1) % 8) == 0) && ((i + 1) != size) ) {
+            printf("\n");
+        }
+	}
+	printf("\n\n");
+}
+
+#endif
+
+
+/*****************************************************************************/
+/**
+*  Function:  endian_swap_16
+*
+* This function will perform an byte endian swap on a 16-bit value 
+*
+******************************************************************************/
+uint16 endian_swap_16(uint16 value) {
+
+	return (((value & 0xFF00) >> 8) | ((value & 0x00FF) << 8));
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  endian_swap_32
+*
+* This function will perform an byte endian swap on a 32-bit value 
+*
+******************************************************************************/
+uint32 endian_swap_32(uint32 value) {
+	uint16 lo;
+	uint16 hi;
+
+	// get each of the half words from the 32 bit word
+	lo = (uint16) (value & 0x0000FFFF);
+	hi = (uint16) ((value & 0xFFFF0000) >> 16);
+
+	// byte swap each of the 16 bit half words
+	lo = (((lo & 0xFF00) >> 8) | ((lo & 0x00FF) << 8));
+	hi = (((hi & 0xFF00) >> 8) | ((hi & 0x00FF) << 8));
+
+	// swap the half words before returning the value
+	return (uint32) ((lo << 16) | hi);
+}
+
+
+
+//------------------------------------------------------
+        // size = wl_mex_udp_transport('send', handle, buffer, length, ip_addr, port)
+        //   - Arguments:
+        //     - handle (int)     - index to the requested socket
+        //     - buffer (char *)  - Buffer of data to be sent
+        //     - length (int)     - Length of data to be sent
+        //     - ip_addr          - IP Address to send data to
+        //     - port             - Port to send data to
+        //   - Returns:
+        //     - size (int)       - size of data sent (in bytes)
+
+int sendData(int handle, char* buffer, int length, char* ip_addr, int port){
+
+#ifdef _DEBUG_
+            printf("Function : TRANSPORT_SEND\n");
+#endif
+            
+
+#ifdef _DEBUG_
+            printf("index = %d, length = %d, port = %d, ip_addr = %s \n", handle, length, port, ip_addr);
+#endif
+                       
+            // Call function
+            int size = 0;
+			size = send_socket( handle, buffer, length, ip_addr, port );
+            //free (ip_addr);
+
+
+#ifdef _DEBUG_
+            print_buffer( buffer, length );
+            printf("END TRANSPORT_SEND \n");
+#endif
+
+			return size;
+}
+
+
+//------------------------------------------------------
+        // [size, buffer] = wl_mex_udp_transport('receive', handle, length )
+        //   - Arguments:
+        //     - handle (int)     - index to the requested socket
+        //     - length (int)     - length of data to be received (in bytes)
+        //     - buffer (char *)  - Buffer of data received
+		//   - Returns:
+		//       size 
+
+
+int receiveData(char* buffer, int handle, int length){
+
+                        
+#ifdef _DEBUG_
+            printf("Function : TRANSPORT_RECEIVE\n");
+#endif
+
+
+#ifdef _DEBUG_
+            printf("index = %d, length = %d \n", handle, length );
+#endif
+
+            // Allocate memory for the buffer
+            int i;
+			if( buffer == NULL ) { printf("Error: Did not receive a valid buffer"); die();}
+            for ( i = 0; i < length; i++ ) { buffer[i] = 0; }
+
+            // Call function
+            int size = 0;
+			size = receive_socket( handle, length, buffer );                       
+
+            
+#ifdef _DEBUG_
+            if ( size != 0 ) {
+                printf("Buffer size = %d \n", size);
+                print_buffer( (char *) buffer, size );
+            }
+            printf("END TRANSPORT_RECEIVE \n");
+#endif
+
+			return size;
+}
+
+
+//------------------------------------------------------
+        //[num_samples, cmds_used, samples]  = wl_mex_udp_transport('read_rssi' / 'read_iq', 
+        //                                        handle, buffer, length, ip_addr, port,
+        //                                        number_samples, buffer_id, start_sample);
+        //   - Arguments:
+        //     - samples      (double *)    - Array of samples received		  
+        //     - handle       (int)         - index to the requested socket
+        //     - buffer       (char *)      - Buffer of data to be sent
+        //     - length       (int)         - Length of data to be sent
+        //     - ip_addr      (char *)      - IP Address to send data to
+        //     - port         (int)         - Port to send data to
+        //     - num_samples  (int)         - Number of samples requested
+        //     - buffer_id    (int)         - WARP RF buffer to obtain samples from
+        //     - start_sample (int)         - Starting address in the array for the samples
+		//     -max_length	(int)
+		//     -num_pkts	(int)
+        //   - Returns:
+        //     - num_samples  (int)         - Number of samples received
+        //     ?? cmds_used    (int)         - Number of transport commands used to obtain samples
+
+
+int readSamples(double complex* samples, int handle, char* buffer, int length, char* ip_addr, int port, int num_samples, uint32 buffer_id, int start_sample, int max_length, int num_pkts){
+
+    return readSamplesFormat(samples, WL_SAMPLE_DOUBLE, handle, buffer, length, ip_addr, port, num_samples, buffer_id, start_sample, max_length, num_pkts);
+}
+
+
+//------------------------------------------------------
+        // Same as readSamples, except
+        //   - Arguments:
+        //     - samples      (void *)      - Array of samples received		  
+        //     - format       (int)         - Format of the sample array (WL_SAMPLE_*);  samples are decoded 
+        //                                    straight from the packets in to this format (see wl_decode_samples)
+
+int readSamplesFormat(void* samples, int format, int handle, char* buffer, int length, char* ip_addr, int port, int num_samples, uint32 buffer_id, int start_sample, int max_length, int num_pkts){
+
+#ifdef _DEBUG_
+            printf("Function : TRANSPORT_READ_IQ \ TRANSPORT_READ_RSSI\n");
+#endif
+
+    int     max_samples             = 0;
+    uint32  num_cmds                = 0;
+    uint32 *command_args            = NULL;			
+	int size = 0;
+
+			if( buffer == NULL ) { printf("Error: Did not receive a valid buffer"); die();}
+
+            if( samples == NULL ) { printf("Error: Did not receive a valid samples buffer"); die();}
+
+            // Reads of several buffers need one sample array per buffer
+            if( __builtin_popcount( buffer_id ) != 1 ) { printf("Error: Read of buffer mask 0x%x needs one array per buffer (see readSamplesMulti)", buffer_id); die();}
+            
+            //for ( i = 0; i < num_samples; i++ ) { samples[i] = 0; }
+
+
+
+            // IP address input must be a string 
+            
+
+#ifdef _DEBUG_
+            // Print initial debug information
+            printf("index = %d, length = %d, port = %d, ip_addr = %s \n", handle, length, port, ip_addr);
+            printf("num_sample = %d, start_sample = %d, buffer_id = %d \n", num_samples, start_sample, buffer_id);
+            print_buffer( buffer, length );
+#endif
+            
+            // Sample packets are decoded straight in to the samples array (samples[0] is start_sample)
+
+            
+            // Set the useful RX buffer size to 90% of the RX buffer of the socket (see wl_read_budget)
+            uint32 useful_rx_buffer_size  = 0;
+            useful_rx_buffer_size  = wl_read_budget( handle );
+            
+
+            // Update the buffer with the correct command arguments since it is too expensive to do in MATLAB
+            command_args    = (uint32 *) ( buffer + sizeof( wl_transport_header ) + sizeof( wl_command_header ) );
+            command_args[0] = endian_swap_32( buffer_id );
+            command_args[3] = endian_swap_32( max_length );
+
+            // printf("newBuffID = %d, old = %d: index=%d \n", endian_swap_32( command_args[0]) , buffer_id, handle);
+			
+                
+            // Check to see if we have enough receive buffer space for the requested packets.
+            // If not, then break the request up in to multiple requests.
+            
+            if( num_samples < ( useful_rx_buffer_size >> 2 ) ) {
+
+                // Call receive function normally
+                command_args[1] = endian_swap_32( start_sample );
+                command_args[2] = endian_swap_32( num_samples );
+                command_args[4] = endian_swap_32( num_pkts );
+
+                // Call function
+
+
+                size = wl_read_baseband_samples( handle, buffer, length, ip_addr, port,
+                                                 num_samples, start_sample, buffer_id,
+                                                 format, samples, start_sample, &num_cmds );
+
+            } else {
+
+                // Since we are requesting more data than can fit in to the receive buffer, break this 
+                // request in to chunks.  The chunks are pipelined so that the next request is sent as soon 
+                // as enough of the ones in flight has arrived (see readSamplesMulti)
+                size = readSamplesMulti( &samples, format, handle, &buffer, length, &ip_addr, &port, 1, 
+                                         num_samples, buffer_id, start_sample, max_length );
+            }
+
+
+            
+
+            if ( size != 0 ) {
+
+                // Process returned output array
+      //TODO: For now only consider IQ
+				//         if ( function == TRANSPORT_READ_IQ ) {
+
+
+                    // WARPLab samples were unpacked as the packets arrived (see wl_decode_samples)
+                    
+       //         } else { // TRANSPORT_READ_RSSI
+
+                
+        //               for ( i = 0; i < (2*size); i += 2 ) {
+        //                 samples[i]     = (double)((output_array[(i/2)] >> 16) & 0x03FF);
+        //                samples[i + 1] = (double) (output_array[(i/2)]        & 0x03FF);
+        //            }
+        //        }
+            } else {
+                // Return an empty array
+				printf("Nothing returned fro read\n");
+				// 
+            }
+
+            
+            //free( ip_addr );
+            
+#ifdef _DEBUG_
+            printf("END TRANSPORT_READ_IQ \ TRANSPORT_READ_RSSI\n");
+#endif  
+
+
+			return size;
+
+}
+
+
+//------------------------------------------------------
+        // Read the same samples from several nodes on one socket, from one thread
+        //   - Arguments:
+        //     - samples      (void **)     - Array of sample arrays, one per node and buffer:  samples[j * num_buffers + b]
+        //                                    is buffer b (in increasing bit order of buffer_id) of node j
+        //     - format       (int)         - Format of the sample arrays (WL_SAMPLE_*)
+        //     - handle       (int)         - index to the socket shared by all nodes
+        //     - buffers      (char **)     - Read IQ command for each node
+        //     - length       (int)         - Length of the commands
+        //     - ip_addrs     (char **)     - IP Address of each node
+        //     - ports        (int *)       - Port of each node
+        //     - num_nodes    (int)         - Number of nodes
+        //     - num_samples  (int)         - Number of samples requested from each node
+        //     - buffer_id    (int)         - WARP RF buffer(s) to obtain samples from;  every buffer of a 
+        //                                    mask is requested with one command per node and chunk and the
+        //                                    sample packets are routed to the buffer arrays by their buffer ID
+        //     - start_sample (int)         - Starting address in the array for the samples
+        //     - max_length   (int)         - Number of sample bytes per packet
+        //   - Returns:
+        //     - num_samples  (int)         - Number of samples received over all nodes and buffers
+
+int readSamplesMulti(void** samples, int format, int handle, char** buffers, int length, char** ip_addrs, int* ports, int num_nodes, int num_samples, uint32 buffer_id, int start_sample, int max_length){
+
+    int     i, j, k, b;
+    int     size                    = 0;
+    int     num_chunks              = 0;
+    int     num_buffers             = 0;
+    int     num_transfers           = 0;
+    uint32  buffer_bit              = 0;
+    uint32  samples_per_pkt         = 0;
+    uint32  num_samples_per_chunk   = 0;
+    uint32  num_samples_to_request  = 0;
+    uint32  start_sample_to_request = 0;
+    uint32  useful_rx_buffer_size   = 0;
+    uint32 *command_args            = NULL;
+    wl_trans_ctx  *ctx              = NULL;
+    wl_read_state *states           = NULL;
+    wl_read_state *last             = NULL;
+    struct timespec start_time;
+
+    char    cmd[TRANSPORT_MAX_CMD_LENGTH];
+
+    if( ( buffers == NULL ) || ( samples == NULL ) || ( ip_addrs == NULL ) || ( ports == NULL ) ) { 
+        printf("Error: Did not receive valid node arrays"); die();
+    }
+    if( length > TRANSPORT_MAX_CMD_LENGTH ) { printf("Error: Read IQ command too long"); die(); }
+
+    num_buffers = __builtin_popcount( buffer_id );
+
+    if ( num_buffers == 0 ) { printf("Error: Did not receive a valid buffer ID"); die(); }
+
+    // Nothing to read (and no chunk size to split the request with)
+    if ( num_samples == 0 ) {
+        return 0;
+    }
+
+    // Set the useful RX buffer size to 90% of the RX buffer of the socket
+    useful_rx_buffer_size  = wl_read_budget( handle );
+
+    // Split each node request in to chunks so that TRANSPORT_READ_PIPELINE chunks (of every buffer) fit in 
+    // the receive buffer.  The engine sends the next chunk as soon as enough of the ones in flight has 
+    // arrived, so the link does not sit idle for a round trip per chunk.
+    samples_per_pkt        = max_length >> 2;
+    num_samples_per_chunk  = samples_per_pkt * ( ( useful_rx_buffer_size / TRANSPORT_READ_PIPELINE / num_buffers ) / ( max_length + WL_READ_PKT_OVERHEAD ) );
+
+    if ( num_samples_per_chunk == 0 ) {
+        num_samples_per_chunk = samples_per_pkt;
+    }
+
+    if ( num_samples_per_chunk > num_samples ) {
+        num_samples_per_chunk = num_samples;
+    }
+
+    num_chunks = ( num_samples + num_samples_per_chunk - 1 ) / num_samples_per_chunk;
+
+    // Stage the transfers in the socket context
+    ctx = get_socket_context( handle );
+    reserve_socket_context( ctx, num_nodes * num_chunks * num_buffers );
+
+    states = ctx->states;
+
+    // The transfers are ordered chunk by chunk so that every node gets its first request out early;
+    // the transfers of the buffers of one node and chunk are a group requested with one command
+    k = 0;
+    for ( i = 0; i < num_chunks; i++ ) {
+
+        start_sample_to_request = start_sample + ( i * num_samples_per_chunk );
+        num_samples_to_request  = num_samples - ( i * num_samples_per_chunk );
+
+        if ( num_samples_to_request > num_samples_per_chunk ) {
+            num_samples_to_request = num_samples_per_chunk;
+        }
+
+        for ( j = 0; j < num_nodes; j++ ) {
+
+            // Update the buffer with the correct command arguments
+            memcpy( cmd, buffers[j], length );
+
+            command_args    = (uint32 *) ( cmd + sizeof( wl_transport_header ) + sizeof( wl_command_header ) );
+            command_args[1] = endian_swap_32( start_sample_to_request );
+            command_args[2] = endian_swap_32( num_samples_to_request );
+            command_args[3] = endian_swap_32( max_length );
+            command_args[4] = endian_swap_32( ( num_samples_to_request + samples_per_pkt - 1 ) / samples_per_pkt );
+
+            b = 0;
+            for ( buffer_bit = 1; buffer_bit != 0; buffer_bit <<= 1 ) {
+
+                if ( ( buffer_id & buffer_bit ) == 0 ) {
+                    continue;
+                }
+
+                command_args[0] = endian_swap_32( buffer_bit );
+
+                // Sample packets are decoded straight in to the samples of the buffer (samples[j * num_buffers + b][0] is start_sample)
+                wl_read_init( &states[k + b], cmd, length, ip_addrs[j], ports[j],
+                              num_samples_to_request, start_sample_to_request, buffer_bit, 
+                              format, samples[j * num_buffers + b], start_sample );
+                b += 1;
+            }
+
+            wl_read_group( &states[k], num_buffers );
+            k += num_buffers;
+        }
+    }
+
+    num_transfers = k;
+
+    clock_gettime( CLOCKTYPE, &start_time );
+
+    size = wl_read_baseband_multi( handle, states, num_transfers, useful_rx_buffer_size );
+
+    for ( i = 0; i < num_transfers; i++ ) {
+        wl_read_free( &states[i] );
+    }
+
+    // The read of a node is done when the last of its chunks is (transfer k is buffer k % num_buffers 
+    // of node ( k / num_buffers ) % num_nodes in chunk k / ( num_nodes * num_buffers ))
+    for ( j = 0; j < num_nodes; j++ ) {
+
+        last = &states[j * num_buffers];
+
+        for ( i = 0; i < num_transfers; i++ ) {
+            if ( ( ( i / num_buffers ) % num_nodes == j ) &&
+                 ( (   states[i].done_time.tv_sec >  last->done_time.tv_sec ) ||
+                   ( ( states[i].done_time.tv_sec == last->done_time.tv_sec ) && ( states[i].done_time.tv_nsec > last->done_time.tv_nsec ) ) ) ) {
+                last = &states[i];
+            }
+        }
+
+        wl_stats_op( handle, last->address.sin_addr.s_addr, WL_STATS_OP_READ, &start_time, &(last->done_time) );
+
+        if ( wl_trace_enabled() ) {
+            wl_read_trace( handle, &states[j * num_buffers], num_chunks, num_nodes * num_buffers, num_buffers, &start_time );
+        }
+    }
+
+    return size;
+}
+
+
+
+//------------------------------------------------------
+        // cmds_used = wl_mex_udp_transport('write_iq', handle, cmd_buffer, max_length, ip_addr, port, 
+        //                                          number_samples, sample_buffer, buffer_id, start_sample, num_pkts, max_samples, hw_ver);
+        //
+        //   - Arguments:
         //     - handle          (int)      - Index to the requested socket
         //     - cmd_buffer      (char *)   - Buffer of data to be used as the header for Write IQ command
         //     - max_length      (int)      - Length of max data packet (in bytes)
@@ -937,526 +2498,1085 @@ int readSamples(double complex* samples, int handle, char* buffer, int length, c
         //   - Returns:
         //     - cmds_used   (int)  - number of transport commands used to send samples
 
-int writeSamples(int handle, char* buffer, int max_length, char* ip_addr, int port, int num_samples, uint16* sample_I_buffer, uint16* sample_Q_buffer, int buffer_id, int start_sample, int num_pkts, int max_samples, int hw_ver){
+int writeSamples(int handle, char* buffer, int max_length, char* ip_addr, int port, int num_samples, uint16* sample_I_buffer, uint16* sample_Q_buffer, int buffer_id, int start_sample, int num_pkts, int max_samples, int hw_ver){
+
+#ifdef _DEBUG_
+            printf("Function : TRANSPORT_WRITE_IQ\n");
+#endif
+
+
+            // Packet data must be an array of uint8
+			if( buffer == NULL ) { printf("Error: Did not receive a valid header buffer"); die();}
+
+
+            // IP address input must be a string 
+            
+            // Sample I/Q Buffer
+			if( sample_I_buffer == NULL ) { printf("Error: Did not receive a valid sample I buffer"); die();}
+			if( sample_Q_buffer == NULL ) { printf("Error: Did not receive a valid sample Q buffer"); die();}
+
+                   
+            // Sample I Buffer
+
+
+            // NOTE:  Due to differences in rounding between Matlab and C when converting from double to int16
+            //   we must preprocess the sample array so that it contains a uint32 consisting of the I and Q 
+            //   for a given sample.  The code below can demonstrate the rounding difference between Matlab and C
+            //  
+            //
+            // if ( mxIsComplex( prhs[7] ) != 1 ) { mexErrMsgTxt("Error: Sample Buffer input must be an array of complex doubles"); }            
+            // if ( mxGetN( prhs[7] ) != 1 ) { mexErrMsgTxt("Error: Sample buffer input must be a column vector."); }
+            //
+            // temp_i = (double *) mxGetPr(prhs[7]);
+            // temp_q = (double *) mxGetPi(prhs[7]);
+            //
+            // sample_buffer = (uint32 *) malloc( sizeof( uint32 ) * num_samples );
+            // if( sample_buffer == NULL ) { mexErrMsgTxt("Error:  Could not allocate sample buffer"); }
+            // for ( i = 0; i < num_samples; i++ ) { 
+            //     sample_buffer[i] = (uint32)( ((int16)( temp_i[i] * (1 << 15) )) << 16 ) + ((int16)( temp_q[i] * ( 1 << 15 ) )); 
+            // }
+            // 
+			int size = 0;
+			int num_cmds = 0; 
+
+#ifdef _DEBUG_
+            // Print initial debug information
+            printf("index = %d, length = %d, port = %d, ip_addr = %s \n", handle, max_length, port, ip_addr);
+            printf("num_sample = %d, start_sample = %d, buffer_id = %d \n", num_samples, start_sample, buffer_id);
+            printf("num_pkts = %d, max_samples = %d \n", num_pkts, max_samples);
+            printf("wl_transport_header = %d, wl_command_header = %d, wl_sample_header = %d \n", 
+                   sizeof( wl_transport_header ), sizeof( wl_command_header ), sizeof( wl_sample_header ));
+            print_buffer( buffer, ( sizeof( wl_transport_header ) + sizeof( wl_command_header ) )  );
+ //           print_buffer_32( sample_buffer, num_samples );
+#endif
+                        
+            // Call function
+            size = wl_write_baseband_buffer( handle, buffer, max_length, ip_addr, port,
+                                             num_samples, start_sample, sample_I_buffer, sample_Q_buffer, buffer_id, num_pkts, max_samples, hw_ver,
+                                             &num_cmds );
+
+            
+            if ( size == 0 ) {
+                printf("Error:  Did not send any samples");
+            }
+            
+                 
+#ifdef _DEBUG_
+            printf("END TRANSPORT_WRITE_IQ\n");
+#endif  
+			return num_cmds; 
+}
+
+
+
+        //------------------------------------------------------
+        // cmds_used = writeSamplesFormat( handle, cmd_buffer, max_length, ip_addr, port, 
+        //                                 number_samples, format, samples, buffer_id, start_sample, num_pkts, max_samples, hw_ver );
+        //
+        //   - Arguments:  same as writeSamples, except
+        //     - format          (int)      - Format of the sample array (WL_SAMPLE_*)
+        //     - samples         (void *)   - Array of samples to be sent;  samples are quantized straight in to
+        //                                    the packets (see wl_encode_iq)
+        //   - Returns:
+        //     - cmds_used   (int)  - number of transport commands used to send samples
+
+int writeSamplesFormat(int handle, char* buffer, int max_length, char* ip_addr, int port, int num_samples, int format, const void* samples, int buffer_id, int start_sample, int num_pkts, int max_samples, int hw_ver){
+
+    int    size     = 0;
+    uint32 num_cmds = 0;
+
+#ifdef _DEBUG_
+    printf("Function : TRANSPORT_WRITE_IQ (format %d)\n", format);
+#endif
+
+    if( buffer  == NULL ) { printf("Error: Did not receive a valid header buffer"); die();}
+    if( samples == NULL ) { printf("Error: Did not receive a valid samples buffer"); die();}
+
+    size = wl_write_baseband_samples( handle, buffer, max_length, ip_addr, port,
+                                      num_samples, start_sample, format, samples, buffer_id, num_pkts, max_samples, hw_ver,
+                                      &num_cmds );
+
+    if ( size == 0 ) {
+        printf("Error:  Did not send any samples");
+    }
+
+    return num_cmds;
+}
+
+
+
+        //------------------------------------------------------
+        // cmds_used = writeSamplesWaveform( handle, cmd_buffer, max_length, ip_addr, port, waveform, buffer_id, hw_ver );
+        //
+        //   - Arguments:  same as writeSamples, except
+        //     - waveform        (wl_waveform *)  - Pre-encoded waveform (see wl_waveform_create);  it also holds 
+        //                                          the start sample, number of samples, packets and samples per packet
+        //   - Returns:
+        //     - cmds_used   (int)  - number of transport commands used to send samples
+
+int writeSamplesWaveform(int handle, char* buffer, int max_length, char* ip_addr, int port, const wl_waveform* waveform, int buffer_id, int hw_ver){
+
+    int    size     = 0;
+    uint32 num_cmds = 0;
+
+#ifdef _DEBUG_
+    printf("Function : TRANSPORT_WRITE_IQ (waveform)\n");
+#endif
+
+    if( buffer   == NULL ) { printf("Error: Did not receive a valid header buffer"); die();}
+    if( waveform == NULL ) { printf("Error: Did not receive a valid waveform"); die();}
+
+    size = wl_write_baseband_waveform( handle, buffer, max_length, ip_addr, port, waveform, buffer_id, hw_ver, &num_cmds );
+
+    if ( ( size == 0 ) && ( waveform->num_pkts > 0 ) ) {
+        printf("Error:  Did not send any samples");
+    }
+
+    return num_cmds;
+}
+
+
+
+
+
+
+/*****************************************************************************/
+//           Additional WL Mex UDP Transport functionality
+/*****************************************************************************/
+
+
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_bitmap_next_clear / wl_bitmap_next_set
+*
+*  Return the index of the first clear / set bit at or after start in a bitmap 
+*  of size bits (size if there is none)
+*
+******************************************************************************/
+uint32 wl_bitmap_next_clear( uint32 *bitmap, uint32 start, uint32 size ) {
+
+    uint32 word;
+
+    while ( start < size ) {
+
+        word = ~bitmap[start >> 5] >> ( start & 0x1F );
+
+        if ( word ) {
+            start += __builtin_ctz( word );
+            return ( start < size ) ? start : size;
+        }
+
+        start = ( start | 0x1F ) + 1;
+    }
+
+    return size;
+}
+
+
+uint32 wl_bitmap_next_set( uint32 *bitmap, uint32 start, uint32 size ) {
+
+    uint32 word;
+
+    while ( start < size ) {
+
+        word = bitmap[start >> 5] >> ( start & 0x1F );
+
+        if ( word ) {
+            start += __builtin_ctz( word );
+            return ( start < size ) ? start : size;
+        }
+
+        start = ( start | 0x1F ) + 1;
+    }
+
+    return size;
+}
+
+
+
+/*****************************************************************************/
+/**
+*
+* This function will read the baseband buffers and construct the sample array
+*
+* @param	index          - Index in to socket structure which will receive samples
+* @param	buffer         - WARPLab command to request samples
+* @param	length         - Length (in bytes) of buffer
+* @param    ip_addr        - IP Address of node to retrieve samples
+* @param    port           - Port of node to retrieve samples
+* @param    num_samples    - Number of samples to process (should be the same as the argument in the WARPLab command)
+* @param    start_sample   - Index of starting sample (should be the same as the agrument in the WARPLab command)
+* @param    buffer_id      - Which buffer(s) do we need to retrieve samples from
+* @param    output_array   - Return parameter - array of samples to return
+* @param    num_cmds       - Return parameter - number of ethernet send commands used to request packets 
+*                                (could be > 1 if there are transmission errors)
+*
+* @return	size           - Number of samples processed (also size of output_array)
+*
+* @note		This function requires the following pointers:
+*   Input:
+*       - Buffer containing command to request samples (char *)
+*       - IP Address (char *)
+*       - Array of buffer IDs (uint32 *)
+*       - Allocated memory to return samples (uint32 *)
+*       - Location to return the number of send commands used to generate the samples (uint32 *)
+*
+*   Output:
+*       - Number of samples processed 
+*
+******************************************************************************/
+int wl_read_baseband_buffer( int index, 
+                             char *buffer, int length, char *ip_addr, int port,
+                             int num_samples, int start_sample, uint32 buffer_id,
+                             uint32 *output_array, uint32 *num_cmds ) {
+
+    // The output array is indexed by sample number
+    return wl_read_baseband_samples( index, buffer, length, ip_addr, port, num_samples, start_sample, buffer_id,
+                                     WL_SAMPLE_RAW32, output_array, 0, num_cmds );
+}
+
+
+/*****************************************************************************/
+/**
+*
+* This function will read the baseband buffers and decode the samples straight
+* from the packets in to an output array of the given format
+*
+* @param	index          - Index in to socket structure which will receive samples
+* @param	buffer         - WARPLab command to request samples
+* @param	length         - Length (in bytes) of buffer
+* @param    ip_addr        - IP Address of node to retrieve samples
+* @param    port           - Port of node to retrieve samples
+* @param    num_samples    - Number of samples to process (should be the same as the argument in the WARPLab command)
+* @param    start_sample   - Index of starting sample (should be the same as the agrument in the WARPLab command)
+* @param    buffer_id      - Which buffer(s) do we need to retrieve samples from
+* @param    format         - Format of the output array (WL_SAMPLE_*)
+* @param    output         - Return parameter - array of samples to return
+* @param    output_start   - Sample number stored at output[0]
+* @param    num_cmds       - Return parameter - number of ethernet send commands used to request packets 
+*                                (could be > 1 if there are transmission errors)
+*
+* @return	size           - Number of samples processed
+*
+******************************************************************************/
+int wl_read_baseband_samples( int index, 
+                              char *buffer, int length, char *ip_addr, int port,
+                              int num_samples, int start_sample, uint32 buffer_id,
+                              int format, void *output, uint32 output_start, uint32 *num_cmds ) {
+
+    wl_read_state         state;
+    struct timespec       start_time;
+
+    wl_read_init( &state, buffer, length, ip_addr, port, num_samples, start_sample, buffer_id, 
+                  format, output, output_start );
+
+    clock_gettime( CLOCKTYPE, &start_time );
+
+    // A single transfer is always sent, regardless of the receive buffer budget
+    wl_read_baseband_multi( index, &state, 1, 0 );
+
+    wl_read_free( &state );
+
+    wl_stats_op( index, state.address.sin_addr.s_addr, WL_STATS_OP_READ, &start_time, &(state.done_time) );
+
+    if ( wl_trace_enabled() ) {
+        wl_read_trace( index, &state, 1, 1, 1, &start_time );
+    }
+
+    // Finalize outputs   
+    *num_cmds  += state.num_cmds;
+    
+    return state.num_rcvd_samples;
+}
+
+
+
+/*****************************************************************************/
+/**
+*
+* This function will initialize the state of a single Read IQ transfer so that 
+* it can be handed to wl_read_baseband_multi().  Nothing is sent.
+*
+* @param	state          - Transfer state to initialize
+* @param	buffer         - WARPLab command to request samples (copied in to the state)
+* @param	length         - Length (in bytes) of buffer
+* @param    ip_addr        - IP Address of node to retrieve samples
+* @param    port           - Port of node to retrieve samples
+* @param    num_samples    - Number of samples to process (should be the same as the argument in the WARPLab command)
+* @param    start_sample   - Index of starting sample (should be the same as the agrument in the WARPLab command)
+* @param    buffer_id      - Which buffer do we need to retrieve samples from
+* @param    format         - Format of the output array (WL_SAMPLE_*)
+* @param    output         - Return parameter - array of samples to return
+* @param    output_start   - Sample number stored at output[0]
+*
+******************************************************************************/
+void wl_read_init( wl_read_state *state, 
+                   char *buffer, int length, char *ip_addr, int port,
+                   int num_samples, int start_sample, uint32 buffer_id,
+                   int format, void *output, uint32 output_start ) {
+
+    uint32                buffer_id_cmd      = 0;
+    uint32                start_sample_cmd   = 0;
+    uint32                total_sample_cmd   = 0;
+    uint32                bytes_per_pkt      = 0;
+    uint32               *command_args;
+
+    // Compute some constants to be used later
+    uint32                cmd_hdr_size      = sizeof( wl_transport_header ) + sizeof( wl_command_header );
+
+    if ( length > TRANSPORT_MAX_CMD_LENGTH ) {
+        die_with_error("Error:  Read IQ command is longer than TRANSPORT_MAX_CMD_LENGTH.");
+    }
+
+    memset( state, 0, sizeof( wl_read_state ) );
+    memcpy( state->buffer, buffer, length );
+
+    // Construct the address structure
+    state->length                       = length;
+    wl_resolve_address( ip_addr, port, &(state->address) );
+    state->port                         = port;
+    strncpy( state->ip_addr, ip_addr, sizeof( state->ip_addr ) - 1 );
+
+    command_args     = (uint32 *) ( state->buffer + cmd_hdr_size );
+    
+    buffer_id_cmd    = endian_swap_32( command_args[0] );
+    start_sample_cmd = endian_swap_32( command_args[1] );
+    total_sample_cmd = endian_swap_32( command_args[2] );
+    bytes_per_pkt    = endian_swap_32( command_args[3] );            // Command contains payload size
+    
+    state->buffer_id       = buffer_id;
+    state->group_size      = 1;
+    state->group_mask      = buffer_id;
+    state->start_sample    = start_sample;
+    state->num_samples     = num_samples;
+    state->num_pkts        = endian_swap_32( command_args[4] );
+    state->bytes_per_pkt   = bytes_per_pkt;
+    state->samples_per_pkt = ( bytes_per_pkt >> 2 );                 // Each WARPLab sample is 4 bytes
+    state->format          = format;
+    state->output          = output;
+    state->output_start    = output_start;
+    
+#ifdef _DEBUG_
+    // Print command arguments    
+    printf("length = %d, port = %d, ip_addr = %s \n", length, port, ip_addr);
+    printf("num_sample = %d, start_sample = %d, buffer_id = %d \n", num_samples, start_sample, buffer_id);
+    printf("bytes_per_pkt = %d;  num_pkts = %d \n", bytes_per_pkt, state->num_pkts );
+    print_buffer( buffer, length );
+#endif
+
+    // Perform a consistency check to make sure parameters are correct
+    if ( buffer_id_cmd != buffer_id ) {
+        printf("WARNING:  Buffer ID in command (%d) does not match function parameter (%d)\n", buffer_id_cmd, buffer_id);
+    }
+    if ( start_sample_cmd != start_sample ) {
+        printf("WARNING:  Starting sample in command (%d) does not match function parameter (%d)\n", start_sample_cmd, start_sample);
+    }
+    if ( total_sample_cmd != num_samples ) {
+        printf("WARNING:  Number of samples requested in command (%d) does not match function parameter (%d)\n", total_sample_cmd, num_samples);
+    }
+
+    // Malloc bitmap to track the packets that have been received and initialize
+    //     NOTE:  Packet i of the transfer carries samples [ start_sample + i * samples_per_pkt, ... )
+    if ( WL_BITMAP_WORDS( state->num_pkts ) <= WL_READ_BITMAP_WORDS ) {
+        state->rcvd_bitmap = state->bitmap;
+    } else {
+        state->rcvd_bitmap = (uint32 *) calloc( WL_BITMAP_WORDS( state->num_pkts ), sizeof( uint32 ) );
+        if( state->rcvd_bitmap == NULL ) { die_with_error("Error:  Could not allocate sample tracker bitmap"); }
+    }
+
+    state->status = WL_READ_IDLE;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_read_free
+*
+*  Frees the memory held by a Read IQ transfer state
+*
+******************************************************************************/
+void wl_read_free( wl_read_state *state ) {
+
+    if ( state->rcvd_bitmap != state->bitmap ) {
+        free( state->rcvd_bitmap );
+    }
+    state->rcvd_bitmap = NULL;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_read_group
+*
+*  Groups transfers of the same samples from different buffers of one node so 
+*  that they are requested with a single Read IQ command carrying the mask of 
+*  all their buffers.  The node answers with the packets of each buffer tagged 
+*  with that buffer's ID, so wl_read_match routes them to their own transfer 
+*  (and output array).  Retransmissions are requested per transfer with the 
+*  buffer ID of the transfer alone.
+*
+*  NOTE:  states[0] carries the group;  the transfers must be contiguous and 
+*      states[0] must be the first of them handed to wl_read_baseband_multi.
+*
+******************************************************************************/
+void wl_read_group( wl_read_state *states, int num_states ) {
+
+    int i;
+
+    states[0].group_size = num_states;
+    states[0].group_mask = 0;
+
+    for ( i = 0; i < num_states; i++ ) {
+
+        if ( i > 0 ) {
+            states[i].group_size = 0;
+            states[i].group_mask = 0;
+        }
+        states[0].group_mask |= states[i].buffer_id;
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_read_send
+*
+*  Sends the (current) Read IQ command of the transfer to the node and 
+*  restarts the response timer.  The first command of a transfer takes a new
+*  sequence number of the socket;  the node echoes it in the sample packets,
+*  so packets of earlier reads of the same samples are told apart (see 
+*  wl_read_match).
+*
+******************************************************************************/
+void wl_read_send( int index, wl_read_state *state ) {
+
+    int sent_size;
+
+    if ( state->status == WL_READ_IDLE ) {
+        state->seq_num = ++( wl_socket( index )->read_seq_num );
+
+        ( (wl_transport_header *) state->buffer )->seq_num = endian_swap_16( state->seq_num );
+    }
+
+    if ( state->num_cmds == 0 ) {
+        clock_gettime( CLOCK_MONOTONIC, &(state->send_time) );
+
+        if ( wl_trace_enabled() ) {
+            state->trace.request_ns = wl_trace_now();
+        }
+    }
+
+    sent_size = send_socket_to( index, state->buffer, state->length, &(state->address) );
+
+    if ( sent_size != state->length ) {
+        die_with_error("Error:  Size of packet sent to request samples does not match length of packet.");
+    }
+
+    state->num_cmds += 1;
+    state->status    = WL_READ_ACTIVE;
+
+    WL_STATS_ADD( index, state->address.sin_addr.s_addr, read_cmds, 1 );
+
+    wl_timer_start( &(state->timer), wl_timeout_us( index, state->address.sin_addr.s_addr, WL_RTT_READ, state->backoff ) );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_read_send_group
+*
+*  Sends the first Read IQ command of a group of transfers (see wl_read_group) 
+*  and starts the response timers of all of them
+*
+******************************************************************************/
+void wl_read_send_group( int index, wl_read_state *states ) {
+
+    uint32                i;
+    uint32               *command_args;
+
+    if ( states[0].group_size <= 1 ) {
+        wl_read_send( index, states );
+        return;
+    }
+
+    // One command for every buffer of the group;  later commands of states[0] only ask for its own buffer
+    command_args    = (uint32 *) ( states[0].buffer + sizeof( wl_transport_header ) + sizeof( wl_command_header ) );
+    command_args[0] = endian_swap_32( states[0].group_mask );
+
+    wl_read_send( index, &states[0] );
+
+    command_args[0] = endian_swap_32( states[0].buffer_id );
+
+    for ( i = 1; i < states[0].group_size; i++ ) {
+
+        // The packets of every buffer of the group echo the sequence number of the command
+        states[i].seq_num          = states[0].seq_num;
+        ( (wl_transport_header *) states[i].buffer )->seq_num = endian_swap_16( states[0].seq_num );
+
+        states[i].status           = WL_READ_ACTIVE;
+        states[i].send_time        = states[0].send_time;
+        states[i].trace.request_ns = states[0].trace.request_ns;
+
+        states[i].timer            = states[0].timer;
+    }
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_read_request_missing
+*
+*  Re-requests only the packets of the transfer that have not been received.
+*  Each run of missing packets in the bitmap becomes one Read IQ command; runs
+*  separated by a single received packet are merged since re-sending one 
+*  packet is cheaper than another command.  All commands of a round are sent 
+*  back to back, at most TRANSPORT_MAX_RANGES of them (the last one covers 
+*  every remaining packet).
+*
+*  Returns:  Number of commands sent
+*
+******************************************************************************/
+int wl_read_request_missing( int index, wl_read_state *state ) {
+
+    uint32                first_pkt;
+    uint32                last_pkt;
+    uint32                next_pkt;
+    uint32                pkt;
+    uint32                start_sample_to_request;
+    uint32                num_samples_to_request;
+    uint32               *command_args;
+    int                   num_ranges         = 0;
+
+    command_args = (uint32 *) ( state->buffer + sizeof( wl_transport_header ) + sizeof( wl_command_header ) );
+
+    pkt = 0;
+
+    while ( ( pkt = wl_bitmap_next_clear( state->rcvd_bitmap, pkt, state->num_pkts ) ) < state->num_pkts ) {
+
+        first_pkt = pkt;
+
+        // Extend the range over missing packets and single received packets between them
+        do {
+            last_pkt = wl_bitmap_next_set( state->rcvd_bitmap, pkt, state->num_pkts );
+            next_pkt = wl_bitmap_next_clear( state->rcvd_bitmap, last_pkt, state->num_pkts );
+            pkt      = next_pkt;
+        } while ( ( next_pkt < state->num_pkts ) && 
+                  ( ( ( next_pkt - last_pkt ) <= 1 ) || ( num_ranges == ( TRANSPORT_MAX_RANGES - 1 ) ) ) );
+
+        // The range covers packets [first_pkt, last_pkt)
+        start_sample_to_request = state->start_sample + ( first_pkt * state->samples_per_pkt );
+        num_samples_to_request  = ( last_pkt - first_pkt ) * state->samples_per_pkt;
+
+        if ( start_sample_to_request + num_samples_to_request > state->start_sample + state->num_samples ) {
+            num_samples_to_request = state->start_sample + state->num_samples - start_sample_to_request;
+        }
+
+        command_args[1] = endian_swap_32( start_sample_to_request );
+        command_args[2] = endian_swap_32( num_samples_to_request );
+        command_args[4] = endian_swap_32( last_pkt - first_pkt );
+
+        wl_read_send( index, state );
+
+        num_ranges += 1;
+    }
+
+    return num_ranges;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_read_timeout
+*
+*  Called when the response timer of the transfer expired; re-requests the 
+*  missing samples
+*
+******************************************************************************/
+void wl_read_timeout( int index, wl_read_state *state ) {
+
+    int num_cmds;
+
+    state->idle_us += state->timer.timeout_us;
+
+    // If the node has not answered for TRANSPORT_GIVE_UP_MS (over timeouts backed off up to the maximum), then abort
+    if ( state->idle_us >= 1000 * TRANSPORT_GIVE_UP_MS ) {
+
+        printf("ERROR:  No response for %d ms (%d retrys) for current Read IQ / Read RSSI request \n", state->idle_us / 1000, state->num_retrys);
+        printf("    Requested %d samples from buffer %d starting from sample number %d \n", state->num_samples, state->buffer_id, state->start_sample);
+        printf("    Received %d out of %d packets from node %s before timeout.\n", state->rcvd_pkts, state->num_pkts, state->ip_addr);
+        printf("    Please check the node and look at the ethernet traffic to isolate the issue. \n");                
+    
+        die_with_error("Error:  Reached maximum number of retrys without a response... aborting.");
+    }
+
+    // NOTE:  We print a warning here because the Read IQ / Read RSSI case in the mex function above
+    //        will split Read IQ / Read RSSI requests based on the receive buffer size.  Therefore,
+    //        any timeouts we receive here should be legitmate issues that should be explored.
+    //
+    printf("WARNING:  index=%d Read IQ / Read RSSI request to %s timed out.  Retrying %d missing packets. \n", 
+           index, state->ip_addr, state->num_pkts - state->rcvd_pkts);
+
+    // Retransmit read IQ requests for the missing packets (with a doubled timeout)
+    state->backoff    += 1;
+
+    num_cmds = wl_read_request_missing( index, state );
+
+    state->num_retrys += 1;
+
+    WL_STATS_ADD( index, state->address.sin_addr.s_addr, read_timeouts, 1 );
+    WL_STATS_ADD( index, state->address.sin_addr.s_addr, read_retrans_cmds, num_cmds );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_read_rtt
+*
+*  Samples the round trip time of the node from the first command of the 
+*  transfer to now (the first packet)
+*
+******************************************************************************/
+static void wl_read_rtt( wl_read_state *state ) {
+
+    struct timespec       now;
+    int64_t               rtt_ns;
 
-#ifdef _DEBUG_
-            printf("Function : TRANSPORT_WRITE_IQ\n");
-#endif
+    clock_gettime( CLOCK_MONOTONIC, &now );
 
+    rtt_ns = ( (int64_t) ( now.tv_sec - state->send_time.tv_sec ) * 1000000000LL ) + ( now.tv_nsec - state->send_time.tv_nsec );
 
-            // Packet data must be an array of uint8
-			if( buffer == NULL ) { printf("Error: Did not receive a valid header buffer"); die();}
+    if ( rtt_ns > 0 ) {
+        wl_rtt_sample( state->address.sin_addr.s_addr, WL_RTT_READ, (uint32) ( rtt_ns / 1000 ) );
+    }
+}
 
 
-            // IP address input must be a string 
-            
-            // Sample I/Q Buffer
-			if( sample_I_buffer == NULL ) { printf("Error: Did not receive a valid sample I buffer"); die();}
-			if( sample_Q_buffer == NULL ) { printf("Error: Did not receive a valid sample Q buffer"); die();}
+/*****************************************************************************/
+/**
+*  Function:  wl_read_packet
+*
+*  Processes one sample packet of the transfer.  Duplicate packets and packets
+*  that do not line up with the packet grid of the transfer are dropped.
+*
+*  Returns:  1 if the transfer is complete
+*            0 otherwise
+*
+******************************************************************************/
+int wl_read_packet( int index, wl_read_state *state, char *buffer, int size ) {
 
-                   
-            // Sample I Buffer
+    uint32                sample_num         = 0;
+    uint32                sample_size        = 0;
+    uint32                pkt                = 0;
+    uint32                expected_size      = 0;
 
+    uint64_t              arrival_ns         = 0;
+    uint64_t              decoded_ns         = 0;
 
-            // NOTE:  Due to differences in rounding between Matlab and C when converting from double to int16
-            //   we must preprocess the sample array so that it contains a uint32 consisting of the I and Q 
-            //   for a given sample.  The code below can demonstrate the rounding difference between Matlab and C
-            //  
-            //
-            // if ( mxIsComplex( prhs[7] ) != 1 ) { mexErrMsgTxt("Error: Sample Buffer input must be an array of complex doubles"); }            
-            // if ( mxGetN( prhs[7] ) != 1 ) { mexErrMsgTxt("Error: Sample buffer input must be a column vector."); }
-            //
-            // temp_i = (double *) mxGetPr(prhs[7]);
-            // temp_q = (double *) mxGetPi(prhs[7]);
-            //
-            // sample_buffer = (uint32 *) malloc( sizeof( uint32 ) * num_samples );
-            // if( sample_buffer == NULL ) { mexErrMsgTxt("Error:  Could not allocate sample buffer"); }
-            // for ( i = 0; i < num_samples; i++ ) { 
-            //     sample_buffer[i] = (uint32)( ((int16)( temp_i[i] * (1 << 15) )) << 16 ) + ((int16)( temp_q[i] * ( 1 << 15 ) )); 
-            // }
-            // 
-			int size = 0;
-			int num_cmds = 0; 
+    uint8                *samples;
+    wl_sample_header     *sample_hdr;
+    
+    // Compute some constants to be used later
+    uint32                cmd_hdr_size      = sizeof( wl_transport_header ) + sizeof( wl_command_header );
+    uint32                all_hdr_size      = sizeof( wl_transport_header ) + sizeof( wl_command_header ) + sizeof( wl_sample_header );
+
+    sample_hdr  = (wl_sample_header *) ( buffer + cmd_hdr_size );
+    samples     = (uint8 *) ( buffer + all_hdr_size );
+    sample_num  = endian_swap_32( sample_hdr->start );
+    sample_size = endian_swap_32( sample_hdr->num_samples );
 
 #ifdef _DEBUG_
-            // Print initial debug information
-            printf("index = %d, length = %d, port = %d, ip_addr = %s \n", handle, max_length, port, ip_addr);
-            printf("num_sample = %d, start_sample = %d, buffer_id = %d \n", num_samples, start_sample, buffer_id);
-            printf("num_pkts = %d, max_samples = %d \n", num_pkts, max_samples);
-            printf("wl_transport_header = %d, wl_command_header = %d, wl_sample_header = %d \n", 
-                   sizeof( wl_transport_header ), sizeof( wl_command_header ), sizeof( wl_sample_header ));
-            print_buffer( buffer, ( sizeof( wl_transport_header ) + sizeof( wl_command_header ) )  );
- //           print_buffer_32( sample_buffer, num_samples );
+    printf("num_sample = %d, start_sample = %d \n", sample_size, sample_num);
 #endif
-                        
-            // Call function
-            size = wl_write_baseband_buffer( handle, buffer, max_length, ip_addr, port,
-                                             num_samples, start_sample, sample_I_buffer, sample_Q_buffer, buffer_id, num_pkts, max_samples, hw_ver,
-                                             &num_cmds );
 
-            
-            if ( size == 0 ) {
-                printf("Error:  Did not send any samples");
-            }
-            
-                 
-#ifdef _DEBUG_
-            printf("END TRANSPORT_WRITE_IQ\n");
-#endif  
-			return num_cmds; 
-}
+    // Ignore stragglers that arrive after the transfer is complete
+    if ( state->status != WL_READ_ACTIVE ) {
+        return ( state->status == WL_READ_DONE );
+    }
 
+    // Find the packet in the transfer
+    pkt           = ( sample_num - state->start_sample ) / state->samples_per_pkt;
+    expected_size = state->num_samples - ( pkt * state->samples_per_pkt );
 
+    if ( expected_size > state->samples_per_pkt ) {
+        expected_size = state->samples_per_pkt;
+    }
 
+    if ( ( sample_num < state->start_sample ) || ( pkt >= state->num_pkts ) ||
+         ( ( sample_num - state->start_sample ) % state->samples_per_pkt ) ||
+         ( sample_size != expected_size ) || ( size < all_hdr_size + ( 4 * sample_size ) ) ) {
 
+        printf("WARNING:  Unexpected sample packet from %s (start sample %d, %d samples).  Dropping it. \n", state->ip_addr, sample_num, sample_size);
+        WL_STATS_ADD( index, state->address.sin_addr.s_addr, read_stray_pkts, 1 );
+        return 0;
+    }
 
+    // Drop duplicates
+    if ( WL_BITMAP_TEST( state->rcvd_bitmap, pkt ) ) {
+        WL_STATS_ADD( index, state->address.sin_addr.s_addr, read_dup_pkts, 1 );
+        return 0;
+    }
 
-/*****************************************************************************/
-//           Additional WL Mex UDP Transport functionality
-/*****************************************************************************/
+    WL_BITMAP_SET( state->rcvd_bitmap, pkt );
 
+    if ( wl_trace_enabled() ) {
+        arrival_ns = wl_trace_now();
+    }
+    
+    // Decode the samples straight from the packet in to the output array (see warp_kernels.c)
+    wl_decode_samples( state->format, state->output, sample_num - state->output_start, samples, sample_size );
+
+    if ( arrival_ns != 0 ) {
+        decoded_ns = wl_trace_now();
+
+        if ( state->trace.first_pkt_ns == 0 ) {
+            state->trace.first_pkt_ns    = arrival_ns;
+            state->trace.decode_start_ns = arrival_ns;
+        }
+
+        state->trace.last_pkt_ns    = arrival_ns;
+        state->trace.decode_end_ns  = decoded_ns;
+        state->trace.decode_ns     += decoded_ns - arrival_ns;
+    }
+    
+    // Round trip of the first command (Karn's algorithm:  not if it was retransmitted)
+    if ( ( state->rcvd_pkts == 0 ) && state->rtt_sample && ( state->num_cmds == 1 ) ) {
+        wl_read_rtt( state );
+    }
+
+    state->num_rcvd_samples += sample_size;
+    state->rcvd_pkts        += 1;
+    state->backoff           = 0;
+    state->idle_us           = 0;
+    wl_timer_start( &(state->timer), wl_timeout_us( index, state->address.sin_addr.s_addr, WL_RTT_READ, 0 ) );
+
+    WL_STATS_ADD( index, state->address.sin_addr.s_addr, read_samples, sample_size );
+
+    // Exit when we have every packet
+    if ( state->rcvd_pkts == state->num_pkts ) {
+        state->status = WL_READ_DONE;
+        clock_gettime( CLOCKTYPE, &(state->done_time) );
+        return 1;
+    }
 
+    return 0;
+}
 
 
 /*****************************************************************************/
 /**
+*  Function:  wl_read_match
 *
-* This function will read the baseband buffers and construct the sample array
-*
-* @param	index          - Index in to socket structure which will receive samples
-* @param	buffer         - WARPLab command to request samples
-* @param	length         - Length (in bytes) of buffer
-* @param    ip_addr        - IP Address of node to retrieve samples
-* @param    port           - Port of node to retrieve samples
-* @param    num_samples    - Number of samples to process (should be the same as the argument in the WARPLab command)
-* @param    start_sample   - Index of starting sample (should be the same as the agrument in the WARPLab command)
-* @param    buffer_id      - Which buffer(s) do we need to retrieve samples from
-* @param    output_array   - Return parameter - array of samples to return
-* @param    num_cmds       - Return parameter - number of ethernet send commands used to request packets 
-*                                (could be > 1 if there are transmission errors)
-*
-* @return	size           - Number of samples processed (also size of output_array)
-*
-* @note		This function requires the following pointers:
-*   Input:
-*       - Buffer containing command to request samples (char *)
-*       - IP Address (char *)
-*       - Array of buffer IDs (uint32 *)
-*       - Allocated memory to return samples (uint32 *)
-*       - Location to return the number of send commands used to generate the samples (uint32 *)
+*  Finds the active transfer a sample packet belongs to.  Packets are 
+*  demultiplexed on the source address and port of the node, the sequence 
+*  number of the transfer's commands, the buffer ID and the sample range of 
+*  the transfer.  Packets of other nodes and late packets of earlier reads 
+*  match no transfer.
 *
-*   Output:
-*       - Number of samples processed 
+*  Returns:  Pointer to the transfer or NULL for a stray packet
 *
 ******************************************************************************/
-int wl_read_baseband_buffer( int index, 
-                             char *buffer, int length, char *ip_addr, int port,
-                             int num_samples, int start_sample, uint32 buffer_id,
-                             uint32 *output_array, uint32 *num_cmds ) {
+static wl_read_state * wl_read_match( wl_read_state *states, int num_states, char *buffer, int size, struct sockaddr_in *address, wl_read_state *last ) {
 
-    // Variable declaration
     int i;
-    int                   done               = 0;
-    
-    uint32                buffer_id_cmd      = 0;
-    uint32                start_sample_cmd   = 0;
-    uint32                total_sample_cmd   = 0;
-    uint32                bytes_per_pkt      = 0;
-    uint32                num_pkts           = 0;
     
-    uint32                output_buffer_size = 0;
-    uint32                samples_per_pkt    = 0;
+    uint32                sample_num;
+    uint32                buffer_id;
+    uint16                seq_num;
+    wl_sample_header     *sample_hdr;
+    wl_read_state        *state;
 
-    int                   sent_size          = 0;
+    uint32                all_hdr_size      = sizeof( wl_transport_header ) + sizeof( wl_command_header ) + sizeof( wl_sample_header );
 
-    uint32                rcvd_pkts          = 0;
-    int                   rcvd_size          = 0;
-    int                   total_rcvd_size    = 0;   
-    int                   num_rcvd_samples   = 0;
-    int                   sample_num         = 0;
-    int                   sample_size        = 0;
-    
-    uint32                timeout            = 0;
-    uint32                num_retrys         = 0;
+    if ( size < all_hdr_size ) {
+        return NULL;
+    }
 
-    uint32                total_cmds         = 0;
-    
-    uint32                err_start_sample   = 0;
-    uint32                err_num_samples    = 0;
-    uint32                err_num_pkts       = 0;
+    sample_hdr = (wl_sample_header *) ( buffer + sizeof( wl_transport_header ) + sizeof( wl_command_header ) );
+    sample_num = endian_swap_32( sample_hdr->start );
+    buffer_id  = endian_swap_16( sample_hdr->buffer_id );
+    seq_num    = endian_swap_16( ( (wl_transport_header *) buffer )->seq_num );
+
+    // Packets arrive in trains from one node, so try the last match first
+    for ( i = -1; i < num_states; i++ ) {
+
+        state = ( i < 0 ) ? last : &states[i];
+
+        if ( ( state != NULL ) &&
+             ( state->status == WL_READ_ACTIVE ) &&
+             ( state->address.sin_addr.s_addr == address->sin_addr.s_addr ) &&
+             ( state->address.sin_port == address->sin_port ) &&
+             ( state->seq_num == seq_num ) &&
+             ( state->buffer_id == buffer_id ) &&
+             ( sample_num >= state->start_sample ) &&
+             ( sample_num <  state->start_sample + state->num_samples ) ) {
+            return state;
+        }
+    }
 
-    
-    char                 *output_buffer;
-    uint8                *samples;
+    return NULL;
+}
 
-    wl_transport_header  *transport_hdr;
-    wl_command_header    *command_hdr;
-    uint32               *command_args;
-    wl_sample_header     *sample_hdr;
-    wl_sample_tracker    *sample_tracker;
 
-    // Compute some constants to be used later
-    uint32                tport_hdr_size    = sizeof( wl_transport_header );
-    uint32                cmd_hdr_size      = sizeof( wl_transport_header ) + sizeof( wl_command_header );
-    uint32                all_hdr_size      = sizeof( wl_transport_header ) + sizeof( wl_command_header ) + sizeof( wl_sample_header );
+/*****************************************************************************/
+/**
+*  Function:  wl_read_node_active
+*
+*  Returns 1 if one of the transfers to the node at address is in flight
+*
+******************************************************************************/
+static int wl_read_node_active( wl_read_state *states, int num_states, uint32 address ) {
 
+    int i;
 
-    // Initialization
-    transport_hdr  = (wl_transport_header *) buffer;
-    command_hdr    = (wl_command_header   *) ( buffer + tport_hdr_size );
-    command_args   = (uint32              *) ( buffer + cmd_hdr_size );
-    
-    buffer_id_cmd    = endian_swap_32( command_args[0] );
-    start_sample_cmd = endian_swap_32( command_args[1] );
-    total_sample_cmd = endian_swap_32( command_args[2] );
-    bytes_per_pkt    = endian_swap_32( command_args[3] );            // Command contains payload size; add room for header
-    num_pkts         = endian_swap_32( command_args[4] );
+    for ( i = 0; i < num_states; i++ ) {
+        if ( ( states[i].status == WL_READ_ACTIVE ) && ( states[i].address.sin_addr.s_addr == address ) ) {
+            return 1;
+        }
+    }
 
-    output_buffer_size = bytes_per_pkt + 100;                        // Command contains payload size; add room for header
-    samples_per_pkt    = ( bytes_per_pkt >> 2 );                     // Each WARPLab sample is 4 bytes
-    
-    
-#ifdef _DEBUG_
-    // Print command arguments    
-    printf("index = %d, length = %d, port = %d, ip_addr = %s \n", index, length, port, ip_addr);
-    printf("num_sample = %d, start_sample = %d, buffer_id = %d \n", num_samples, start_sample, buffer_id);
-    printf("bytes_per_pkt = %d;  num_pkts = %d \n", bytes_per_pkt, num_pkts );
-    print_buffer( buffer, length );
-#endif
+    return 0;
+}
 
-    // Perform a consistency check to make sure parameters are correct
-    if ( buffer_id_cmd != buffer_id ) {
-        printf("WARNING:  Buffer ID in command (%d) does not match function parameter (%d):index= %d\n", buffer_id_cmd, buffer_id, index);
-    }
-    if ( start_sample_cmd != start_sample ) {
-        printf("WARNING:  Starting sample in command (%d) does not match function parameter (%d)\n", start_sample_cmd, start_sample);
-    }
-    if ( total_sample_cmd != num_samples ) {
-        printf("WARNING:  Number of samples requested in command (%d) does not match function parameter (%d)\n", total_sample_cmd, num_samples);
-    }
 
-    
-    // Malloc temporary buffer to process ethernet packets
-    output_buffer  = (char *) malloc( sizeof( char ) * output_buffer_size );
-    if( output_buffer == NULL ) { die_with_error("Error:  Could not allocate temp output buffer"); }
-    
-    // Malloc temporary array to track samples that have been received and initialize
-    sample_tracker = (wl_sample_tracker *) malloc( sizeof( wl_sample_tracker ) * num_pkts );
-    if( sample_tracker == NULL ) { die_with_error("Error:  Could not allocate sample tracker buffer"); }
-    for ( i = 0; i < num_pkts; i++ ) { sample_tracker[i].start_sample = 0;  sample_tracker[i].num_samples = 0; }
+/*****************************************************************************/
+/**
+*
+* This function will run a set of Read IQ transfers, to one or many nodes, on 
+* a single socket from a single thread.  Requests are issued as long as the 
+* response data still outstanding for the transfers in flight fits in the 
+* receive buffer budget, so the next request goes out as soon as enough of the
+* previous ones has arrived.  Sample packets are routed to their transfer by the 
+* source address of the node (see wl_read_match).
+*
+* @param	index          - Index in to socket structure which will receive samples
+* @param	states         - Array of transfers (see wl_read_init)
+* @param	num_states     - Number of transfers
+* @param	max_bytes      - Receive buffer budget (in bytes) for the transfers in flight
+*                                (0 for no limit; one transfer is always in flight)
+*
+* @return	size           - Number of samples processed over all transfers
+*
+******************************************************************************/
+int wl_read_baseband_multi( int index, wl_read_state *states, int num_states, uint32 max_bytes ) {
 
+    int i;
     
-    // Send packet to request samples
-    sent_size   = send_socket( index, buffer, length, ip_addr, port );
-    total_cmds += 1;
+    int                   num_done           = 0;
+    int                   next               = 0;
+    int                   rcvd_size          = 0;
+    int                   total_samples      = 0;
+    uint32                rcvd_pkts          = 0;
+    uint32                inflight_bytes     = 0;     // Response bytes still outstanding
 
-    if ( sent_size != length ) {
-        die_with_error("Error:  Size of packet sent to request samples does not match length of packet.");
-    }
+    char                 *output_buffer;
+    char                 *rcvd_buffer        = NULL;
+    struct sockaddr_in    rcvd_address;
+    struct timespec       rcvd_stamp;
+    uint64_t              kernel_ns;
 
-//    struct timespec tsi, tsf;
+    wl_read_state        *state;
+    wl_read_state        *last               = NULL;
+    wl_read_state        *earliest;
+    wl_trans_timer        activity;                   // Timer of the last transfer that received a packet
 
-  //  clock_gettime(CLOCKTYPE, &tsi);     
+    memset( &activity, 0, sizeof( activity ) );
 
-    // Initialize loop variables
-    rcvd_pkts = 0;
-    timeout   = 0;
-    
-    // Process each return packet
-    while ( !done ) {
-        
-        // If we hit the timeout, then try to re-request the remaining samples
-        if ( timeout >= TRANSPORT_TIMEOUT ) {
-        
-            // If we hit the max number of retrys, then abort
-            if ( num_retrys >= TRANSPORT_MAX_RETRY ) {
+    // Buffer to receive ethernet packets
+    output_buffer  = get_socket_context( index )->rcvd_buffer;
 
-                printf("ERROR:  Exceeded %d retrys for current Read IQ / Read RSSI request \n", TRANSPORT_MAX_RETRY);
-                printf("    Requested %d samples from buffer %d starting from sample number %d \n", num_samples, buffer_id, start_sample);
-                printf("    Received %d out of %d packets from node before timeout.\n", rcvd_pkts, num_pkts);
-                printf("    Please check the node and look at the ethernet traffic to isolate the issue. \n");                
-            
-                die_with_error("Error:  Reached maximum number of retrys without a response... aborting.");
-                
-            } else {
+    memset( &rcvd_address, 0, sizeof( rcvd_address ) );
 
-                // NOTE:  We print a warning here because the Read IQ / Read RSSI case in the mex function above
-                //        will split Read IQ / Read RSSI requests based on the receive buffer size.  Therefore,
-                //        any timeouts we receive here should be legitmate issues that should be explored.
-                //
-                printf("WARNING:  index=%d Read IQ / Read RSSI request timed out.  Retrying remaining samples. \n", index);
-            
-                // Find the first packet error and request the remaining samples
-                if ( wl_read_iq_find_error( sample_tracker, num_samples, start_sample, rcvd_pkts, samples_per_pkt,
-                                            &err_num_samples, &err_start_sample, &err_num_pkts ) ) {
-                    
-                    command_args[1] = endian_swap_32( err_start_sample );
-                    command_args[2] = endian_swap_32( err_num_samples );
-                    command_args[4] = endian_swap_32( num_pkts - ( rcvd_pkts - err_num_pkts ) );
+    // A socket connected to one node drops the packets of any other (see connect_socket);  drop 
+    // the connection before any request goes out, so no response is sent to the old port
+    for ( i = 0; i < num_states; i++ ) {
+        wl_socket_target( index, &(states[i].address) );
+    }
 
-                    // Since there was an error in the packets we have already received, then we need to adjust rcvd_pkts
-                    rcvd_pkts        -= err_num_pkts;
-                    num_rcvd_samples  = num_samples - err_num_samples;
-                } else {
-                    // If we did not find an error, then the first rcvd_pkts are correct and we should request
-                    //   the remaining packets
-                    command_args[1] = endian_swap_32( err_start_sample );
-                    command_args[2] = endian_swap_32( err_num_samples );
-                    command_args[4] = endian_swap_32( num_pkts - rcvd_pkts );
-                }
+    // Process each return packet
+    while ( num_done < num_states ) {
 
-                // Retransmit the read IQ request packet
-                sent_size   = send_socket( index, buffer, length, ip_addr, port );
-                
-                if ( sent_size != length ) {
-                    die_with_error("Error:  Size of packet sent to request samples does not match length of packet.");
-                }
-                
-                // Update control variables
-                timeout     = 0;
-                total_cmds += 1;
-                num_retrys += 1;
-            }
+        // Send packets to request samples while the responses fit in the receive buffer
+        //   NOTE:  A group of transfers (see wl_read_group) is requested with one command
+        while ( ( next < num_states ) && 
+                ( ( max_bytes == 0 ) || ( inflight_bytes == 0 ) || 
+                  ( inflight_bytes + WL_READ_GROUP_BYTES( &states[next] ) <= max_bytes ) ) ) {
+
+            // Only sample the round trip of a command that does not queue behind another transfer of the node
+            states[next].rtt_sample = !wl_read_node_active( states, next, states[next].address.sin_addr.s_addr );
+
+            wl_read_send_group( index, &states[next] );
+            inflight_bytes += WL_READ_GROUP_BYTES( &states[next] );
+            next           += states[next].group_size;
         }
         
         // Recieve packet
-        rcvd_size = receive_socket( index, output_buffer_size, output_buffer );
-        total_rcvd_size = total_rcvd_size + rcvd_size; 
+        //   NOTE:  In batch mode, one call drains every sample packet queued on the socket and
+        //       the following calls hand them out without going back to the kernel
+        if ( wl_socket( index )->batch_mode ) {
+            rcvd_size = receive_socket_batch( index, &rcvd_buffer, &rcvd_address );
+        } else {
+            rcvd_size   = receive_socket( index, TRANSPORT_MAX_PKT_LENGTH, output_buffer );
+            rcvd_buffer = output_buffer;
+
+            if ( rcvd_size > 0 ) {
+                rcvd_address = wl_socket( index )->packet->address;
+            }
+        }
 
         // recevie_socket() handles all socket related errors and will only return:
         //   - zero if no packet is available
         //   - non-zero if packet is available
         if ( rcvd_size > 0 ) {
-            sample_hdr  = (wl_sample_header *) ( output_buffer + cmd_hdr_size );
-            samples     = (uint8 *) ( output_buffer + all_hdr_size );
-            sample_num  = endian_swap_32( sample_hdr->start );
-            sample_size = endian_swap_32( sample_hdr->num_samples );
 
-#ifdef _DEBUG_
-            printf("num_sample = %d, start_sample = %d \n", sample_size, sample_num);
-#endif
+            // Even a single transfer checks the packet:  the socket may not be connected to its node
+            state = wl_read_match( states, next, rcvd_buffer, rcvd_size, &rcvd_address, last );
 
-            // If we are tracking packets, record which samples have been recieved
-            sample_tracker[rcvd_pkts].start_sample = sample_num;
-            sample_tracker[rcvd_pkts].num_samples  = sample_size;
-            
-            // Place samples in the array (Ethernet packet is uint8, output array is uint32) 
-            //   NOTE: Need to pack samples in the correct order
-            for( i = 0; i < (4 * sample_size); i += 4 ) {
-                output_array[ sample_num + (i / 4) ] = (uint32) ( (samples[i    ] << 24) | 
-                                                                  (samples[i + 1] << 16) | 
-                                                                  (samples[i + 2] <<  8) | 
-                                                                  (samples[i + 3]      ) );
+            if ( state == NULL ) {
+                WL_STATS_ADD( index, rcvd_address.sin_addr.s_addr, read_stray_pkts, 1 );
+                continue;
+            }
+
+            rcvd_pkts = state->rcvd_pkts;
+
+            if ( wl_read_packet( index, state, rcvd_buffer, rcvd_size ) ) {
+                num_done       += 1;
+            }
+
+            // Release the receive buffer space of new packets (duplicates and stragglers take none)
+            inflight_bytes -= ( state->rcvd_pkts - rcvd_pkts ) * WL_READ_PKT_BYTES( state );
+
+            if ( state->rcvd_pkts != rcvd_pkts ) {
+                activity = state->timer;
             }
-            
-            num_rcvd_samples += sample_size;
-            rcvd_pkts        += 1;
-            timeout           = 0;
 
-            // Exit the loop when we have enough packets
-            if ( rcvd_pkts == num_pkts ) {
+            // Kernel receive time of new packets (batched receives only)
+            if ( ( state->rcvd_pkts != rcvd_pkts ) && ( state->trace.first_pkt_ns != 0 ) && wl_socket( index )->batch_mode &&
+                 get_receive_timestamp( index, &rcvd_stamp ) ) {
+
+                kernel_ns = wl_trace_kernel_ns( &rcvd_stamp );
+
+                if ( state->trace.kernel_first_ns == 0 ) {
+                    state->trace.kernel_first_ns = kernel_ns;
+                }
+                state->trace.kernel_last_ns = kernel_ns;
+            }
+
+            last = state;
             
-                // Check to see if we have any packet errors
-                //     NOTE:  This check will detect duplicate packets or sample indexing errors
-                if ( wl_read_iq_sample_error( sample_tracker, num_samples, start_sample, rcvd_pkts, samples_per_pkt ) ) {
+        } else {
 
-                    // In this case, there is probably some issue in the transmitting node not getting the
-                    // correct number of samples or messing up the indexing of the transmit packets.  
-                    // The wl_read_iq_sample_error() printed debug information, so we need to retry the packets
-                    
-                    if ( num_retrys >= TRANSPORT_MAX_RETRY ) {
-                    
-                        die_with_error("Error:  Errors in sample request from board.  Max number of re-transmissions reached.  See above for debug information.");
-                        
-                    } else {
+            // Wait for the next packet on the timer that expires first, then account the 
+            // empty receive against the timers of the other transfers in flight
+            earliest = NULL;
 
-                        // Find the first packet error and request the remaining samples
-                        if ( wl_read_iq_find_error( sample_tracker, num_samples, start_sample, rcvd_pkts, samples_per_pkt,
-                                                    &err_num_samples, &err_start_sample, &err_num_pkts ) ) {
-
-                            command_args[1] = endian_swap_32( err_start_sample );
-                            command_args[2] = endian_swap_32( err_num_samples );
-                            command_args[4] = endian_swap_32( err_num_pkts );
-
-                            // Retransmit the read IQ request packet
-                            sent_size   = send_socket( index, buffer, length, ip_addr, port );
-                            
-                            if ( sent_size != length ) {
-                                die_with_error("Error:  Size of packet sent to request samples does not match length of packet.");
-                            }
-                            
-                            // We are re-requesting err_num_pkts, so we need to subtract err_num_pkts from what we have already recieved
-                            rcvd_pkts        -= err_num_pkts;
-                            num_rcvd_samples  = num_samples - err_num_samples;
-
-                            // Update control variables
-                            timeout     = 0;
-                            total_cmds += 1;
-                            num_retrys += 1;
-                        
-                        } else {
-                            // Die since we could not find the error
-                            die_with_error("Error:  Encountered error in sample packets but could not determine the error.  See above for debug information.");
-                        }
-                    }
-                } else {
+            for ( i = 0; i < next; i++ ) {
+                if ( ( states[i].status == WL_READ_ACTIVE ) &&
+                     ( ( earliest == NULL ) || ( wl_timer_compare( &(states[i].timer), &(earliest->timer) ) < 0 ) ) ) {
+                    earliest = &states[i];
+                }
+            }
+
+            if ( earliest == NULL ) {
+                continue;
+            }
+
+            wl_timer_wait( index, &(earliest->timer) );
+
+            for ( i = 0; i < next; i++ ) {
+
+                if ( states[i].status != WL_READ_ACTIVE ) {
+                    continue;
+                }
+
+                if ( &states[i] != earliest ) {
+                    wl_timer_check( &(states[i].timer) );
+                }
 
-                    done = 1;
+                // If we hit the timeout, then try to re-request the remaining samples
+                //   NOTE:  The packets of a transfer may be queued behind the packets of other transfers 
+                //       (at the node or on the host), so it only times out once the socket has not 
+                //       received a new packet for a timeout either
+                if ( states[i].timer.expired ) {
+                    if ( wl_timer_compare( &activity, &(states[i].timer) ) > 0 ) {
+                        states[i].timer = activity;
+                    } else {
+                        wl_read_timeout( index, &states[i] );
+                    }
                 }
             }
-            
-        } else {
-        
-            // Increment the timeout counter
-            timeout += 1;            
-            
         }  // END if ( rcvd_size > 0 )
         
-    }  // END while( !done )
-
-   // clock_gettime(CLOCKTYPE, &tsf);     
+    }  // END while( num_done < num_states )
 
-    // double elaps_s = difftime(tsf.tv_sec, tsi.tv_sec);
-    // long elaps_ns = tsf.tv_nsec - tsi.tv_nsec;
-    // printf("%f\n",  (elaps_s*1000 + ((double)elaps_ns)/1.0e6)); // in milliseconds
-
-    // printf("%d packets, %f ms, start %f bytes, last %d bytes\n", rcvd_pkts, ((elaps_s*1000 + ((double)elaps_ns)/1.0e6)), ((double) total_rcvd_size - rcvd_size)/(rcvd_pkts-1), rcvd_size); // in milliseconds
-
-    
-    // Free locally allocated memory    
-    free( output_buffer );    
-    free( sample_tracker ); 
-
-    // Finalize outputs   
-    *num_cmds  += total_cmds;
+    for ( i = 0; i < num_states; i++ ) {
+        total_samples += states[i].num_rcvd_samples;
+    }
     
-    return num_rcvd_samples;
+    return total_samples;
 }
 
 
 
 /*****************************************************************************/
 /**
-*  Function:  Read IQ sample check
+*  Function:  wl_read_trace
 *
-*  Function to check if we received all the samples at the correct indecies
-*
-*  Returns:  0 if no errors
-*            1 if if there is an error and prints debug information
+*  Commits the trace record of the Read IQ of one node:  the num_chunks 
+*  groups of transfers states[0], states[stride], ... of group transfers each 
+*  (one per buffer, see readSamplesMulti)
 *
 ******************************************************************************/
-int wl_read_iq_sample_error( wl_sample_tracker *tracker, uint32 num_samples, uint32 start_sample, uint32 num_pkts, uint32 max_sample_size ) {
+void wl_read_trace( int index, wl_read_state *states, int num_chunks, int stride, int group, struct timespec *start_time ) {
 
-    int i;
-    unsigned int start_sample_total;
+    int                   i;
+    uint64_t              end_ns             = 0;
+    wl_read_state        *state;
+    wl_trace_record       record;
 
-    unsigned int num_samples_sum  = 0;
-    unsigned int start_sample_sum = 0;
+    wl_trace_begin( &record, WL_TRACE_OP_READ, index, states[0].address.sin_addr.s_addr, wl_trace_ns( start_time ) );
 
-    // Compute the value of the start samples:
-    //   We know that the start samples should follow the pattern:
-    //       [ x, (x + y), (x + 2y), (x + 3y), ... , (x + (N - 1)y) ]
-    //   where x = start_sample, y = max_sample_size, and N = num_pkts.  This is due
-    //   to the fact that the node will fill all packets completely except the last packet.
-    //   Therefore, the sum of all element in that array is:
-    //       (N * x) + ((N * (N -1 ) * Y) / 2
+    for ( i = 0; i < num_chunks * group; i++ ) {
 
-    start_sample_total = (num_pkts * start_sample) + (((num_pkts * (num_pkts - 1)) * max_sample_size) >> 1); 
-    
-    // Compute the totals using the sample tracker
-    for( i = 0; i < num_pkts; i++ ) {
-    
-        num_samples_sum  += tracker[i].num_samples;
-        start_sample_sum += tracker[i].start_sample;
-    }
+        state = &states[( i / group ) * stride + ( i % group )];
 
-    // Check the totals
-    if ( ( num_samples_sum != num_samples ) || ( start_sample_sum != start_sample_total ) ) {
-    
-        // Print warning debug information if there is an error
-        if ( num_samples_sum != num_samples ) { 
-            printf("WARNING:  Number of samples received (%d) does not equal number of samples requested (%d).  \n", num_samples_sum, num_samples);
-        } else {
-            printf("WARNING:  Sample packet indecies not correct.  Expected the sum of sample indecies to be (%d) but received a sum of (%d).  Retrying ...\n", start_sample_total, start_sample_sum);
-        }
-        
-        // Print debug information
-        printf("Packet Tracking Information: \n");
-        printf("    Requested Samples:  Number: %8d    Start Sample: %8d  \n", num_samples, start_sample);
-        printf("    Received  Samples:  Number: %8d  \n", num_samples_sum);
-        
-        for ( i = 0; i < num_pkts; i++ ) {
-            printf("         Packet[%4d]:   Number: %8d    Start Sample: %8d  \n", i, tracker[i].num_samples, tracker[i].start_sample );
-        }
+        wl_trace_merge( &record, &(state->trace) );
 
-        return 1;
-    } else {
-        return 0;
+        record.num_samples    += state->num_rcvd_samples;
+        record.num_pkts       += state->rcvd_pkts;
+        record.num_cmds       += state->num_cmds;
+        record.retrans_rounds += state->num_retrys;
+
+        if ( wl_trace_ns( &(state->done_time) ) > end_ns ) {
+            end_ns = wl_trace_ns( &(state->done_time) );
+        }
     }
+
+    wl_trace_commit( &record, end_ns );
 }
 
 
 
 /*****************************************************************************/
 /**
-*  Function:  Read IQ find first error
+*  Function:  wl_read_budget
 *
-*  Function to check if we received all the samples at the correct indecies.
-*  This will also update the ret_* parameters to indicate values to use when 
-*  requesting a new set of packets.
+*  Returns the receive buffer budget (in bytes) of Read IQ responses on a 
+*  socket:  90% of the receive buffer the OS actually gave the socket, since 
+*  the OS may clamp the size requested in nodes_initialize()
 *
-*  Returns:  0 if no error was found
-*            1 if an error was found
+*  NOTE:  This is integer division so the receive buffer size will be truncated 
+*      by the divide
 *
 ******************************************************************************/
-int wl_read_iq_find_error( wl_sample_tracker *tracker, uint32 num_samples, uint32 start_sample, uint32 num_pkts, uint32 max_sample_size,
-                           uint32 *ret_num_samples, uint32 *ret_start_sample, uint32 *ret_num_pkts ) {
-
-    unsigned int i, j;
-
-    unsigned int value_found;
-    unsigned int return_value            = 1;
-    unsigned int start_sample_to_request = start_sample;
-    unsigned int num_samples_left        = num_samples;
-    unsigned int num_pkts_left           = num_pkts;
-
-    // Iterate thru the array to find the first index that does not match the expected value
-    //     NOTE:  This is performing a naive search and could be optimized.  Since we are 
-    //         already in an error condition, we chose simplicity over performance.
-    
-    for( i = 0; i < num_pkts; i++ ) {
-    
-        value_found = 0;
-    
-        // Find element in the array   
-        for ( j = 0; j < num_pkts; j ++ ) {
-            if ( start_sample_to_request == tracker[i].start_sample ) {
-                value_found = 1;
-            }            
-        }
+uint32 wl_read_budget( int index ) {
 
-        // If we did not finde the value, then exit the loop
-        if ( !value_found ) {
-            break;
-        }
-        
-        // Update element to search for
-        start_sample_to_request += max_sample_size;
-        num_samples_left        -= max_sample_size;
-        num_pkts_left           -= 1;
+    if ( wl_socket( index )->rx_buffer_size == 0 ) {
+        get_receive_buffer_size( index );
     }
 
-    // Set the return value
-    if ( num_pkts_left == 0 ) {
-        return_value  = 0;
-    } 
-        
-    // Return parameters
-    *ret_start_sample = start_sample_to_request;
-    *ret_num_samples  = num_samples_left;
-    *ret_num_pkts     = num_pkts_left;
-    
-    return return_value;
+    return 9 * ( wl_socket( index )->rx_buffer_size / 10 );
 }
 
 
@@ -1499,6 +3619,56 @@ int wl_write_baseband_buffer( int index,
                               int num_samples, int start_sample, uint16 *samples_i, uint16 *samples_q, uint32 buffer_id,
                               int num_pkts, int max_samples, int hw_ver, uint32 *num_cmds ) {
 
+    int     i;
+    uint32 *samples_iq = get_socket_context( index )->samples_iq;
+
+    if ( num_samples > get_socket_context( index )->max_samples ) { 
+        die_with_error("Error:  Write IQ request exceeds the socket context"); 
+    }
+
+    // Pack I and Q in to sample words
+    for( i = 0; i < num_samples; i++ ) {
+        samples_iq[i] = ( (uint32) samples_i[i] << 16 ) | samples_q[i];
+    }
+
+    return wl_write_baseband_samples( index, buffer, max_length, ip_addr, port, num_samples, start_sample, 
+                                      WL_SAMPLE_RAW32, samples_iq, buffer_id, num_pkts, max_samples, hw_ver, num_cmds );
+}
+
+
+/*****************************************************************************/
+/**
+* This function will write the baseband buffers, encoding the samples straight
+* from an input array of the given format in to each packet (see 
+* wl_write_baseband_samples), or sending the packets of a pre-encoded waveform
+* (see wl_write_baseband_waveform)
+*
+* @param	index          - Index in to socket structure which will receive samples
+* @param	buffer         - WARPLab command (includes transport header and command header)
+* @param	max_length     - Length (in bytes) max data packet to send (Ethernet MTU size - Ethernet header)
+* @param    ip_addr        - IP Address of node to retrieve samples
+* @param    port           - Port of node to retrieve samples
+* @param    num_samples    - Number of samples to process (should be the same as the argument in the WARPLab command)
+* @param    start_sample   - Index of starting sample (should be the same as the agrument in the WARPLab command)
+* @param    format         - Format of the sample array (WL_SAMPLE_*)
+* @param    samples        - Array of samples to be sent
+* @param    waveform       - Pre-encoded waveform to be sent instead of samples (NULL if none)
+* @param    buffer_id      - Which buffer(s) do we need to send samples to (all dimensionality of buffer_ids is handled by Matlab)
+* @param    num_pkts       - Number of packets to transfer (precomputed by calling SW)
+* @param    max_samples    - Max samples to send per packet (precomputed by calling SW)
+* @param    hw_ver         - Hardware version of node
+* @param    num_cmds       - Return parameter - number of ethernet send commands used to request packets 
+*                                (could be > 1 if there are transmission errors)
+*
+* @return	samples_sent   - Number of samples processed 
+*
+******************************************************************************/
+static int wl_write_baseband_packets( int index, 
+                                      char *buffer, int max_length, char *ip_addr, int port,
+                                      int num_samples, int start_sample, int format, const void *samples, 
+                                      const wl_waveform *waveform, uint32 buffer_id,
+                                      int num_pkts, int max_samples, int hw_ver, uint32 *num_cmds ) {
+
     // Variable declaration
     int i, j;
     int                   done              = 0;
@@ -1507,14 +3677,26 @@ int wl_write_baseband_buffer( int index,
     int                   sample_num        = 0;
     int                   offset            = 0;
     int                   need_resp         = 0;
-    int                   slow_write        = 0;
     uint16                transport_flags   = 0;
-    uint32                timeout           = 0;
+    wl_trans_timer        timer;
     int                   buffer_count      = 0;
 
     // Packet checksum tracking
     uint32                checksum          = 0;
     uint32                node_checksum     = 0;
+    uint32                resp_checksum     = 0;      // Checksum before the packet waiting for a response
+    uint32                resp_copies       = 0;      // Copies of that packet sent (retransmissions)
+    uint16                resp_seq_num      = 0;      // Sequence number of the last copy
+    uint32                candidate         = 0;
+    uint16                last_sample       = 0;      // I ^ Q of the last sample sent
+
+    // Checkpoints (packets sent with TRANSPORT_FLAG_ROBUST, see TRANSPORT_WRITE_WINDOW_MAX)
+    int                   window            = wl_socket( index )->write_window;   // Packets per checkpoint
+    int                   ckpt_pkt          = 0;      // First packet after the last good checkpoint
+    int                   ckpt_offset       = 0;      // First sample of that packet
+    int                   reset_pkt         = 0;      // Packet that resets the node checksum
+    int                   num_resumes       = 0;      // Resumes from the last good checkpoint (total)
+    int                   ckpt_resumes      = 0;      // Resumes since the last good checkpoint
 
     // Keep track of packet sequence number
     uint16                seq_num           = 0;
@@ -1524,18 +3706,43 @@ int wl_write_baseband_buffer( int index,
     int                   rcvd_size         = 0;
     int                   rcvd_max_size     = 100;
     int                   num_retrys        = 0;
+    uint32                backoff           = 0;      // Timeouts since the last response
+    uint32                idle_us           = 0;      // Time spent in those timeouts
+    int                   resent            = 0;      // The packet waiting for a response was retransmitted
+    struct timespec       resp_send_time;             // Time the packet waiting for a response was sent
+    struct timespec       resp_time;
+    int64_t               rtt_ns;
     unsigned char        *rcvd_buffer;
     uint32               *command_args;
 
-    // Buffer of data for ethernet packet and pointers to components of the packet
-    unsigned char        *send_buffer;
+    // Packet headers / payload and pointers to components of the packet
+    char                 *write_hdrs;
+    uint8                *write_payload;
+    char                 *hdr;
+    wl_trans_sg_pkt       pkts[TRANSPORT_MAX_SEND_BATCH];   // Packets waiting to be sent
+    int                   num_batch         = 0;
+    int                   batch_length      = 0;
     wl_transport_header  *transport_hdr;
     wl_command_header    *command_hdr;
     wl_sample_header     *sample_hdr;
-    uint32               *sample_payload;
-
-    // Sleep timer
-    uint32                wait_time;
+    uint8                *sample_payload;
+
+    // Pacing (see wl_pacer_send)
+    uint32                wait_time         = 0;      // Gap (in us) the node needs between packets
+    wl_trans_pacer        pacer;
+    uint32                pace_us;                    // Time until the packet waiting for a response leaves the host
+    uint64_t              wait_ns;
+
+    // Node address (resolved once for all packets)
+    struct sockaddr_in    address;
+    uint32                node_address      = 0;
+    struct timespec       start_time;
+    struct timespec       end_time;
+
+    // Trace record (see warp_trace.h)
+    int                   tracing           = wl_trace_enabled();
+    uint64_t              trace_ns          = 0;
+    wl_trace_record       record;
         
     // Compute some constants to be used later
     uint32                tport_hdr_size    = sizeof( wl_transport_header );
@@ -1554,43 +3761,54 @@ int wl_write_baseband_buffer( int index,
 #endif
 
     // Initialization
+    clock_gettime( CLOCKTYPE, &start_time );
 
-    // Malloc temporary buffer to receive ethernet packets    
-    // rcvd_buffer  = (unsigned char *) malloc( sizeof( char ) * rcvd_max_size );
- 
-    {
-    
-    rcvd_buffer  = (unsigned char *) calloc(rcvd_max_size, sizeof (char));
-    if( rcvd_buffer == NULL ) { die_with_error("Error:  Could not allocate temp receive buffer"); }
+    wl_resolve_address( ip_addr, port, &address );
+    node_address   = address.sin_addr.s_addr;
 
-    // printf("index %d :rcvd_buffer address = %x to %x\n", index, rcvd_buffer, rcvd_buffer +  rcvd_max_size*sizeof(char)-1 );
+    if ( tracing ) {
+        wl_trace_begin( &record, WL_TRACE_OP_WRITE, index, node_address, wl_trace_ns( &start_time ) );
+    }
 
-    // Malloc temporary buffer to process ethernet packets    
-    // send_buffer  = (unsigned char *) malloc( sizeof( char ) * max_length );
-    send_buffer  = (unsigned char *) calloc( max_length, sizeof(char));
+    // Use the preallocated packet buffers of the socket
+    rcvd_buffer    = (unsigned char *) get_socket_context( index )->rcvd_buffer;
+    write_hdrs     = get_socket_context( index )->write_hdrs;
+    write_payload  = get_socket_context( index )->write_payload;
 
-    // printf("index %d :send_buffer address = %x to %x\n", index, send_buffer, send_buffer +  max_length*sizeof(char)-1 );
-    
-    if( send_buffer == NULL ) { die_with_error("Error:  Could not allocate temp send buffer"); }
-    for( i = 0; i < cmd_hdr_size; i++ ) { send_buffer[i] = buffer[i]; }     // Copy current header to send buffer 
+    if ( max_length > TRANSPORT_MAX_PKT_LENGTH ) { die_with_error("Error:  Write IQ packet length exceeds TRANSPORT_MAX_PKT_LENGTH"); }
+
+    // Copy current header to the header of each packet in a batch
+    for( i = 0; i < TRANSPORT_MAX_SEND_BATCH; i++ ) { 
+        memcpy( write_hdrs + ( i * TRANSPORT_MAX_HDR_LENGTH ), buffer, cmd_hdr_size );
+    }
 
-    }    
     // printf("cmd_hdr_size = %d, all_hdr_size = %d\n", cmd_hdr_size, all_hdr_size);
 
-    // Set up pointers to all the pieces of the ethernet packet    
-    transport_hdr  = (wl_transport_header *) send_buffer;
-    command_hdr    = (wl_command_header   *) ( send_buffer + tport_hdr_size );
-    sample_hdr     = (wl_sample_header    *) ( send_buffer + cmd_hdr_size   );
-    sample_payload = (uint32              *) ( send_buffer + all_hdr_size   );
+    // Encode all the samples once (see warp_kernels.c);  packets are sent from slices of the payload
+    if ( waveform != NULL ) {
+        write_payload = waveform->payload;
+    } else {
+        if ( ( num_samples - start_sample ) > get_socket_context( index )->max_samples ) { 
+            die_with_error("Error:  Write IQ request exceeds the socket context"); 
+        }
+
+        if ( tracing ) { trace_ns = wl_trace_now(); }
+
+        wl_encode_samples( format, write_payload, samples, start_sample, num_samples - start_sample );
+
+        if ( tracing ) { record.encode_ns += wl_trace_now() - trace_ns; }
+    }
+
+    transport_hdr  = (wl_transport_header *) write_hdrs;
 
     // Get necessary values from the packet buffer so we can send multiple packets
     seq_num         = endian_swap_16( transport_hdr->seq_num ) + 1;    // Current sequence number is from the last packet
     transport_flags = endian_swap_16( transport_hdr->flags );
 
     // Initialize loop variables
-    slow_write    = 0;
     need_resp     = 0;
     offset        = start_sample;
+    ckpt_offset   = start_sample;
     seq_start_num = seq_num;
 
     // gkchai
@@ -1600,6 +3818,85 @@ int wl_write_baseband_buffer( int index,
     // clock_gettime(CLOCKTYPE, &tsi);
 
     
+    // This function can saturate the ethernet wire.  However, for small packets the 
+    // node cannot keep up and therefore we need to space the packets (see wl_pacer_send) based on:
+    // 1) packet size and 2) number of buffers being written
+    
+    // NOTE:  This is a simplified implementation based on experimental data.  It is by no means optimized for 
+    //     all cases.  Since WARP v2 and WARP v3 hardware have drastically different internal architectures,
+    //     we first have to understand which HW the Write IQ is being performed and scale the wait_times
+    //     accordingly.  Also, since we can have one transmission of IQ data be distributed to multiple buffers,
+    //     we need to increase the timeout if we are transmitting to more buffers on the node in order to 
+    //     compensate for the extended processing time.  One other thing to note is that if you view the traffic that
+    //     this generates on an oscilloscope (at least on Window 7 Professional 64-bit), it is not necessarily regular 
+    //     but will burst 2 or 3 packets followed by an extended break.  Fortunately there is enough buffering in 
+    //     the data flow that this does not cause a problem, but it makes it more difficult to optimize the data flow 
+    //     since we cannot guarentee the timing of the packets at the node.  
+    //
+    //     If you start receiving checksum failures and need to adjust timing, please do so in the code below
+    //     (or set a target rate with set_write_pacing).
+    //
+    switch ( hw_ver ) {
+        case TRANSPORT_WARP_HW_v2:
+            // WARP v2 Hardware only supports small ethernet packets
+ 
+            buffer_count = 0;
+
+            // Count the number of buffers in the buffer_id
+            for( j = 0; j < TRANSPORT_WARP_RF_BUFFER_MAX; j++ ) {
+                if ( ( ( buffer_id >> j ) & 0x1 ) == 1 ) {
+                    buffer_count++;
+                }
+            }
+        
+            // Note:  Performance drops dramatically if this number is smaller than the processing time on
+            //     the node.  This is due to the fact that you resend a window when the checksum fails.  
+            //     For example, if you change this from 160 to 140, the Avg Write IQ per second goes from
+            //     ~130 to ~30.  If this number gets too large, then you will also degrade performance
+            //     given you are waiting longer than necessary.
+            //
+            // Currently, wait times are set at:
+            //     1 buffer  = 160 us
+            //     2 buffers = 240 us
+            //     3 buffers = 320 us
+            //     4 buffers = 400 us
+            // 
+            // This is due to the fact that processing on the node is done thru a memcpy and takes 
+            // a fixed amount of time longer for each additonal buffer that is transferred.
+            //                
+            wait_time = 80 + ( buffer_count * 80 );
+        break;
+        
+        case TRANSPORT_WARP_HW_v3:
+            // In WARP v3 hardware, we need to account for both small packets as well as jumbo frames.  Also,
+            // since the WARP v3 hardware uses a DMA to transfer packet data, the processing overhead is much
+            // less than on v2 (hence the smaller wait times).  Through experimental testing, we found that 
+            // for jumbo frames, the processing overhead was smaller than the length of the ethernet transfer
+            // and therefore we do not need to wait at all.  We have not done exhaustive testing on ethernet 
+            // packet size vs wait time.  So in this simplified implementation, if your Ethernet MTU size is 
+            // less than 9000 bytes (ie approximately 0x8B8 samples) then we will insert a 40 us, or 50 us, 
+            // delay between transmissions to give the board time to keep up with the flow of packets.
+            // 
+            if ( max_samples < 0x800 ) {
+
+                // printf("introducing delay ! \n");
+                if ( buffer_id == 0xF ) {
+                    wait_time = 50;
+                } else {
+                    wait_time = 40;
+                }
+            }
+         break;
+         
+         default:
+            printf("WARNING:  HW version of node (%d) is not recognized.  Please check your setup.\n", hw_ver);
+            wait_time = 0;
+         break;
+    }
+
+    // Packets may leave right away
+    wl_pacer_start( &pacer );
+
     // For each packet
     for( i = 0; i < num_pkts; i++ ) {
     
@@ -1613,8 +3910,15 @@ int wl_write_baseband_buffer( int index,
         // Determine the length of the packet (All WARPLab payload minus the padding for word alignment)
         length = all_hdr_size_np + (sample_num * sizeof( uint32 ));
 
-        // Request that the board respond to the last packet or all packets if slow_write = 1
-        if ( ( i == ( num_pkts - 1 ) ) || ( slow_write == 1 ) ) {
+        // Set up pointers to all the pieces of the ethernet packet
+        hdr            = write_hdrs + ( num_batch * TRANSPORT_MAX_HDR_LENGTH );
+        transport_hdr  = (wl_transport_header *) hdr;
+        command_hdr    = (wl_command_header   *) ( hdr + tport_hdr_size );
+        sample_hdr     = (wl_sample_header    *) ( hdr + cmd_hdr_size   );
+        sample_payload = write_payload + ( ( offset - start_sample ) * sizeof( uint32 ) );
+
+        // Request that the board respond to the last packet and to the last packet of each window
+        if ( ( i == ( num_pkts - 1 ) ) || ( ( i - ckpt_pkt + 1 ) >= window ) ) {
             need_resp       = 1;
             transport_flags = transport_flags | TRANSPORT_FLAG_ROBUST;
         } else {
@@ -1641,30 +3945,69 @@ int wl_write_baseband_buffer( int index,
         
         // Prepare sample packet
         sample_hdr->buffer_id   = endian_swap_16( buffer_id );
-        if ( i == 0 ) {
+        if ( i == reset_pkt ) {
             sample_hdr->flags   = SAMPLE_CHKSUM_RESET;
         } else {
             sample_hdr->flags   = SAMPLE_CHKSUM_NOT_RESET;        
         }
-        sample_hdr->start       = endian_swap_32( offset );
-        sample_hdr->num_samples = endian_swap_32( sample_num );
-
-        // Copy the appropriate samples to the packet
-        for( j = 0; j < sample_num; j++ ) {
-				
-				
-            sample_payload[j] =  endian_swap_32( ( samples_i[j + offset] << 16 ) + samples_q[j + offset] );    
+
+        if ( waveform != NULL ) {
+            sample_hdr->start       = waveform->sample_hdrs[i].start;
+            sample_hdr->num_samples = waveform->sample_hdrs[i].num_samples;
+            last_sample             = waveform->last_samples[i];
+        } else {
+            sample_hdr->start       = endian_swap_32( offset );
+            sample_hdr->num_samples = endian_swap_32( sample_num );
+
+            if ( sample_num > 0 ) {
+                last_sample = ( ( sample_payload[4 * sample_num - 4] << 8 ) | sample_payload[4 * sample_num - 3] ) ^
+                              ( ( sample_payload[4 * sample_num - 2] << 8 ) | sample_payload[4 * sample_num - 1] );
+            }
         }
 
         // Add back in the padding so we can send the packet
         length += TRANSPORT_PADDING_SIZE;
 
-        // Send packet 
-        sent_size = send_socket( index, (char *) send_buffer, length, ip_addr, port );
+        // Queue the packet:  the headers and the slice of the payload are gathered by the kernel
+        pkts[num_batch].hdr            = hdr;
+        pkts[num_batch].hdr_length     = all_hdr_size;
+        pkts[num_batch].payload        = (char *) sample_payload;
+        pkts[num_batch].payload_length = length - all_hdr_size;
+
+        num_batch    += 1;
+        batch_length += length;
 
-        if ( sent_size != length ) {
-            die_with_error("Error:  Size of packet sent to with samples does not match length of packet.");
+        // Send the queued packets at their departure times at the end of a window (or when the batch is full)
+        if ( ( need_resp == 1 ) || ( num_batch == TRANSPORT_MAX_SEND_BATCH ) ) {
+
+            if ( tracing ) { 
+                trace_ns = wl_trace_now();
+                wait_ns  = pacer.wait_ns;
+            }
+
+            sent_size = wl_pacer_send( index, &pacer, pkts, num_batch, &address, wait_time );
+
+            if ( sent_size != batch_length ) {
+                die_with_error("Error:  Size of packet sent to with samples does not match length of packet.");
+            }
+
+            if ( tracing ) {
+                record.pace_ns  += pacer.wait_ns - wait_ns;
+                record.send_ns  += ( wl_trace_now() - trace_ns ) - ( pacer.wait_ns - wait_ns );
+                record.num_pkts += num_batch;
+
+                for ( j = 0; ( j < num_batch ) && ( record.num_pkt_times < WL_TRACE_MAX_PKTS ); j++ ) {
+                    record.pkt_send_ns[record.num_pkt_times++] = pkts[j].txtime_ns;
+                }
+            }
+
+            num_batch    = 0;
+            batch_length = 0;
         }
+
+        if ( tracing ) { record.num_cmds += need_resp; }
+
+        WL_STATS_ADD( index, node_address, write_cmds, 1 );
         
         // Update loop variables
         offset   += sample_num;
@@ -1677,15 +4020,20 @@ int wl_write_baseband_buffer( int index,
         //     zero or all one.  Therefore, we add in the start sample for each packet since that 
         //     is readily availalbe on the node.
         //
-        if ( i == 0 ) {
-            checksum = wl_update_checksum( ( ( offset - sample_num ) & 0xFFFF ), SAMPLE_CHKSUM_RESET, index ); 
-        } else {
-            checksum = wl_update_checksum( ( ( offset - sample_num ) & 0xFFFF ), SAMPLE_CHKSUM_NOT_RESET, index ); 
+        //     A retransmitted packet is counted once here;  the node counts every copy it receives
+        //     (see the response check below).
+        //
+        if ( !resent ) {
+            resp_checksum = ( i == reset_pkt ) ? 0 : checksum;
+            resp_copies   = 0;
         }
 
-        checksum = wl_update_checksum( ( samples_i[offset - 1] ^ samples_q[offset - 1] ), SAMPLE_CHKSUM_NOT_RESET, index );
+        checksum      = wl_checksum_add( resp_checksum, ( ( offset - sample_num ) & 0xFFFF ) );
+        checksum      = wl_checksum_add( checksum, last_sample );
+        resp_copies  += 1;
+        resp_seq_num  = seq_num - 1;
 
-        // printf("Index %d offset %d Packet %d sampI %d sampQ %d Calculated Checksum = %x \n", index, offset, i,  samples_i[offset - 1], samples_q[offset - 1], checksum);
+        // printf("Index %d offset %d Packet %d samp %x Calculated Checksum = %x \n", index, offset, i, last_sample, checksum);
 
         
         // If we need a response, then wait for it
@@ -1699,24 +4047,37 @@ int wl_write_baseband_buffer( int index,
             // printf("%f\n",  (elaps_s*1000 + ((double)elaps_ns)/1.0e6)); // in milliseconds
 
             // Initialize loop variables
-            timeout   = 0;
+            //   NOTE:  With SO_TXTIME pacing the packet may still be queued on the host
+            pace_us = wl_pacer_pending_us( &pacer );
+
+            clock_gettime( CLOCK_MONOTONIC, &resp_send_time );
+            wl_timer_start( &timer, wl_timeout_us( index, node_address, WL_RTT_WRITE, backoff ) + pace_us );
             done      = 0;
             rcvd_size = 0;
+
+            if ( tracing ) { trace_ns = wl_trace_now(); }
             
             // Process each return packet
             while ( !done ) {
 
                 // If we hit the timeout, then try to re-transmit the packet
-                if ( timeout >= TRANSPORT_TIMEOUT) {
+                if ( timer.expired ) {
+
+                    idle_us += timer.timeout_us;
                 
-                    // If we hit the max number of retrys, then abort
-                    if ( num_retrys >= TRANSPORT_MAX_RETRY ) {
+                    // If the node has not answered for TRANSPORT_GIVE_UP_MS (over timeouts backed off up to the maximum), then abort
+                    if ( idle_us >= 1000 * TRANSPORT_GIVE_UP_MS ) {
                          // free( send_buffer );
                          // free( rcvd_buffer );
-                        die_with_error("Error:  Reached maximum number of retrys without a response... aborting.");                    
+                        die_with_error("Error:  Reached maximum time without a response... aborting.");                    
                     } else {
-                        // Roll everything back and retransmit the packet
+                        // Roll everything back and retransmit the packet (with a doubled timeout and a
+                        // halved window)
                         num_retrys += 1;
+                        backoff    += 1;
+                        resent      = 1;
+                        window      = ( window > 1 ) ? ( window / 2 ) : 1;
+                        WL_STATS_ADD( index, node_address, write_timeouts, 1 );
                         offset     -= sample_num;
                         i          -= 1;
                         break;
@@ -1729,113 +4090,84 @@ int wl_write_baseband_buffer( int index,
                 if ( rcvd_size > 0 ) {
                     command_args   = (uint32 *) ( rcvd_buffer + cmd_hdr_size );    
                     node_checksum  = endian_swap_32( command_args[0] );
+
+                    // Drop responses to earlier copies of the packet;  only the response to the last
+                    // copy tells how many copies the node counted
+                    if ( endian_swap_16( ( (wl_transport_header *) rcvd_buffer )->seq_num ) != resp_seq_num ) {
+                        continue;
+                    }
+
+                    // The node counted between one and resp_copies copies of a retransmitted packet
+                    candidate = checksum;
+
+                    for ( j = 1; ( j < resp_copies ) && ( node_checksum != candidate ); j++ ) {
+                        candidate = wl_checksum_add( wl_checksum_add( candidate, ( ( offset - sample_num ) & 0xFFFF ) ), last_sample );
+                    }
+
+                    if ( node_checksum == candidate ) {
+                        checksum = candidate;
+                    }
+
+                    // Round trip of the packet (Karn's algorithm:  not if it was retransmitted)
+                    if ( !resent ) {
+                        clock_gettime( CLOCK_MONOTONIC, &resp_time );
+
+                        rtt_ns = ( (int64_t) ( resp_time.tv_sec - resp_send_time.tv_sec ) * 1000000000LL ) + ( resp_time.tv_nsec - resp_send_time.tv_nsec );
+                        rtt_ns = rtt_ns - ( 1000LL * pace_us );
+
+                        if ( rtt_ns > 0 ) {
+                            wl_rtt_sample( node_address, WL_RTT_WRITE, (uint32) ( rtt_ns / 1000 ) );
+                        }
+                    }
+
+                    backoff        = 0;
+                    idle_us        = 0;
+                    resent         = 0;
                     // printf("Debug:  Checksums Expected = %x  Received = %x \n", checksum, node_checksum);
 
                     // Compare the checksum values
                     if ( node_checksum != checksum ) {
+
+                        WL_STATS_ADD( index, node_address, write_chksum_errors, 1 );
                     
-                        // If we have a checksum error in fast write mode, then switch to slow write and start over
-                        if ( slow_write == 0 ) {
-                            printf("WARNING:  Checksums do not match on pkt %d, index = %d, rcvd_size = %d.  Expected = %x  Received = %x \n", i, index, rcvd_size, checksum, node_checksum);
-                            printf("          Starting over with slow write.  If this message occurs frequently, please \n");
-                            printf("          adjust the wait_time in wl_write_baseband_buffer().  The node might not \n");
-                            printf("          be able to keep up with the current rate of packets. \n");
-                            
-                            slow_write = 1;
-                            offset     = start_sample;
-                            i          = -1;
+                        // A packet of the window was lost (or reordered):  resend the window with a halved 
+                        // window size, resetting the node checksum on its first packet
+                        //   NOTE:  The node answered the checkpoint after handling every packet that reached
+                        //       it, so only the resent packets count towards the new checksum.
+                        if ( ckpt_resumes < TRANSPORT_WRITE_MAX_RESUMES ) {
+                            printf("WARNING:  Checksums do not match on pkt %d, index = %d.  Expected = %x  Received = %x.  Resuming from pkt %d. \n", i, index, checksum, node_checksum, ckpt_pkt);
+
+                            num_resumes  += 1;
+                            ckpt_resumes += 1;
+                            window        = ( window > 1 ) ? ( window / 2 ) : 1;
+                            offset        = ckpt_offset;
+                            reset_pkt     = ckpt_pkt;
+                            i             = ckpt_pkt - 1;
+                            WL_STATS_ADD( index, node_address, write_resumes, 1 );
                             break;
                         } else {
-                            die_with_error("Error:  Checksums do not match when in slow write... aborting.");
+                            die_with_error("Error:  Checksums do not match after resuming from the last checkpoint... aborting.");
                         }
                     }
+
+                    // Checkpoint is good;  grow the window by a packet
+                    ckpt_pkt      = i + 1;
+                    ckpt_offset   = offset;
+                    ckpt_resumes  = 0;
+
+                    if ( window < TRANSPORT_WRITE_WINDOW_MAX ) {
+                        window   += 1;
+                    }
                     
-                    timeout = 0;
 	                done    = 1;
                 } else {
-                    // If we do not have a packet, increment the timeout counter
-                    timeout++;
+                    // If we do not have a packet, wait for one (increments the timeout counter when spinning)
+                    wl_timer_wait( index, &timer );
                 }
             }  // END while( !done )
-        }  // END if need_resp
-        
-        // This function can saturate the ethernet wire.  However, for small packets the 
-        // node cannot keep up and therefore we need to delay the next transmission based on:
-        // 1) packet size and 2) number of buffers being written
-        
-        // NOTE:  This is a simplified implementation based on experimental data.  It is by no means optimized for 
-        //     all cases.  Since WARP v2 and WARP v3 hardware have drastically different internal architectures,
-        //     we first have to understand which HW the Write IQ is being performed and scale the wait_times
-        //     accordingly.  Also, since we can have one transmission of IQ data be distributed to multiple buffers,
-        //     we need to increase the timeout if we are transmitting to more buffers on the node in order to 
-        //     compensate for the extended processing time.  One other thing to note is that if you view the traffic that
-        //     this generates on an oscilloscope (at least on Window 7 Professional 64-bit), it is not necessarily regular 
-        //     but will burst 2 or 3 packets followed by an extended break.  Fortunately there is enough buffering in 
-        //     the data flow that this does not cause a problem, but it makes it more difficult to optimize the data flow 
-        //     since we cannot guarentee the timing of the packets at the node.  
-        //
-        //     If you start receiving checksum failures and need to adjust timing, please do so in the code below.
-        //
-        switch ( hw_ver ) {
-            case TRANSPORT_WARP_HW_v2:
-                // WARP v2 Hardware only supports small ethernet packets
- 
-                buffer_count = 0;
-
-                // Count the number of buffers in the buffer_id
-                for( j = 0; j < TRANSPORT_WARP_RF_BUFFER_MAX; j++ ) {
-                    if ( ( ( buffer_id >> j ) & 0x1 ) == 1 ) {
-                        buffer_count++;
-                    }
-                }
-            
-                // Note:  Performance drops dramatically if this number is smaller than the processing time on
-                //     the node.  This is due to the fact that you perform a slow write when the checksum fails.  
-                //     For example, if you change this from 160 to 140, the Avg Write IQ per second goes from
-                //     ~130 to ~30.  If this number gets too large, then you will also degrade performance
-                //     given you are waiting longer than necessary.
-                //
-                // Currently, wait times are set at:
-                //     1 buffer  = 160 us
-                //     2 buffers = 240 us
-                //     3 buffers = 320 us
-                //     4 buffers = 400 us
-                // 
-                // This is due to the fact that processing on the node is done thru a memcpy and takes 
-                // a fixed amount of time longer for each additonal buffer that is transferred.
-                //                
-                wait_time = 80 + ( buffer_count * 80 );
-                
-                wl_usleep( wait_time );   // Takes in a wait time in micro-seconds
-            break;
-            
-            case TRANSPORT_WARP_HW_v3:
-                // In WARP v3 hardware, we need to account for both small packets as well as jumbo frames.  Also,
-                // since the WARP v3 hardware uses a DMA to transfer packet data, the processing overhead is much
-                // less than on v2 (hence the smaller wait times).  Through experimental testing, we found that 
-                // for jumbo frames, the processing overhead was smaller than the length of the ethernet transfer
-                // and therefore we do not need to wait at all.  We have not done exhaustive testing on ethernet 
-                // packet size vs wait time.  So in this simplified implementation, if your Ethernet MTU size is 
-                // less than 9000 bytes (ie approximately 0x8B8 samples) then we will insert a 40 us, or 50 us, 
-                // delay between transmissions to give the board time to keep up with the flow of packets.
-                // 
-                if ( max_samples < 0x800 ) {
-
-                    // printf("introducing delay ! \n");
-                    if ( buffer_id == 0xF ) {
-                        wait_time = 50;
-                    } else {
-                        wait_time = 40;
-                    }
 
-                    wl_usleep( wait_time );   // Takes in a wait time in micro-seconds
-                }
-             break;
-             
-             default:
-                printf("WARNING:  HW version of node (%d) is not recognized.  Please check your setup.\n", hw_ver);
-             break;
-        }
+            if ( tracing ) { record.ack_wait_ns += wl_trace_now() - trace_ns; }
+        }  // END if need_resp
         
     }  // END for num_pkts
 
@@ -1852,11 +4184,21 @@ int wl_write_baseband_buffer( int index,
         printf("    Number of packets to send %d, Max samples per packet %d \n", num_pkts, max_samples);
     }
     
-    // Free locally allocated memory    
-    free( send_buffer );
-    free( rcvd_buffer );
-
     // Finalize outputs
+    clock_gettime( CLOCKTYPE, &end_time );
+
+    // The next write to the socket starts with the window this one ended with
+    wl_socket( index )->write_window = window;
+
+    WL_STATS_ADD( index, node_address, write_samples, offset - start_sample );
+    wl_stats_op( index, node_address, WL_STATS_OP_WRITE, &start_time, &end_time );
+
+    if ( tracing ) {
+        record.num_samples    = offset - start_sample;
+        record.retrans_rounds = num_retrys + num_resumes;
+        wl_trace_commit( &record, wl_trace_ns( &end_time ) );
+    }
+
     if ( seq_num > seq_start_num ) {
         *num_cmds += seq_num - seq_start_num;
     } else {
@@ -1867,24 +4209,187 @@ int wl_write_baseband_buffer( int index,
 }
 
 
+/*****************************************************************************/
+/**
+* This function will write the baseband buffers, encoding the samples straight
+* from an input array of the given format in to each packet
+*
+* @param	index          - Index in to socket structure which will receive samples
+* @param	buffer         - WARPLab command (includes transport header and command header)
+* @param	max_length     - Length (in bytes) max data packet to send (Ethernet MTU size - Ethernet header)
+* @param    ip_addr        - IP Address of node to retrieve samples
+* @param    port           - Port of node to retrieve samples
+* @param    num_samples    - Number of samples to process (should be the same as the argument in the WARPLab command)
+* @param    start_sample   - Index of starting sample (should be the same as the agrument in the WARPLab command)
+* @param    format         - Format of the sample array (WL_SAMPLE_*)
+* @param    samples        - Array of samples to be sent
+* @param    buffer_id      - Which buffer(s) do we need to send samples to (all dimensionality of buffer_ids is handled by Matlab)
+* @param    num_pkts       - Number of packets to transfer (precomputed by calling SW)
+* @param    max_samples    - Max samples to send per packet (precomputed by calling SW)
+* @param    hw_ver         - Hardware version of node
+* @param    num_cmds       - Return parameter - number of ethernet send commands used to request packets 
+*                                (could be > 1 if there are transmission errors)
+*
+* @return	samples_sent   - Number of samples processed 
+*
+******************************************************************************/
+int wl_write_baseband_samples( int index, 
+                               char *buffer, int max_length, char *ip_addr, int port,
+                               int num_samples, int start_sample, int format, const void *samples, uint32 buffer_id,
+                               int num_pkts, int max_samples, int hw_ver, uint32 *num_cmds ) {
+
+    return wl_write_baseband_packets( index, buffer, max_length, ip_addr, port, num_samples, start_sample, format, samples, 
+                                      NULL, buffer_id, num_pkts, max_samples, hw_ver, num_cmds );
+}
+
+
+/*****************************************************************************/
+/**
+* This function will write the baseband buffers from a pre-encoded waveform 
+* (see wl_waveform_create):  the payload, the sample headers and the checksum
+* inputs of the packets are reused, so a write only fills in the transport 
+* and command headers
+*
+* @param	index          - Index in to socket structure which will receive samples
+* @param	buffer         - WARPLab command (includes transport header and command header)
+* @param	max_length     - Length (in bytes) max data packet to send (Ethernet MTU size - Ethernet header)
+* @param    ip_addr        - IP Address of node to retrieve samples
+* @param    port           - Port of node to retrieve samples
+* @param    waveform       - Waveform to be sent
+* @param    buffer_id      - Which buffer(s) do we need to send samples to (all dimensionality of buffer_ids is handled by Matlab)
+* @param    hw_ver         - Hardware version of node
+* @param    num_cmds       - Return parameter - number of ethernet send commands used to request packets 
+*                                (could be > 1 if there are transmission errors)
+*
+* @return	samples_sent   - Number of samples processed 
+*
+******************************************************************************/
+int wl_write_baseband_waveform( int index, 
+                                char *buffer, int max_length, char *ip_addr, int port,
+                                const wl_waveform *waveform, uint32 buffer_id, int hw_ver, uint32 *num_cmds ) {
+
+    return wl_write_baseband_packets( index, buffer, max_length, ip_addr, port, waveform->num_samples, waveform->start_sample, 
+                                      WL_SAMPLE_RAW32, NULL, waveform, buffer_id, waveform->num_pkts, waveform->max_samples, 
+                                      hw_ver, num_cmds );
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_waveform_create
+*
+*  Encodes a waveform for writes (see wl_write_baseband_waveform):  the 
+*  samples start_sample to num_samples - 1 of an array of the given format
+*  (WL_SAMPLE_*) are encoded for the node once, split in to packets of 
+*  max_samples samples, and the sample header and checksum input of each
+*  packet are computed.  The waveform is only read by writes, so it can be 
+*  written to several nodes at the same time.
+*
+*  Returns:  Waveform (free with wl_waveform_free)
+*
+******************************************************************************/
+wl_waveform * wl_waveform_create( int format, const void *samples, int start_sample, int num_samples, int max_samples ) {
+
+    int           i;
+    int           offset;
+    int           sample_num;
+    uint8        *payload;
+    wl_waveform  *waveform;
+
+    if ( ( max_samples <= 0 ) || ( start_sample < 0 ) || ( num_samples < start_sample ) ) {
+        die_with_error("Error:  Invalid waveform size");
+    }
+
+    waveform = (wl_waveform *) calloc( 1, sizeof( wl_waveform ) );
+    if ( waveform == NULL ) { die_with_error("Error:  Cannot allocate waveform."); }
+
+    waveform->start_sample = start_sample;
+    waveform->num_samples  = num_samples;
+    waveform->max_samples  = max_samples;
+    waveform->num_pkts     = ( num_samples - start_sample + max_samples - 1 ) / max_samples;
+    waveform->payload      = (uint8 *) wl_aligned_alloc( sizeof( uint32 ) * ( num_samples - start_sample ) + 1 );
+    waveform->sample_hdrs  = (wl_sample_header *) calloc( waveform->num_pkts + 1, sizeof( wl_sample_header ) );
+    waveform->last_samples = (uint16 *) calloc( waveform->num_pkts + 1, sizeof( uint16 ) );
+
+    if ( ( waveform->sample_hdrs == NULL ) || ( waveform->last_samples == NULL ) ) {
+        die_with_error("Error:  Cannot allocate waveform.");
+    }
+
+    // Encode the samples (see warp_kernels.c)
+    wl_encode_samples( format, waveform->payload, samples, start_sample, num_samples - start_sample );
+
+    // Sample header and checksum input (start sample and last sample, see wl_write_baseband_packets) of each packet
+    offset = start_sample;
+
+    for ( i = 0; i < waveform->num_pkts; i++ ) {
+        sample_num = ( ( offset + max_samples ) <= num_samples ) ? max_samples : ( num_samples - offset );
+        payload    = waveform->payload + ( ( offset - start_sample ) * sizeof( uint32 ) );
+
+        waveform->sample_hdrs[i].start       = endian_swap_32( offset );
+        waveform->sample_hdrs[i].num_samples = endian_swap_32( sample_num );
+        waveform->last_samples[i]            = ( ( payload[4 * sample_num - 4] << 8 ) | payload[4 * sample_num - 3] ) ^
+                                               ( ( payload[4 * sample_num - 2] << 8 ) | payload[4 * sample_num - 1] );
+
+        offset += sample_num;
+    }
+
+    return waveform;
+}
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_waveform_free
+*
+*  Frees a waveform
+*
+******************************************************************************/
+void wl_waveform_free( wl_waveform *waveform ) {
+
+    if ( waveform == NULL ) { return; }
+
+    wl_aligned_free( waveform->payload );
+    free( waveform->sample_hdrs );
+    free( waveform->last_samples );
+    free( waveform );
+}
+
+
+
+/*****************************************************************************/
+/**
+*  Function:  wl_checksum_add
+*
+*  Adds a word to a Fletcher-32 checksum (same as wl_update_checksum, with 
+*  the running sums held in the checksum value instead of the socket index)
+*
+******************************************************************************/
+uint32 wl_checksum_add( uint32 checksum, uint16 newdata ) {
+
+    uint32 sum1 = ( ( checksum & 0xFFFF ) + newdata ) % 0xFFFF;
+    uint32 sum2 = ( ( checksum >> 16 ) + sum1 ) % 0xFFFF;
+
+    return ( sum2 << 16 ) + sum1;
+}
+
 
 /*****************************************************************************/
 /**
 *  Function:  wl_update_checksum
 *
-*  Function to calculate a Fletcher-32 checksum to detect packet loss
+*  Function to calculate a Fletcher-32 checksum to detect packet loss;  the 
+*  running sums are held per socket, so each socket's thread has its own
 *
 ******************************************************************************/
 unsigned int wl_update_checksum(unsigned short int newdata, unsigned char reset, int index){
 
     // Fletcher-32 Checksum
 
-	if( reset ){ sum1[index] = 0; sum2[index] = 0; }
+	if( reset ){ wl_socket( index )->checksum = 0; }
 
-	sum1[index] = (sum1[index] + newdata) % 0xFFFF;
-	sum2[index] = (sum2[index] + sum1[index]   ) % 0xFFFF;
+	wl_socket( index )->checksum = wl_checksum_add( wl_socket( index )->checksum, newdata );
 
-	return ( ( sum2[index] << 16 ) + sum1[index]);
+	return ( wl_socket( index )->checksum );
 
 }
 
@@ -9,6 +9,10 @@
 //#include <pthread.h>
 #include <assert.h>
 #include <unistd.h>
+#include "warp_kernels.h"
+#include "warp_stats.h"
+#include "warp_trace.h"
+#include "warp_rtt.h"
 #ifdef WIN32
 
 #include <Windows.h>
@@ -25,6 +29,13 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <linux/net_tstamp.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
 
 #endif
 
@@ -82,12 +93,44 @@
 #define TRANSPORT_READ_RSSI            11
 #define TRANSPORT_WRITE_IQ             12
 
-// Maximum number of sockets that can be allocated
-#define TRANSPORT_MAX_SOCKETS           20 //5
+// Maximum number of sockets that can be allocated;  the socket registry grows by 
+// TRANSPORT_SOCKET_CHUNK sockets at a time up to this bound
+//     NOTE:  Every socket index has its own counters, so the bound is the size of the
+//         socket statistics table (see warp_stats.h)
+#define TRANSPORT_MAX_SOCKETS           WL_STATS_MAX_SOCKETS
+#define TRANSPORT_SOCKET_CHUNK          32
 
 // Maximum size of a packet
 #define TRANSPORT_MAX_PKT_LENGTH        9050
 
+// Maximum size of a Read IQ command
+#define TRANSPORT_MAX_CMD_LENGTH        64
+
+// Number of samples in a WARP RF buffer (capacity of the per-socket staging buffers)
+#define TRANSPORT_MAX_SAMPLES           32768
+
+// Alignment of the per-socket buffers
+#define TRANSPORT_BUFFER_ALIGN          64
+
+// Maximum number of packets drained by one batched receive
+#define TRANSPORT_MAX_BATCH             32
+
+// Memory mapped receive ring (see set_receive_ring)
+//     NOTE:  The kernel hands a block of the ring to the host once it is full or TRANSPORT_RING_BLOCK_TOV_MS 
+//         after its first packet, so the last packets of a transfer arrive up to a block timeout late;  the
+//         round trip estimates (see warp_rtt.h) include that delay.
+#define TRANSPORT_RING_BLOCK_SIZE       ( 1 << 17 )   // Size of a ring block (about 14 jumbo frames)
+#define TRANSPORT_RING_BLOCK_TOV_MS     1             // Timeout (in ms) after which the kernel retires a partly filled block
+#define TRANSPORT_RING_SIZE             ( 1 << 24 )   // Default size of the ring
+#define TRANSPORT_RING_PORT_MIN         9000          // Ports the nodes send from (9000 + node ID)
+#define TRANSPORT_RING_PORT_MAX         9253
+
+// Maximum number of packets submitted by one batched send
+#define TRANSPORT_MAX_SEND_BATCH        32
+
+// Storage for the headers of one Write IQ packet (transport, command and sample headers)
+#define TRANSPORT_MAX_HDR_LENGTH        64
+
 // Socket state
 #define TRANSPORT_SOCKET_FREE           0
 #define TRANSPORT_SOCKET_IN_USE         1
@@ -98,8 +141,35 @@
 #define TRANSPORT_SLEEP_TIME            10000
 #define TRANSPORT_FLAG_ROBUST           0x0001
 #define TRANSPORT_PADDING_SIZE          2
-#define TRANSPORT_TIMEOUT               1000000
-#define TRANSPORT_MAX_RETRY             50
+#define TRANSPORT_GIVE_UP_MS            10000 // A transfer is aborted after this long without a response (see wl_rtt_timeout)
+#define TRANSPORT_MAX_RANGES            8     // Max Read IQ commands sent per retransmit round
+#define TRANSPORT_READ_PIPELINE         4     // Read IQ chunks in flight in the receive buffer budget
+
+// Write IQ checkpoints
+//     NOTE:  The node answers a Write IQ packet sent with TRANSPORT_FLAG_ROBUST with the checksum of the
+//         packets it received so far.  Every window of packets ends with such a checkpoint;  a checksum
+//         mismatch resends the packets since the last good checkpoint.  The window of a socket halves
+//         on each lost packet or response and grows by a packet on each good checkpoint.
+#define TRANSPORT_WRITE_WINDOW_MAX      64    // Packets per checkpoint without loss
+#define TRANSPORT_WRITE_MAX_RESUMES     8     // Resumes from the same checkpoint before aborting
+
+// Write IQ pacing modes
+//     NOTE:  Packets leave at departure times spaced by the gap the node needs (see wl_write_baseband_samples)
+//         or by the target rate of the socket (see set_write_pacing)
+#define TRANSPORT_PACE_SPIN             0     // Wait for each departure time:  sleep, then spin for the last TRANSPORT_PACE_SPIN_NS
+#define TRANSPORT_PACE_TXTIME           1     // Stamp each packet with its departure time (SO_TXTIME);  needs the fq qdisc on the interface
+#define TRANSPORT_PACE_SPIN_NS          100000
+
+// Response wait modes
+#define TRANSPORT_WAIT_SPIN             0     // Spin on the non-blocking socket until data arrives or the deadline passes
+#define TRANSPORT_WAIT_EVENT            1     // Block in ppoll() until data arrives or the deadline passes
+#define TRANSPORT_WAIT_HYBRID           2     // Spin for the spin budget of the socket, then block in ppoll() (see set_wait_spin)
+#define TRANSPORT_WAIT_SPIN_US          50    // Default spin budget (in us) of TRANSPORT_WAIT_HYBRID
+
+// Phases of a response wait (see wl_timer_wait)
+#define TRANSPORT_WAIT_PHASE_NONE       0     // No wait in progress
+#define TRANSPORT_WAIT_PHASE_SPIN       1     // Spinning on the socket
+#define TRANSPORT_WAIT_PHASE_BLOCK      2     // Blocked in ppoll()
 
 // Sample defines
 #define SAMPLE_CHKSUM_RESET             0x01
@@ -112,6 +182,11 @@
 // WARP Buffers defines
 #define TRANSPORT_WARP_RF_BUFFER_MAX    4
 
+// Read IQ transfer status
+#define WL_READ_IDLE                    0     // Request not sent yet
+#define WL_READ_ACTIVE                  1     // Request sent, waiting for samples
+#define WL_READ_DONE                    2     // All samples received
+
 #define CLOCKTYPE CLOCK_MONOTONIC
 
 /*************************** Variable Definitions ****************************/
@@ -135,15 +210,88 @@ typedef struct
     struct sockaddr_in address;   // Address information of data to be sent / recevied    
 } wl_trans_data_pkt;
 
-// Socket structure
+// Batched receive structure
+typedef struct
+{
+    char              *buf;                           // Storage for TRANSPORT_MAX_BATCH packets
+    int                length;                        // Length of each packet slot in buf
+    int                count;                         // Number of packets held from the last batch
+    int                next;                          // Index of the next packet to hand out
+    int                size[TRANSPORT_MAX_BATCH];     // Size of each held packet
+    struct sockaddr_in address[TRANSPORT_MAX_BATCH];  // Source address of each held packet
+    struct timespec    stamp[TRANSPORT_MAX_BATCH];    // Kernel receive time of each held packet (see set_receive_timestamps)
+    char               control[TRANSPORT_MAX_BATCH][64];   // Control message storage of each packet slot
+} wl_trans_batch;
+
+// Memory mapped receive ring structure (TPACKET_V3, see set_receive_ring)
+typedef struct
+{
+    SOCKET             handle;                        // AF_PACKET socket
+    uint8             *map;                           // Mapped ring
+    uint32             block_size;                    // Size of each block
+    uint32             num_blocks;                    // Number of blocks
+    uint32             block;                         // Block the packets are handed out from
+    uint32             pkts_left;                     // Packets of the block not handed out yet
+    uint8             *pkt;                           // Next packet of the block (NULL if the block is not open)
+    uint16             port;                          // Local port of the UDP socket (network byte order)
+    struct timespec    stamp;                         // Kernel receive time of the last packet handed out
+} wl_trans_ring;
+
+// Socket structure (holds all state of the socket;  different sockets can be used from different threads)
 typedef struct
 {
     SOCKET              handle;   // Handle to the socket
     int                 timeout;  // Timeout value
     int                 status;   // Status of the socket
+    int                 next_free; // Next socket of the registry free list (-1 for the last)
     wl_trans_data_pkt  *packet;   // Pointer to a data_packet
+    int                 batch_mode; // Drain the socket with batched receives
+    wl_trans_batch     *batch;    // Pointer to the batched receive state
+    wl_trans_ring      *ring;     // Pointer to the memory mapped receive ring (NULL to receive from the socket)
+    int                 wait_mode;  // How to wait for responses (TRANSPORT_WAIT_*)
+    int                 wait_phase; // Phase of the wait in progress (TRANSPORT_WAIT_PHASE_*)
+    uint32              spin_us;    // Spin budget (in us) of TRANSPORT_WAIT_HYBRID
+    uint64_t            spin_end_ns; // End of the spin phase of the wait in progress (CLOCK_MONOTONIC)
+    int                 tx_buffer_size; // Send buffer size reported by the OS (0 until queried)
+    int                 rx_buffer_size; // Receive buffer size reported by the OS (0 until queried)
+    int                 timestamps; // Batched receives return the kernel receive time of each packet
+    int                 write_window; // Write IQ packets per checkpoint (see TRANSPORT_WRITE_WINDOW_MAX)
+    int                 pace_mode;  // How Write IQ packets are paced (TRANSPORT_PACE_*)
+    uint32              pace_rate;  // Target Write IQ rate in Mbps (0 to space packets by the gap the node needs)
+    uint32              checksum;   // Running Fletcher-32 checksum of wl_update_checksum
+    int                 connected;  // Socket is connected to peer (see connect_socket)
+    int                 sent;       // Socket has sent a packet (see wl_socket_target)
+    uint16              read_seq_num;  // Sequence number of the last Read IQ transfer (see wl_read_send)
+    struct sockaddr_in  peer;       // Address of the node the socket is connected to
+    struct wl_trans_ctx *ctx;     // Pointer to the transfer context (preallocated buffers)
 } wl_trans_socket;
 
+// Response timer
+typedef struct
+{
+    uint32             timeout_us; // Timeout the timer was started with (see wl_timeout_us)
+    struct timespec    deadline;  // Wall-clock deadline (CLOCK_MONOTONIC)
+    int                expired;   // Set once the timer has run out
+} wl_trans_timer;
+
+// Packet pacer
+typedef struct
+{
+    uint64_t           next_ns;   // Earliest departure time of the next packet (CLOCK_MONOTONIC)
+    uint64_t           depart_ns; // Departure time of the last packet
+    uint64_t           wait_ns;   // Time spent waiting for departure times
+} wl_trans_pacer;
+
+// Scatter-gather packet (see send_socket_gather)
+typedef struct
+{
+    char              *hdr;            // Packet headers
+    int                hdr_length;     // Length of the headers
+    char              *payload;        // Packet payload
+    int                payload_length; // Length of the payload
+    uint64_t           txtime_ns;      // Departure time (CLOCK_MONOTONIC, see wl_pacer_send)
+} wl_trans_sg_pkt;
+
 // WARPLAB Transport Header
 typedef struct
 {
@@ -175,12 +323,84 @@ typedef struct
     uint32             num_samples;    // Number of samples
 } wl_sample_header;
 
-// WARPLAB Sample Tracket
+// Pre-encoded Write IQ waveform (see wl_waveform_create)
+typedef struct wl_waveform
+{
+    int                start_sample;      // First sample of the write
+    int                num_samples;       // End of the write (same meaning as in wl_write_baseband_samples)
+    int                max_samples;       // Samples in a full packet
+    int                num_pkts;          // Number of packets
+    uint8             *payload;           // Samples encoded for the node
+    wl_sample_header  *sample_hdrs;       // Start and number of samples of each packet (buffer id and flags are set by the write)
+    uint16            *last_samples;      // I ^ Q of the last sample of each packet (checksum input)
+} wl_waveform;
+
+
+// Packet bitmap helpers
+#define WL_BITMAP_WORDS(bits)           ( ( (bits) + 31 ) >> 5 )
+#define WL_READ_BITMAP_WORDS            8     // Transfers of up to 256 packets keep the bitmap in the state
+#define WL_BITMAP_TEST(bitmap, bit)     ( ( (bitmap)[(bit) >> 5] >> ( (bit) & 0x1F ) ) & 0x1 )
+#define WL_BITMAP_SET(bitmap, bit)      ( (bitmap)[(bit) >> 5] |= ( 0x1 << ( (bit) & 0x1F ) ) )
+
+// Read IQ transfer state
 typedef struct
 {
-    uint32             start_sample;   // Starting sample
-    uint32             num_samples;    // Number of samples
-} wl_sample_tracker;
+    char               buffer[TRANSPORT_MAX_CMD_LENGTH];   // Read IQ command (arguments are updated on retries)
+    int                length;            // Length of the command
+    char               ip_addr[16];       // IP Address of the node
+    int                port;              // Port of the node
+    struct sockaddr_in address;           // Address of the node; sample packets are matched against it
+    uint32             buffer_id;         // Buffer the samples are read from
+    uint32             group_size;        // Transfers answered by the first command of this one (see wl_read_group)
+    uint32             group_mask;        // Buffer mask of that command
+    uint32             start_sample;      // First sample of the transfer
+    uint32             num_samples;       // Number of samples in the transfer
+    uint32             num_pkts;          // Number of packets in the transfer
+    uint32             bytes_per_pkt;     // Sample payload (in bytes) of a full packet
+    uint32             samples_per_pkt;   // Samples in a full packet
+    int                format;            // Format of the output array (WL_SAMPLE_*)
+    void              *output;            // Array of samples to return
+    uint32             output_start;      // Sample number stored at output[0]
+    uint32            *rcvd_bitmap;       // Packets received (bit i is packet i of the transfer)
+    uint32             bitmap[WL_READ_BITMAP_WORDS];   // Storage for rcvd_bitmap when it is small enough
+    uint32             rcvd_pkts;         // Number of packets received
+    uint32             num_rcvd_samples;  // Number of samples received
+    uint32             num_retrys;        // Number of re-requests
+    uint32             num_cmds;          // Number of requests sent
+    int                status;            // Status of the transfer (WL_READ_*)
+    wl_trans_timer     timer;             // Response timer
+    uint32             backoff;           // Timeouts since the last packet (the response timeout doubles on each one)
+    uint32             idle_us;           // Time spent in those timeouts
+    int                rtt_sample;        // Sample the round trip time of the first command (no other transfer to the node was in flight)
+    uint16             seq_num;           // Sequence number of the commands of the transfer;  the node echoes it in the sample packets
+    struct timespec    send_time;         // Time the first command was sent
+    struct timespec    done_time;         // Time the last packet of the transfer arrived
+    wl_trace_phases    trace;             // Phase timestamps (only taken while tracing, see warp_trace.h)
+} wl_read_state;
+
+// Receive buffer space (in bytes) taken by one response / all the responses of a Read IQ transfer / 
+// all the responses of a group of transfers requested with one command
+#define WL_READ_PKT_OVERHEAD            100
+#define WL_READ_PKT_BYTES(state)        ( (state)->bytes_per_pkt + WL_READ_PKT_OVERHEAD )
+#define WL_READ_BYTES(state)            ( (state)->num_pkts * WL_READ_PKT_BYTES( state ) )
+#define WL_READ_GROUP_BYTES(state)      ( (state)->group_size * WL_READ_BYTES( state ) )
+
+
+// Transfer context
+//     NOTE:  One context is owned by each socket and created once (see init_socket_context) so that 
+//         steady-state Read / Write IQ calls do not allocate memory.  Samples are decoded straight from
+//         the packet in to the caller's array.  Write IQ encodes the samples once in to write_payload and
+//         sends each packet as its headers plus a slice of it (see send_socket_gather).
+typedef struct wl_trans_ctx
+{
+    int                max_samples;       // Capacity (in samples) of the sample staging buffers
+    char              *rcvd_buffer;       // Packet receive buffer (TRANSPORT_MAX_PKT_LENGTH bytes)
+    uint32            *samples_iq;        // Staging for wl_write_baseband_buffer (I / Q packed in to words)
+    char              *write_hdrs;        // Write IQ packet headers (TRANSPORT_MAX_SEND_BATCH slots of TRANSPORT_MAX_HDR_LENGTH bytes)
+    uint8             *write_payload;     // Write IQ payload:  the samples of a write encoded for the node
+    wl_read_state     *states;            // Read IQ transfers for readSamplesMulti (grown on demand)
+    int                max_states;        // Capacity of states
+} wl_trans_ctx;
 
 
 struct thread_data{
@@ -199,12 +419,6 @@ struct thread_data{
 
 extern int initialized; // variable visible across multiple files
 
-unsigned int sum1[20]; // needed to run checksum methods in multiple threads
-unsigned int sum2[20]; // ""
-
-#ifdef WIN32
-WSADATA          wsaData;              // Structure for WinSock setup communication 
-#endif
 
 /*************************** Function Prototypes *****************************/
 
@@ -216,13 +430,45 @@ int          init_socket( void );
 void         set_so_timeout( int index, int value );
 void         set_reuse_address( int index, int value );
 void         set_broadcast( int index, int value );
+void         set_receive_batch( int index, int value );
+void         set_wait_mode( int index, int mode );
+void         set_wait_spin( int index, int spin_us, int busy_poll_us );
+void         set_receive_timestamps( int index, int value );
+int          set_receive_ring( int index, const char *ifname, int size );
+void         free_receive_ring( int index );
+void         set_write_pacing( int index, int mode, uint32 rate_mbps );
 void         set_send_buffer_size( int index, int size );
 int          get_send_buffer_size( int index );
 void         set_receive_buffer_size( int index, int size );
 int          get_receive_buffer_size( int index );
 void         close_socket( int index );
+void         init_socket_context( int index, int max_samples );
+wl_trans_ctx *get_socket_context( int index );
+void         free_socket_context( wl_trans_ctx *ctx );
+void *       wl_aligned_alloc( size_t size );
+void         wl_aligned_free( void *ptr );
+void         wl_resolve_address( char *ip_addr, int port, struct sockaddr_in *address );
+void         connect_socket( int index, char *ip_addr, int port );
+void         disconnect_socket( int index );
+int          connect_socket_once( int index, char *ip_addr, int port );
+const struct sockaddr_in * wl_socket_target( int index, const struct sockaddr_in *address );
 int          send_socket( int index, char *buffer, int length, char *ip_addr, int port );
+int          send_socket_to( int index, char *buffer, int length, const struct sockaddr_in *address );
+int          send_socket_gather( int index, wl_trans_sg_pkt *pkts, int num_pkts, const struct sockaddr_in *address );
 int          receive_socket( int index, int length, char * buffer );
+int          receive_socket_batch( int index, char **buffer, struct sockaddr_in *address );
+int          receive_ring( int index, char **buffer, struct sockaddr_in *address );
+int          get_receive_timestamp( int index, struct timespec *stamp );
+void         alloc_socket_batch( int index );
+uint32       wl_timeout_us( int index, uint32 address, int op, uint32 backoff );
+void         wl_timer_start( wl_trans_timer *timer, uint32 timeout_us );
+int          wl_timer_wait( int index, wl_trans_timer *timer );
+int          wl_timer_check( wl_trans_timer *timer );
+int          wl_timer_compare( wl_trans_timer *a, wl_trans_timer *b );
+void         wl_pacer_start( wl_trans_pacer *pacer );
+uint64_t     wl_pacer_gap_ns( int index, int length, uint32 gap_us );
+int          wl_pacer_send( int index, wl_trans_pacer *pacer, wl_trans_sg_pkt *pkts, int num_pkts, const struct sockaddr_in *address, uint32 gap_us );
+uint32       wl_pacer_pending_us( wl_trans_pacer *pacer );
 
 // Debug / Error functions
 void         print_usage( void );
@@ -240,24 +486,52 @@ uint32       endian_swap_32(uint32 value);
 
 int sendData(int handle, char* buffer, int length, char* ip_addr, int port);
 int receiveData(char* buffer, int handle, int length);
+int readSamplesMulti(void** samples, int format, int handle, char** buffers, int length, char** ip_addrs, int* ports, int num_nodes, int num_samples, uint32 buffer_id, int start_sample, int max_length);
 int readSamples(double complex* samples, int handle, char* buffer, int length, char* ip_addr, int port, int num_samples, uint32 buffer_id, int start_sample, int max_length, int num_pkts);
+int readSamplesFormat(void* samples, int format, int handle, char* buffer, int length, char* ip_addr, int port, int num_samples, uint32 buffer_id, int start_sample, int max_length, int num_pkts);
 int writeSamples(int handle, char* buffer, int max_length, char* ip_addr, int port, int num_samples, uint16* sample_I_buffer, uint16* sample_Q_buffer, int buffer_id, int start_sample, int num_pkts, int max_samples, int hw_ver);
+int writeSamplesFormat(int handle, char* buffer, int max_length, char* ip_addr, int port, int num_samples, int format, const void* samples, int buffer_id, int start_sample, int num_pkts, int max_samples, int hw_ver);
+int writeSamplesWaveform(int handle, char* buffer, int max_length, char* ip_addr, int port, const wl_waveform* waveform, int buffer_id, int hw_ver);
 
 
 void         wl_mex_udp_transport_usleep( int wait_time );
 unsigned int wl_update_checksum(unsigned short int newdata, unsigned char reset, int index);
-int          wl_read_iq_sample_error( wl_sample_tracker *tracker, uint32 num_samples, uint32 start_sample, uint32 num_pkts, uint32 max_sample_size );
-int          wl_read_iq_find_error( wl_sample_tracker *tracker, uint32 num_samples, uint32 start_sample, uint32 num_pkts, uint32 max_sample_size,
-                                    uint32 *ret_num_samples, uint32 *ret_start_sample, uint32 *ret_num_pkts );
+uint32       wl_checksum_add( uint32 checksum, uint16 newdata );
 
 // WARPLab Functions
 int          wl_read_baseband_buffer( int index, char *buffer, int length, char *ip_addr, int port,
                                       int num_samples, int start_sample, uint32 buffer_id, 
                                       uint32 *output_array, uint32 *num_cmds );
 
+int          wl_read_baseband_samples( int index, char *buffer, int length, char *ip_addr, int port,
+                                       int num_samples, int start_sample, uint32 buffer_id,
+                                       int format, void *output, uint32 output_start, uint32 *num_cmds );
+void         wl_read_init( wl_read_state *state, char *buffer, int length, char *ip_addr, int port,
+                           int num_samples, int start_sample, uint32 buffer_id, 
+                           int format, void *output, uint32 output_start );
+void         wl_read_free( wl_read_state *state );
+void         wl_read_group( wl_read_state *states, int num_states );
+void         wl_read_send( int index, wl_read_state *state );
+void         wl_read_send_group( int index, wl_read_state *states );
+void         wl_read_timeout( int index, wl_read_state *state );
+int          wl_read_request_missing( int index, wl_read_state *state );
+uint32       wl_bitmap_next_clear( uint32 *bitmap, uint32 start, uint32 size );
+uint32       wl_bitmap_next_set( uint32 *bitmap, uint32 start, uint32 size );
+int          wl_read_packet( int index, wl_read_state *state, char *buffer, int size );
+int          wl_read_baseband_multi( int index, wl_read_state *states, int num_states, uint32 max_bytes );
+uint32       wl_read_budget( int index );
+void         wl_read_trace( int index, wl_read_state *states, int num_chunks, int stride, int group, struct timespec *start_time );
+
 int          wl_write_baseband_buffer( int index, char *buffer, int max_length, char *ip_addr, int port,
                                        int num_samples, int start_sample, uint16 *samples_i, uint16 *samples_q, uint32 buffer_id,
                                        int num_pkts, int max_samples, int hw_ver, uint32 *num_cmds );
+int          wl_write_baseband_samples( int index, char *buffer, int max_length, char *ip_addr, int port,
+                                        int num_samples, int start_sample, int format, const void *samples, uint32 buffer_id,
+                                        int num_pkts, int max_samples, int hw_ver, uint32 *num_cmds );
+int          wl_write_baseband_waveform( int index, char *buffer, int max_length, char *ip_addr, int port,
+                                         const wl_waveform *waveform, uint32 buffer_id, int hw_ver, uint32 *num_cmds );
+wl_waveform *wl_waveform_create( int format, const void *samples, int start_sample, int num_samples, int max_samples );
+void         wl_waveform_free( wl_waveform *waveform );
 
 
 void* multi_read(void* arg);